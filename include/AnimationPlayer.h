@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+#include "ST7735_TFT.h"
+
+/**
+ * @file AnimationPlayer.h
+ * @brief tools/imgconv --animで変換したアニメーション（TFTAnimation）を、変わった部分だけ描き直して再生する部品。
+ * @details bmpDrawで毎回フレーム全体を送ると、128x160の画面では１フレームに40KBを送ることになる。
+ * TFTAnimationは、最初のフレームだけを画像全体で持ち、以後は前のフレームから変わった矩形だけを持つので、
+ * AnimationPlayerが送るのは、変わった矩形の画素だけになる。矩形は、そのまま、ランレングス圧縮、パレット形式のうち
+ * 小さくなるものでimgconvが変換してあり、drawImageで表示する。<br/>
+ * update()を呼ぶと、前のフレームを表示してからフレームの時間が経っていれば、次のフレームを表示する。
+ * 表示が間に合わなかったときは、遅れを取り戻そうとはせず、次のフレームの時間をそこから数える（overruns()で数を数える）。<br/>
+ * 差分は前のフレームの上に描くので、アニメーションの範囲を他の描画で上書きしたときは、rewind()で最初から描き直す。
+ * 透過色（bmpUseTransColor）を設定していると、矩形の中の透過色の画素が描き直されないので、再生中は透過色を使わないこと。<br/>
+ * 使い方:
+ *
+ *     AnimationPlayer anim(&tft, &walk, 20, 30);	// imgconv --anim で作ったwalkを、(20,30)に表示する
+ *     anim.setLoop(true);
+ *     while (true) {
+ *         anim.update();
+ *         // 他の処理
+ *     }
+ */
+
+/// @brief アニメーションを、変わった部分だけ描き直して再生する部品
+class AnimationPlayer {
+	public:
+	 AnimationPlayer(ST7735 *tft, const TFTAnimation *animation, int16_t x, int16_t y);
+
+	 bool update();
+	 void drawNextFrame();
+	 void play();
+	 void rewind();
+	 /// @brief 最後のフレームの後、最初のフレームに戻って再生を続けるかを設定する
+	 void setLoop(bool loop) { this->loop = loop; }
+	 /// @brief 次に表示するフレームの番号
+	 uint16_t frame() const { return (next < animation->frameCount) ? next : 0; }
+	 /// @brief ループしない設定で、最後のフレームまで表示したらtrue
+	 bool finished() const { return !loop && next >= animation->frameCount; }
+	 /// @brief 表示が次のフレームの時間までに間に合わなかった回数
+	 uint16_t overruns() const { return overrunCount; }
+
+	private:
+	 ST7735 *tft;
+	 const TFTAnimation *animation;
+	 int16_t x;
+	 int16_t y;
+	 bool loop;
+	 uint16_t next;			///< 次に表示するフレーム。frameCountなら、最初に戻る差分フレーム
+	 uint32_t offset;		///< 次に表示するフレームの、dataの中での位置
+	 uint32_t firstDelta;	///< キーフレームの次のフレームの、dataの中での位置
+	 uint16_t duration;		///< 最後に表示したフレームの時間（ミリ秒）
+	 bool started;
+	 uint32_t due;			///< 次のフレームを表示する時刻（time_us_32）
+	 uint16_t overrunCount;
+
+	 uint32_t drawFrame(uint32_t pos);
+};
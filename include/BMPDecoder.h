@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include "ImageStream.h"
+
+/**
+ * @file BMPDecoder.h
+ * @brief BMPファイルを、１行ずつ読み込んで液晶に表示する。
+ * @details SDカードなどに置いたBMPファイルを、ImageStreamで先頭から順に読み、１行ずつRGB565に変換して送る。
+ * 画像全体を読み込むバッファは使わず、使うRAMは１行分のバッファ（スタック上に640バイト）だけ。<br/>
+ * 読めるのは、無圧縮の24ビット、32ビット（BGRX）と、16ビット（555、またはBI_BITFIELDSの565と555）のBMP。
+ * 下から上へ行が並ぶ普通のBMPも、上から下へ並ぶBMP（高さが負）も読める。下から上へ並ぶBMPは、行を読んだ順に下から表示するので、
+ * ファイルを戻って読む（シークする）必要はない。<br/>
+ * 見えている列だけを読み、左右の見えない部分と行の詰め物は読み飛ばす。上から下へ並ぶBMPは、見えている範囲で１回だけ
+ * アドレスウインドウを設定する。下から上へ並ぶBMPは、行ごとにアドレスウインドウを設定する。<br/>
+ * 使い方:
+ *
+ *     ImageStream in;
+ *     in.Begin(readFromFile, &file);	// ファイルから読む関数
+ *     BMPDecoder::Draw(&tft, 0, 0, in);
+ *
+ * TFT_HOST_TOOLを定義すると、Draw以外の部分をホストでコンパイルでき、ファイルから読む関数を指定してDecodeを確かめられる。
+ */
+
+class ST7735;
+
+/// @brief BMPファイルの情報
+typedef struct {
+	uint32_t width;		///< 幅
+	uint32_t height;	///< 高さ
+	uint16_t depth;		///< １画素のビット数（16、24、32）
+	bool topDown;		///< 行が上から下へ並んでいればtrue
+	bool rgb555;		///< 16ビットで、RGBがそれぞれ5ビットならtrue
+} BMPInfo;
+
+/// @brief 読み込んだ行を受け取る関数
+/// @param context Decodeで指定した値
+/// @param x 画素の先頭の、画像の中での座標
+/// @param y 行の、画像の中での座標（上が0）
+/// @param w 画素数
+/// @param pixels RGB565の画素。液晶に送る順（上位、下位）に並んでいる
+/// @return 読み込みを続けるならtrue。falseを返すと、読み込みをやめる
+typedef bool (*BMPOutputFunc)(void *context, uint16_t x, uint16_t y, uint16_t w, const uint8_t *pixels);
+
+/// @brief BMPファイルを読み込んで表示するクラス
+class BMPDecoder {
+	public:
+	 static bool ReadHeader(ImageStream &in, BMPInfo *info);
+	 static bool Decode(ImageStream &in, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, BMPOutputFunc output, void *context);
+	#if !defined(TFT_HOST_TOOL)
+	 static bool Draw(ST7735 *tft, int16_t x, int16_t y, ImageStream &in);
+	 /// @brief メモリ上のBMPファイルを表示する
+	 static bool Draw(ST7735 *tft, int16_t x, int16_t y, const uint8_t *data, uint32_t size)
+	 {
+		 ImageStream in;
+		 in.BeginMemory(data, size);
+		 return Draw(tft, x, y, in);
+	 }
+	#endif
+
+	private:
+	 static bool DecodeRows(ImageStream &in, const BMPInfo &info, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, BMPOutputFunc output, void *context);
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @file ColorConvert.h
+ * @brief 24ビット、32ビットカラーとグレースケールの画素の並びを、まとめてRGB565に変換する。
+ * @details ST7735::Color565は１画素ずつ変換するが、カメラやセンサーの１行、デコーダが展開した１行などは、
+ * 画素の並びのまま変換した方が速い。ColorConvertは、画素の並びを１回の呼び出しで変換する。<br/>
+ * 出力は、そのままのRGB565（uint16_tの値）か、液晶に送る順（上位、下位のバイト）にできる。液晶に送る順にした行は、
+ * writeDataBlockでそのまま送れる。<br/>
+ * TFT_COLOR_DITHERを指定すると、4x4の組織的ディザ（Bayer行列）をかける。16ビットの液晶では、なだらかなグラデーションに
+ * 縞（バンディング）が見えるが、ディザをかけると目立たなくなる。ディザの模様は画面の座標で決まるので、
+ * 画素の並びの画面での位置（x、y）を指定する。<br/>
+ * グレースケール以外は、入力と出力に同じバッファを指定して、その場で変換できる（入力の画素は出力の画素より大きいので、先頭から順に書き換えても壊れない）。<br/>
+ * 使い方:
+ *
+ *     uint16_t line[160];
+ *     ColorConvert::FromRGB888(line, camera, 160, TFT_COLOR_PANEL_ORDER | TFT_COLOR_DITHER, 0, y);
+ *     tft.writeDataBlock((uint8_t *)line, 160 * 2);
+ *
+ * 液晶への描画までまとめて行うなら、ST7735::drawRGBを使う。
+ */
+
+/// @brief 変換元の画素の形式
+#define TFT_PIXEL_RGB888 0		///< 1画素3バイト。R、G、Bの順
+#define TFT_PIXEL_BGR888 1		///< 1画素3バイト。B、G、Rの順（BMPの24ビット）
+#define TFT_PIXEL_ARGB8888 2	///< 1画素4バイト。0xAARRGGBBのuint32_tをリトルエンディアンで並べたもの（バイトはB、G、R、Aの順）。αは使わない
+#define TFT_PIXEL_GRAY8 3		///< 1画素1バイト。明るさ
+
+/// @brief 変換のオプション（論理和で組み合わせる）
+#define TFT_COLOR_PANEL_ORDER 0x01	///< 出力を液晶に送る順（上位、下位のバイト）にする。指定しなければuint16_tの値
+#define TFT_COLOR_DITHER 0x02		///< 4x4の組織的ディザをかける
+
+/// @brief 1行分の画素を液晶に送るバッファの画素数。液晶の長辺以上にする
+/// @details ST7735の描画関数と、DigitAtlasや画像のデコーダが、1行のバッファをスタックに置くときに使う。
+#define TFT_LINE_BUFFER_PIXELS 160
+
+#ifdef __cplusplus
+/// @brief 画素の並びをRGB565に変換するクラス
+class ColorConvert {
+	public:
+	 static void FromRGB888(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options = 0, uint16_t x = 0, uint16_t y = 0);
+	 static void FromBGR888(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options = 0, uint16_t x = 0, uint16_t y = 0);
+	 static void FromARGB8888(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options = 0, uint16_t x = 0, uint16_t y = 0);
+	 static void FromGray8(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options = 0, uint16_t x = 0, uint16_t y = 0);
+	 static bool Convert(uint8_t format, uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options = 0, uint16_t x = 0, uint16_t y = 0);
+	 /// @brief 形式の１画素のバイト数。知らない形式なら0
+	 static uint8_t BytesPerPixel(uint8_t format)
+	 {
+		 static const uint8_t bytes[] = {3, 3, 4, 1};
+		 return (format < sizeof(bytes)) ? bytes[format] : 0;
+	 }
+};
+#endif
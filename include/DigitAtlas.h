@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include "ST7735_TFT.h"
+
+/**
+ * @file DigitAtlas.h
+ * @brief 数字や符号、単位の文字を、あらかじめRGB565に展開して持っておき、数値を高速に表示する。
+ * @details メーターやカウンターのように数値を頻繁に書き換える場合、毎回sprintfで文字列にして、文字を検索し、
+ * ビットを展開するのは無駄が多い。DigitAtlasはbeginで、数字(0～9)、空白、符号(-+)、小数点(.)、区切り(:)と、
+ * 指定された単位の文字を、指定された色でRGB565に展開しておく（アトラス）。<br/>
+ * drawInt/drawFixedは、整数や固定小数点数をsprintfを使わずに直接文字の並びにし、アトラスの行を並べて送るだけで表示する。
+ * 文字の検索やビットの展開はしないし、数値全体を１つのアドレスウインドウで送る。<br/>
+ * 1bppで持つと、表示のたびにビットを展開することになり、アトラスにする意味がないので、RGB565だけにしている。
+ * アトラスの大きさは、(文字の幅 x 高さ x 2バイト) x 文字数。16ドットの漢字フォントの半角なら、１文字256バイト。<br/>
+ * 使い方:
+ *
+ *     DigitAtlas meter;
+ *     meter.begin(&tft, true, ST7735_WHITE, ST7735_BLACK, 2, "℃");	// 漢字フォントの半角を２倍で
+ *     meter.drawFixed(10, 20, 2537, 2, 6, "℃");		// " 25.37℃"（右寄せで６文字分）
+ */
+
+/// @brief アトラスに加えられる単位の文字の最大数
+#ifndef TFT_DIGIT_ATLAS_MAX_UNITS
+#define TFT_DIGIT_ATLAS_MAX_UNITS 8
+#endif
+
+/// @brief 一度に表示できる文字数（数値と単位の合計）
+#define TFT_DIGIT_ATLAS_MAX_CHARS 24
+
+/// @brief 数字や単位の文字をRGB565に展開して持ち、数値を表示するクラス
+class DigitAtlas {
+	public:
+	 DigitAtlas();
+	 ~DigitAtlas();
+
+	 bool begin(ST7735 *tft, bool kanji, uint16_t color, uint16_t bg, uint8_t size = 1, const char *units = NULL);
+	 void end();
+	 uint16_t drawInt(int16_t x, int16_t y, int32_t value, uint8_t width = 0, const char *unit = NULL);
+	 uint16_t drawFixed(int16_t x, int16_t y, int32_t value, uint8_t decimals, uint8_t width = 0, const char *unit = NULL);
+	 /// @brief 文字の高さ
+	 uint16_t height() const { return cellHeight; }
+
+	private:
+	 ST7735 *tft;
+	 bool kanji;				///< trueなら漢字フォント、falseならGFXフォントのアトラス
+	 uint8_t *pixels;		///< アトラス。文字ごとに、幅 x 高さのRGB565（送信順に上位、下位）
+	 uint16_t cellHeight;	///< 文字の高さ
+	 int16_t top;			///< 描画するy座標から、文字の上端までの距離（TextMetrics::topと同じ）
+	 uint8_t count;			///< アトラスの文字数
+	 struct {
+		 uint32_t code;		///< 文字コード（漢字フォントではUTF-8のバイト列を並べた値）
+		 uint16_t width;		///< 送り幅
+		 uint32_t offset;	///< pixels内の位置
+	 } entries[15 + TFT_DIGIT_ATLAS_MAX_UNITS];
+
+	 uint8_t appendUnit(const char *unit, uint8_t *glyphs, uint8_t n);
+	 uint16_t drawGlyphs(int16_t x, int16_t y, const uint8_t *glyphs, uint8_t n);
+};
@@ -6,6 +6,7 @@
 #ifdef USE_MICROPYTHON_MODULE
 // Include MicroPython API.
 	#include "py/runtime.h"
+	#include "ColorConvert.h"
 
 // Declare the function we'll make available in Python as cppexample.cppfunc().
 extern mp_obj_t InitHW(mp_obj_t args);
@@ -25,6 +26,8 @@ extern mp_obj_t setAsciiFont(mp_obj_t a_fontname);
 extern mp_obj_t getAvaiableAsciiFonts();
 extern mp_obj_t drawText(mp_obj_t a_xyfbs, mp_obj_t a_str);
 extern mp_obj_t drawTextKanji(mp_obj_t a_xyfbs, mp_obj_t a_str);
+extern mp_obj_t setKanjiFont(mp_obj_t a_fontname);
+extern mp_obj_t getAvailableKanjiFonts();
 
 // スクロール関連関数
 extern mp_obj_t setScrollDefinition(mp_obj_t a_top, mp_obj_t a_bottom, mp_obj_t a_direction);
@@ -51,10 +54,13 @@ extern mp_obj_t drawLine(mp_obj_t a_xyxy, mp_obj_t a_color);
 
 // ビットマップ関数
 extern mp_obj_t bmpDraw(mp_obj_t a_xywh, mp_obj_t a_bmpData, mp_obj_t a_direction);
+extern mp_obj_t bmpDrawRect(mp_obj_t a_xy, mp_obj_t a_bmpData, mp_obj_t a_src);
 extern mp_obj_t registerBitmap(mp_obj_t a_idx, mp_obj_t a_wh, mp_obj_t a_bmpData);
 extern mp_obj_t bmpRegDraw(mp_obj_t a_idx, mp_obj_t a_xy, mp_obj_t a_direction);
+extern mp_obj_t bmpRegDrawRect(mp_obj_t a_idx, mp_obj_t a_xy, mp_obj_t a_src);
 extern mp_obj_t bmpUseTransColor(mp_obj_t a_c);
 extern mp_obj_t bmpUnuseTransColor();
+extern mp_obj_t drawRGB(mp_obj_t a_xywh, mp_obj_t a_data, mp_obj_t a_format);
 
 // その他
 extern mp_obj_t cppfunc(mp_obj_t a_obj, mp_obj_t b_obj);
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "ST7735_struct.h"
+
+/**
+ * @file GlyphRaster.h
+ * @brief GFXフォントと漢字フォントの１文字を、前景の矩形の並びにする。
+ * @details DigitAtlasのようにメモリ上の画像に文字を描く部品や、tools/labelのようなホスト用のツールで、同じ手順で文字を描くために使う。
+ * 文字の枠は液晶に描画するときと同じで、GFXフォントは drawTextLine と同じく送り幅 x 行の高さ（上端はFontAscent）、
+ * 漢字フォントは文字の幅 x 高さ。枠の外にはみ出す点は切り取る。<br/>
+ * 前景の点は、元の１行の中で続いている点（ラン）をsize倍した矩形ごとに、指定された関数に渡す。
+ * 液晶にはアクセスしないので、ST7735_TFT.hなしで（ホストでも）コンパイルできる。
+ */
+
+struct KanjiGlyph;		// KanjiHelper.hで定義する、漢字フォントの１文字分の情報
+
+/// @brief 前景の矩形を受け取る関数
+/// @param context GlyphRasterの関数に渡した値
+/// @param x 矩形の左端。文字の枠の左上からの距離（拡大後）
+/// @param y 矩形の上端。文字の枠の左上からの距離（拡大後）
+/// @param w 矩形の幅
+/// @param h 矩形の高さ
+typedef void (*GlyphFillFunc)(void *context, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+/// @brief 文字を前景の矩形の並びにするクラス
+class GlyphRaster {
+	public:
+	 static int8_t FontAscent(const GFXfont *font);
+	 static void RasterizeGfx(const GFXfont *font, uint8_t c, int8_t ascent, uint8_t size, GlyphFillFunc fill, void *context);
+	 static void RasterizeKanji(const KanjiGlyph *glyph, uint8_t size, GlyphFillFunc fill, void *context);
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file ImageStream.h
+ * @brief 画像ファイル（QOIなど）を先頭から順に読み出すクラス。
+ * @details 画像のデコーダは、データを先頭から順に読むだけなので、ファイル全体がメモリにある必要はない。
+ * ImageStreamは、メモリ上のデータをそのまま読むか、「続きを読む」関数で少しずつバッファに読み込んで、デコーダに１バイトずつ渡す。
+ * SDカードやフラッシュの別の領域、通信などから読むときは、読み出し関数を指定する。<br/>
+ * 使い方:
+ *
+ *     ImageStream in;
+ *     in.BeginMemory(photo_qoi, sizeof(photo_qoi));	// メモリ上のデータ
+ *     // in.Begin(readFromFile, &file);				// 関数で読み出す
+ */
+
+/// @brief バッファの大きさ（バイト）。読み出し関数はこの大きさ単位で呼ばれる。これより大きなReadは、直接読み込む
+#ifndef TFT_IMAGE_STREAM_BUFFER
+#define TFT_IMAGE_STREAM_BUFFER 64
+#endif
+
+/// @brief 画像データの続きを読み出す関数
+/// @param context Beginで指定した値
+/// @param buffer 読み出したデータを格納する
+/// @param length 読み出すバイト数の上限
+/// @return 読み出したバイト数。データの終わりなら0
+typedef uint32_t (*ImageReadFunc)(void *context, uint8_t *buffer, uint32_t length);
+
+/// @brief 画像データを先頭から順に読み出すクラス
+class ImageStream {
+	public:
+	 ImageStream();
+
+	 void Begin(ImageReadFunc read, void *context);
+	 void BeginMemory(const uint8_t *data, uint32_t size);
+
+	 /// @brief １バイト読む。データの終わりを超えたら0を返し、以後Failed()がtrueになる
+	 uint8_t ReadByte()
+	 {
+		 if (pos < end) return *pos++;
+		 return Refill();
+	 }
+	 bool Read(void *buffer, uint32_t length);
+	 bool Skip(uint32_t length);
+	 uint16_t ReadLE16();
+	 uint32_t ReadLE32();
+	 uint32_t ReadBE32();
+	 /// @brief データの終わりを超えて読もうとしたらtrue
+	 bool Failed() const { return failed; }
+	 /// @brief 先頭から読んだバイト数
+	 uint32_t Position() const { return consumed + (uint32_t)(pos - start); }
+
+	private:
+	 ImageReadFunc read;
+	 void *context;
+	 const uint8_t *start;	///< 今読んでいるブロックの先頭
+	 const uint8_t *pos;		///< 次に読む位置
+	 const uint8_t *end;		///< 今読んでいるブロックの終わり
+	 uint32_t consumed;		///< 今のブロックより前に読んだバイト数
+	 bool failed;
+	 uint8_t buffer[TFT_IMAGE_STREAM_BUFFER];
+
+	 uint8_t Refill();
+};
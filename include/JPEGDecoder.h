@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include "ImageStream.h"
+
+/**
+ * @file JPEGDecoder.h
+ * @brief ベースラインJPEGを、MCU（8x8～16x16の画素のかたまり）ごとに展開して液晶に表示する。
+ * @details 写真やカメラの画像を表示するためのデコーダ。対応するのは、ベースライン（SOF0/SOF1、ハフマン符号、8ビット）の
+ * グレースケールとYCbCrの画像で、サンプリングは4:4:4、4:2:2、4:2:0など（輝度は縦横2倍まで、色差は1x1）。プログレッシブJPEGには対応しない。<br/>
+ * 逆DCTは整数演算。展開したMCUはRGB565にして、MCUごとに１つのアドレスウインドウで送る。画像全体を展開するバッファは使わず、
+ * 使うRAMは、JPEGDecoderのオブジェクト（テーブルとMCUのバッファで約3KB）と、スタック上の逆DCTの作業領域（約0.6KB）と、
+ * Drawが1/8のMCUを横につなげるバッファ（約0.6KB）だけ。<br/>
+ * scaleに2、4、8を指定すると、縦横1/2、1/4、1/8に縮小して展開する。1/8では逆DCTをせず、各ブロックの直流成分だけを使うので速い。
+ * 大きな画像の一覧表示などに使う。<br/>
+ * 使い方:
+ *
+ *     JPEGDecoder jpeg;		// テーブルを持つので、スタックではなく静的に置くとよい
+ *     ImageStream in;
+ *     in.BeginMemory(photo_jpg, sizeof(photo_jpg));
+ *     jpeg.Draw(&tft, 0, 0, in, 2);	// 1/2に縮小して表示
+ *
+ * ホストでは、tools/jpegbench で展開の結果と速さを確かめられる。
+ */
+
+class ST7735;
+
+/// @brief JPEGの画像の情報
+typedef struct {
+	uint16_t width;		///< 幅
+	uint16_t height;	///< 高さ
+	uint8_t components;	///< 1ならグレースケール、3ならYCbCr
+} JPEGInfo;
+
+/// @brief 展開したMCUを受け取る関数
+/// @param context Decodeで指定した値
+/// @param x MCUの左上の、（縮小した）画像の中での座標
+/// @param y MCUの左上の、（縮小した）画像の中での座標
+/// @param w MCUの幅。画像の右端では、はみ出す部分を除いた幅になる
+/// @param h MCUの高さ。画像の下端では、はみ出す部分を除いた高さになる
+/// @param pixels w x h のRGB565の画素。液晶に送る順（上位、下位）に並んでいる
+/// @return 展開を続けるならtrue。falseを返すと、展開をやめる
+typedef bool (*JPEGOutputFunc)(void *context, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *pixels);
+
+/// @brief ベースラインJPEGを展開するクラス
+class JPEGDecoder {
+	public:
+	 JPEGDecoder();
+
+	 bool ReadHeader(ImageStream &in, JPEGInfo *info);
+	 bool Decode(ImageStream &in, uint8_t scale, JPEGOutputFunc output, void *context);
+	#if !defined(TFT_HOST_TOOL)
+	 bool Draw(ST7735 *tft, int16_t x, int16_t y, ImageStream &in, uint8_t scale = 1);
+	 /// @brief メモリ上のJPEGの画像を表示する
+	 bool Draw(ST7735 *tft, int16_t x, int16_t y, const uint8_t *data, uint32_t size, uint8_t scale = 1)
+	 {
+		 ImageStream in;
+		 in.BeginMemory(data, size);
+		 return Draw(tft, x, y, in, scale);
+	 }
+	#endif
+
+	private:
+	 /// @brief ハフマン符号の表
+	 struct Huffman {
+		 bool defined;
+		 int32_t maxCode[17];	///< 符号長ごとの、最大の符号+1
+		 int32_t delta[17];		///< 符号長ごとの、符号から値の位置を求めるための差
+		 uint8_t values[256];	///< 符号の順に並んだ値
+	 };
+	 /// @brief 色成分
+	 struct Component {
+		 uint8_t id;
+		 uint8_t h, v;			///< サンプリング係数
+		 uint8_t quant;			///< 量子化テーブルの番号
+		 uint8_t dcTable, acTable;
+		 int16_t pred;			///< 直前のブロックの直流成分
+	 };
+
+	 uint16_t quant[4][64];		///< 量子化テーブル（ジグザグ順）
+	 Huffman dc[2], ac[2];
+	 Component comp[3];
+	 JPEGInfo info;
+	 uint8_t hMax, vMax;
+	 uint16_t restartInterval;
+
+	 // 符号化データの読み出し
+	 ImageStream *in;
+	 uint32_t bits;				///< 読み込んだビット（上位から使う）
+	 uint8_t bitCount;			///< bitsに残っているビット数
+	 bool marker;				///< マーカーに達した（以後は0を返す）
+	 uint8_t markerCode;			///< 達したマーカー
+
+	 uint8_t blocks[6][64];		///< MCUの各ブロックを展開した値
+	 uint16_t pixels[16 * 16];	///< RGB565にしたMCU（液晶に送る順のバイト）
+
+	 bool ReadSegments(ImageStream &in, bool untilScan);
+	 bool ReadQuant(ImageStream &in, uint16_t length);
+	 bool ReadHuffman(ImageStream &in, uint16_t length);
+	 bool ReadFrame(ImageStream &in, uint16_t length);
+	 bool ReadScan(ImageStream &in, uint16_t length);
+	 void FillBits();
+	 int32_t Receive(uint8_t n);
+	 int16_t DecodeHuffman(const Huffman &table);
+	 bool DecodeBlock(Component &c, uint8_t *out, uint8_t scale);
+	 bool Restart();
+	 void ConvertMCU(uint8_t scale, uint16_t w, uint16_t h);
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file KanjiCodec.h
+ * @brief 圧縮した漢字フォントの復号に使う、コンテキストの計算と２値の算術符号（レンジコーダ）の復号器。
+ * @details ライブラリ(KanjiHelper.cpp)と、テーブルを作るホスト用のツール(tools/kanjifont)の両方から使う。<br/>
+ * 各ドットは、すでに復号した周囲の12ドット（同じ行の左4ドット、１つ上の行の5ドット、２つ上の行の3ドット）を
+ * コンテキストとして、テーブルごとに用意した確率表(model)を使って符号化されている。
+ *
+ *         x-1 x  x+1           ← ２つ上の行
+ *     x-2 x-1 x  x+1 x+2       ← １つ上の行
+ * x-4 x-3 x-2 x-1  ?           ← 復号中の行
+ */
+
+/// @brief コンテキストのビット数。確率表の要素数は 1 << KANJI_CODEC_CONTEXT_BITS
+#define KANJI_CODEC_CONTEXT_BITS 12
+
+/// @brief 圧縮したテーブルで、先頭位置(blocks)を持つ間隔（文字数）。間の文字の位置は、lengthsを足して求める。
+#define KANJI_CODEC_BLOCK 16
+
+/// @brief 圧縮できる文字の最大幅。行を左右に4ドットずつ余白をつけて32ビットで持つため。
+#define KANJI_CODEC_MAX_WIDTH 24
+
+/// @brief 各行は、左右に4ドットの余白をつけて保持する。列xのドットはビット (w + 3 - x) にある。
+/// @param cur 復号中の行
+/// @param prev1 １つ上の行
+/// @param prev2 ２つ上の行
+/// @param x 列
+/// @param w 文字の幅
+/// @return コンテキスト（0 ～ 4095）
+static inline uint16_t kanjiCodecContext(uint32_t cur, uint32_t prev1, uint32_t prev2, uint8_t x, uint8_t w)
+{
+	uint8_t s = w - x;
+	return ((cur >> (s + 4)) & 0x0F) | (((prev1 >> (s + 1)) & 0x1F) << 4) | (((prev2 >> (s + 2)) & 0x07) << 9);
+}
+
+/// @brief ２値のレンジコーダの復号器。
+/// @details 入力の終わりより後は0が続いているものとして読む（符号化側は末尾の0を省略している）。
+typedef struct {
+	const uint8_t *src;		///< 次に読むバイト
+	const uint8_t *end;		///< 入力の終わり
+	uint32_t range;
+	uint32_t code;
+} KanjiRangeDecoder;
+
+static inline uint8_t kanjiCodecNextByte(KanjiRangeDecoder *d)
+{
+	return (d->src < d->end) ? *d->src++ : 0;
+}
+
+/// @brief 復号を始める
+/// @param d 復号器
+/// @param src 符号化されたデータ
+/// @param length データのバイト数
+static inline void kanjiCodecBegin(KanjiRangeDecoder *d, const uint8_t *src, size_t length)
+{
+	d->src = src;
+	d->end = src + length;
+	d->range = 0xFFFFFFFF;
+	d->code = 0;
+	for (int i = 0; i < 4; i++) {
+		d->code = (d->code << 8) | kanjiCodecNextByte(d);
+	}
+}
+
+/// @brief １ビット復号する
+/// @param d 復号器
+/// @param p0 ビットが0である確率（4096分率）
+/// @return 復号したビット
+static inline uint8_t kanjiCodecDecodeBit(KanjiRangeDecoder *d, uint16_t p0)
+{
+	uint32_t bound = (d->range >> 12) * p0;
+	uint8_t bit;
+	if (d->code < bound) {
+		d->range = bound;
+		bit = 0;
+	} else {
+		d->code -= bound;
+		d->range -= bound;
+		bit = 1;
+	}
+	while (d->range < (1u << 24)) {
+		d->range <<= 8;
+		d->code = (d->code << 8) | kanjiCodecNextByte(d);
+	}
+	return bit;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "KanjiHelper.h"
+
+/**
+ * @file KanjiFontBlob.h
+ * @brief プログラムに組み込まない漢字フォント（フォントブロブ）を読み出すクラス。
+ * @details フォントブロブは、tools/kanjifont の --blob で作る、パック形式のテーブルをそのまま並べたバイナリファイル。
+ * フラッシュの別の領域やファイルに置いておけば、プログラムとは別に更新でき、複数の大きさのフォントを置いてもプログラムは大きくならない。<br/>
+ * データは「オフセットを指定して読む」関数を通して読み出す。読み出した文字のビットマップはSRAM上のキャッシュに
+ * 保持し、最も長く使われていないものから入れ替える(LRU)。<br/>
+ * 使い方:
+ *
+ *     KanjiFontBlob blob;
+ *     blob.BeginMemory((const uint8_t *)(XIP_BASE + FONT_OFFSET), FONT_SIZE);	// XIPで読めるフラッシュの領域
+ *     KanjiHelper::SetFontBlob(&blob);
+ */
+
+/// @brief キャッシュに保持する文字数
+#ifndef TFT_KANJI_CACHE_GLYPHS
+#define TFT_KANJI_CACHE_GLYPHS 32
+#endif
+
+/// @brief キャッシュの１文字分の大きさ（バイト）。KANJI_CODEC_MAX_WIDTH x KANJI_CODEC_MAX_WIDTH の文字まで入る
+#define TFT_KANJI_CACHE_SLOT_BYTES ((KANJI_CODEC_MAX_WIDTH * KANJI_CODEC_MAX_WIDTH + 7) / 8)
+
+/// @brief フォントブロブの先頭のヘッダ。数値はすべてリトルエンディアン。
+/// @details 各オフセットはファイルの先頭からのバイト位置で、4バイト境界に揃えられている。ないデータは0。
+typedef struct {
+	char magic[4];				///< "KFNT"
+	uint8_t version;			///< 形式の版。KANJI_BLOB_VERSION
+	uint8_t width;				///< 全角文字の幅
+	uint8_t height;				///< 全角文字の高さ
+	uint8_t asciiWidth;			///< 半角文字の幅
+	uint8_t asciiHeight;		///< 半角文字の高さ
+	uint8_t reserved;
+	uint16_t count;				///< 全角文字の数
+	uint32_t bucket;			///< KanjiFontTableの各配列の位置
+	uint32_t codes;
+	uint32_t bitmaps;
+	uint32_t asciiBitmaps;
+	uint32_t sjis;
+	uint32_t jis;
+	uint32_t model;
+	uint32_t lengths;
+	uint32_t blocks;
+} KanjiBlobHeader;
+
+#define KANJI_BLOB_VERSION 1
+
+/// @brief フォントブロブからデータを読み出す関数
+/// @param context Beginで指定した値
+/// @param offset ブロブの先頭からのバイト位置
+/// @param buffer 読み出したデータを格納する
+/// @param length 読み出すバイト数
+/// @return 読み出せたらtrue
+typedef bool (*KanjiReadFunc)(void *context, uint32_t offset, void *buffer, uint32_t length);
+
+/// @brief フォントブロブを読み出すクラス
+class KanjiFontBlob {
+	public:
+	 KanjiFontBlob();
+	 ~KanjiFontBlob();
+
+	 bool Begin(KanjiReadFunc read, void *context);
+	 bool BeginMemory(const uint8_t *data, uint32_t size);
+	#if defined(__linux__)
+	 bool OpenFile(const char *path);
+	#endif
+	 void End();
+
+	 /// @brief 文字の大きさと文字数。配列へのポインタはすべてNULL
+	 const KanjiFontTable &Table() const { return table; }
+	 int32_t FindKanji(uint32_t codeUTF);
+	 bool GetGlyph(uint32_t code, KanjiGlyph *glyph);
+	 uint16_t GetSjis(int32_t index);
+	 uint16_t GetJis(int32_t index);
+
+	 /// @brief キャッシュに見つかった回数
+	 uint32_t CacheHits() const { return cacheHits; }
+	 /// @brief キャッシュになく、読み出した回数
+	 uint32_t CacheMisses() const { return cacheMisses; }
+
+	private:
+	 KanjiReadFunc read;
+	 void *context;
+	 KanjiBlobHeader header;
+	 KanjiFontTable table;
+	 uint16_t bucket[257];		///< 検索のたびに読まないように、bucketはSRAMに置く
+
+	 const uint8_t *memoryData;	///< BeginMemoryで指定された領域
+	 uint32_t memorySize;
+	 bool mapped;				///< OpenFileでmmapした領域
+	 uint8_t *modelBuffer;		///< Beginで読み込んだ確率表。メモリから読めるブロブではNULL
+
+	 struct {
+		 uint32_t code;			///< キャッシュしている文字のコード。0は空き
+		 uint32_t lastUse;		///< 最後に使ったときのuseCounter
+	 } cacheTags[TFT_KANJI_CACHE_GLYPHS];
+	 uint8_t cacheData[TFT_KANJI_CACHE_GLYPHS][TFT_KANJI_CACHE_SLOT_BYTES];
+	 uint32_t useCounter;
+	 uint32_t cacheHits;
+	 uint32_t cacheMisses;
+
+	 static bool readMemory(void *context, uint32_t offset, void *buffer, uint32_t length);
+	 bool loadGlyph(uint32_t code, int32_t index, uint8_t *slot);
+};
@@ -1,68 +1,279 @@
 #pragma once
-#pragma GCC optimize("O0")
 #include <errno.h>
 #include <iconv.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include "ST7735_struct.h"
+#include "KanjiCodec.h"
 
 /// @brief 使用する漢字データの大きさを指定する。<br/>
 /// - 16...全角 16x16 半角8x16<br/>
 /// - 12...全角 12x12 半角6x12<br/>
 /// - 8....全角  8x 8 半角4x8 (かなり視認性は低い）<br/>
+#ifndef TFT_KANJI_DOT
 #define TFT_KANJI_DOT 12
+#endif
 
 /// @brief 使用する漢字データの種類を指定する。<br/>
-/// - 0...JISに定義されているすべてのコード（約6800文字、289KBytes/16dot) <br/>
-/// - 1...JIS第一水準+かな+カナ+記号1,2+ギリシャ+キリル+罫線（約3400文字、83KBytes/16dot) <br/>
-/// - 2...常用漢字+かな+カナ+記号1,2（約2500文字、79KBytes/16dot) <br/>
-/// - 3...教育漢字+かな+カナ+記号1,2（約840文字、 25KBytes/16dot) <br/>
+/// - 0...JISに定義されているすべてのコード（約6800文字、226KBytes/16dot) <br/>
+/// - 1...JIS第一水準+かな+カナ+記号1,2+ギリシャ+キリル+罫線（約3400文字、117KBytes/16dot) <br/>
+/// - 2...常用漢字+かな+カナ+記号1,2（約2500文字、85KBytes/16dot) <br/>
+/// - 3...教育漢字+かな+カナ+記号1,2（約840文字、 31KBytes/16dot) <br/>
+#ifndef TFT_KANJI_LEVEL
 #define TFT_KANJI_LEVEL 0
+#endif
+
+/// @brief 定義すると、全角文字のビットマップを圧縮したテーブル（Font_Kanji*Z.inc）を使う。<br/>
+/// 16ドットのすべての文字（TFT_KANJI_LEVEL 0）で、ビットマップは約220KBytesから約128KBytesになる。
+/// 描画時に１行ずつ復号するため、１文字の描画にかかる時間は数倍になる（通信時間に比べれば小さい）。<br/>
+/// 8ドットのテーブルは圧縮してもほとんど小さくならないため、この指定は無視される。
+//#define TFT_KANJI_COMPRESSED
+
+/// @brief tools/kanjifontで作成したテーブルを使う場合に、そのファイルを指定する。<br/>
+/// アプリケーションで使う文字だけを集めたテーブル（kanjifont の --subset）を使うと、数百文字なら数KBytesで済む。
+/// TFT_KANJI_FONT には、テーブルを作るときに指定した名前を定義する。
+/// 指定した場合、TFT_KANJI_DOT、TFT_KANJI_LEVEL、TFT_KANJI_COMPRESSED は無視される。
+//#define TFT_KANJI_FONT_FILE "font/Font_KanjiApp.inc"
+//#define TFT_KANJI_FONT KanjiApp
+
+/// @brief 半角カナ文字の扱いを決定する
+/// @details 通常Unicodeのエディタ（VS Code)では、半角カナ文字をefbda1～efbdffまでの3バイト文字セットと
+/// して格納し、コンパイル時もそれが使用される。多バイト文字での半角表現は、JISコードには含まれていないため、
+/// UTF-8からJISへの変換で範囲外となってしまい、表示できない。
+/// このフラグを有効にすると、半角カナ文字（UTF:efbda1～efbdff)を、１バイト文字コード(a1～ff)として扱う
+/// ことで、UTF-8表現エディタで作成・コンパイルしたプログラムで半角カナを正しく表示できるようになる。
+#define TFT_FORCE_HANKANA
+
+/// @brief TFT_FORCE_HANKANAの指定。KanjiHelper::DecodeUTF8などに渡す値は、すべてこれを使う
+#ifdef TFT_FORCE_HANKANA
+constexpr bool kanjiForceHankana = true;
+#else
+constexpr bool kanjiForceHankana = false;
+#endif
+
+/// @brief 漢字フォントのテーブル。tools/kanjifontで作成したFont_Kanji*.incが、この構造体を１つ定義する。
+/// @details 文字の大きさはテーブル内で共通なので、文字ごとには持たない。<br/>
+/// 文字の検索には、コードポイントの上位8ビットごとの開始位置(bucket)と、下位8ビットだけを並べた配列(codes)を使う。
+/// 検索で読むのは密に並んだ1バイトの配列だけなので、XIPキャッシュに載りやすい。<br/>
+/// ビットマップの行はビット単位で詰められていて（12ドットの文字は１行12ビット）、１文字ごとにバイト境界に揃えられている。<br/>
+/// テーブルの実体は、TFT_KANJI_FONT_IMPLを定義してからこのファイルをインクルードした翻訳単位（KanjiHelper.cpp）にだけ置かれる。<br/>
+/// 圧縮したテーブルでは、bitmapsには各文字を符号化したバイト列が並び、modelがNULL以外になる（KanjiCodec.h）。
+typedef struct KanjiFontTable {
+	uint8_t width;					///< 全角文字の幅
+	uint8_t height;					///< 全角文字の高さ
+	uint8_t asciiWidth;				///< 半角文字の幅
+	uint8_t asciiHeight;			///< 半角文字の高さ
+	uint16_t count;					///< 全角文字の数
+	const uint16_t *bucket;			///< コードポイントの上位8ビットごとの、codesの開始位置（257要素）
+	const uint8_t *codes;			///< コードポイントの下位8ビット（count要素）
+	const uint8_t *bitmaps;			///< 全角文字のビットマップ
+	const uint8_t *asciiBitmaps;	///< 半角文字(1～255)のビットマップ
+	const uint16_t *sjis;			///< シフトJISコード（count要素）。TFT_KANJI_SJIS_TABLEが未定義のときはNULL
+	const uint16_t *jis;			///< JISコード（count要素）。TFT_KANJI_SJIS_TABLEが未定義のときはNULL
+	const uint8_t *model;			///< 圧縮に使った確率表。圧縮していないテーブルではNULL
+	const uint8_t *lengths;			///< 各文字の符号のバイト数（count要素）。圧縮していないテーブルではNULL
+	const uint32_t *blocks;			///< KANJI_CODEC_BLOCK文字ごとの、bitmaps内の先頭位置。圧縮していないテーブルではNULL
+} KanjiFontTable;
+
+/// @brief 文字の検索に必要な部分だけを取り出した、コンパイル時に使える漢字フォントの索引（KanjiText.h）
+/// @details Font_Kanji*.incが、テーブル名_index という名前で inline constexpr で定義する。bucketとcodesはテーブルと共有している。
+typedef struct KanjiFontIndex {
+	uint8_t width;					///< 全角文字の幅
+	uint8_t height;					///< 全角文字の高さ
+	uint8_t asciiWidth;				///< 半角文字の幅
+	uint8_t asciiHeight;			///< 半角文字の高さ
+	uint16_t count;					///< 全角文字の数
+	const uint16_t *bucket;			///< KanjiFontTable::bucketと同じ
+	const uint8_t *codes;			///< KanjiFontTable::codesと同じ
+} KanjiFontIndex;
+
+/// @brief 漢字フォントから取り出した１文字分の情報
+typedef struct KanjiGlyph {
+	const uint8_t *bitmap;			///< ビットマップの先頭。行はビット単位で詰められている
+	const uint8_t *model;			///< 圧縮されているときは確率表、されていないときはNULL
+	uint8_t length;					///< 圧縮されているときの符号のバイト数
+	uint8_t width;					///< 文字の幅
+	uint8_t height;					///< 文字の高さ
+} KanjiGlyph;
+
+/// @brief KanjiHelper::GetGlyphAtに渡す文字の番号で、半角文字であることを示すビット。下位8ビットが文字コードになる
+#define KANJI_GLYPH_ASCII 0x8000
+
+/// @brief KanjiGlyphのビットマップを、上の行から１行ずつ取り出す
+/// @details 圧縮された文字も、直前の２行だけを保持して１行ずつ復号するので、文字全体を展開するバッファは要らない。<br/>
+/// 文字の幅は、圧縮されていない文字もKANJI_CODEC_MAX_WIDTHまでにする（行を32ビットで切り出すため）。
+class KanjiRowReader {
+	public:
+	 void Begin(const KanjiGlyph *glyph);
+	 uint32_t NextRow();
+
+	private:
+	 const uint8_t *bitmap;
+	 const uint8_t *model;
+	 uint32_t bit;				///< 圧縮されていないときの、次の行の先頭のビット位置
+	 uint32_t prev1, prev2;		///< 圧縮されているときの、直前の２行（KanjiCodec.hの形式）
+	 uint8_t width;
+	 KanjiRangeDecoder decoder;
+};
 
-#if TFT_KANJI_DOT == 16
+#if defined(TFT_KANJI_FONT_FILE)
+	#include TFT_KANJI_FONT_FILE
+	#ifndef TFT_KANJI_FONT
+		#error "TFT_KANJI_FONT_FILE を指定した場合は、TFT_KANJI_FONT にテーブル名を定義してください"
+	#endif
+#elif TFT_KANJI_DOT == 16
 	#if TFT_KANJI_LEVEL == 0
-		#include "font/Font_Kanji16All.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji16AllZ.inc"
+			#define TFT_KANJI_FONT Kanji16AllZ
+		#else
+			#include "font/Font_Kanji16All.inc"
+			#define TFT_KANJI_FONT Kanji16All
+		#endif
 	#elif TFT_KANJI_LEVEL == 1
-		#include "font/Font_Kanji16Level1.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji16Level1Z.inc"
+			#define TFT_KANJI_FONT Kanji16Level1Z
+		#else
+			#include "font/Font_Kanji16Level1.inc"
+			#define TFT_KANJI_FONT Kanji16Level1
+		#endif
 	#elif TFT_KANJI_LEVEL == 2
-		#include "font/Font_Kanji16Jyoyo.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji16JyoyoZ.inc"
+			#define TFT_KANJI_FONT Kanji16JyoyoZ
+		#else
+			#include "font/Font_Kanji16Jyoyo.inc"
+			#define TFT_KANJI_FONT Kanji16Jyoyo
+		#endif
 	#elif TFT_KANJI_LEVEL == 3
-		#include "font/Font_Kanji16Kyoiku.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji16KyoikuZ.inc"
+			#define TFT_KANJI_FONT Kanji16KyoikuZ
+		#else
+			#include "font/Font_Kanji16Kyoiku.inc"
+			#define TFT_KANJI_FONT Kanji16Kyoiku
+		#endif
 	#endif
 #elif TFT_KANJI_DOT == 12
 	#if TFT_KANJI_LEVEL == 0
-		#include "font/Font_Kanji12All.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji12AllZ.inc"
+			#define TFT_KANJI_FONT Kanji12AllZ
+		#else
+			#include "font/Font_Kanji12All.inc"
+			#define TFT_KANJI_FONT Kanji12All
+		#endif
 	#elif TFT_KANJI_LEVEL == 1
-		#include "font/Font_Kanji12Level1.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji12Level1Z.inc"
+			#define TFT_KANJI_FONT Kanji12Level1Z
+		#else
+			#include "font/Font_Kanji12Level1.inc"
+			#define TFT_KANJI_FONT Kanji12Level1
+		#endif
 	#elif TFT_KANJI_LEVEL == 2
-		#include "font/Font_Kanji12Jyoyo.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji12JyoyoZ.inc"
+			#define TFT_KANJI_FONT Kanji12JyoyoZ
+		#else
+			#include "font/Font_Kanji12Jyoyo.inc"
+			#define TFT_KANJI_FONT Kanji12Jyoyo
+		#endif
 	#elif TFT_KANJI_LEVEL == 3
-		#include "font/Font_Kanji12Kyoiku.inc"
+		#ifdef TFT_KANJI_COMPRESSED
+			#include "font/Font_Kanji12KyoikuZ.inc"
+			#define TFT_KANJI_FONT Kanji12KyoikuZ
+		#else
+			#include "font/Font_Kanji12Kyoiku.inc"
+			#define TFT_KANJI_FONT Kanji12Kyoiku
+		#endif
 	#endif
 #elif TFT_KANJI_DOT == 8
 	#if TFT_KANJI_LEVEL == 0
 		#include "font/Font_Kanji8All.inc"
+		#define TFT_KANJI_FONT Kanji8All
 	#elif TFT_KANJI_LEVEL == 1
 		#include "font/Font_Kanji8Level1.inc"
+		#define TFT_KANJI_FONT Kanji8Level1
 	#elif TFT_KANJI_LEVEL == 2
 		#include "font/Font_Kanji8Jyoyo.inc"
+		#define TFT_KANJI_FONT Kanji8Jyoyo
 	#elif TFT_KANJI_LEVEL == 3
 		#include "font/Font_Kanji8Kyoiku.inc"
+		#define TFT_KANJI_FONT Kanji8Kyoiku
 	#endif
 #endif
 
+/// @brief 既定のフォント（上で選んだもの）のほかに、KanjiHelper::SetFont / ST7735::setKanjiFont で切り替えて使うテーブル（最大3つ）。<br/>
+/// TFT_KANJI_EXTRA_FILEn にファイル名、TFT_KANJI_EXTRA_FONTn にそのファイルで定義されているテーブル名を指定する。
+/// テーブルは、そのテーブル名で registeredKanjiFonts に登録される。<br/>
+/// 検索に使う索引は各テーブルに含まれているので、切り替えはポインタを付け替えるだけで済む。
+//#define TFT_KANJI_EXTRA_FILE1 "font/Font_Kanji16Jyoyo.inc"
+//#define TFT_KANJI_EXTRA_FONT1 Kanji16Jyoyo
+//#define TFT_KANJI_EXTRA_FILE2 "font/Font_Kanji8Kyoiku.inc"
+//#define TFT_KANJI_EXTRA_FONT2 Kanji8Kyoiku
+#ifdef TFT_KANJI_EXTRA_FILE1
+	#include TFT_KANJI_EXTRA_FILE1
+#endif
+#ifdef TFT_KANJI_EXTRA_FILE2
+	#include TFT_KANJI_EXTRA_FILE2
+#endif
+#ifdef TFT_KANJI_EXTRA_FILE3
+	#include TFT_KANJI_EXTRA_FILE3
+#endif
+
+/// @brief 名前で指定できる漢字フォントの最大数
+#define TFT_MAX_KANJI_FONTS 4
+
+/// @brief 名前で指定できるように登録した漢字フォント
+typedef struct {
+	const char *name;
+	const KanjiFontTable *table;
+} RegisteredKanjiFont;
+
+/// @brief 登録済みの漢字フォントの一覧。先頭は既定のフォント。実体はKanjiHelper.cppに置かれる。
+extern RegisteredKanjiFont registeredKanjiFonts[TFT_MAX_KANJI_FONTS];
+
+/// @brief 漢字文字列をレイアウトしたときの１行分の情報
+typedef struct KanjiLine {
+	uint16_t start;		///< 行の先頭の、文字列先頭からのバイト位置
+	uint16_t length;	///< 行のバイト数（改行文字は含まない）
+	uint16_t width;		///< 行の表示幅（ドット）
+	uint16_t next;		///< 次の行の先頭のバイト位置
+} KanjiLine;
+
+class KanjiFontBlob;
 
 /// @brief 漢字フォントのデータを管理するためのクラス。staticなメソッドしか持たない
+/// @details 使用するテーブルはSetFontで切り替えられる。
+/// SetFontBlobでフォントブロブ（KanjiFontBlob.h）が指定されている間は、組み込みのテーブルの代わりにそれを使う。
 class KanjiHelper {
 	private:
 	KanjiHelper() {};
 	 ~KanjiHelper() {};
 
 	private:
-	 static int compareUnicode(const void* a, const void* b);
-	 static const KanjiFont* binarySearchUnicode(const KanjiFont array[], size_t size, uint32_t unicode);
-	 static const AsciiFont* SearchAscii(const AsciiFont array[],uint8_t asciicode);
+	 static uint32_t codePoint(uint32_t codeUTF);
+	 static bool findCode(const uint32_t array[], size_t size, uint32_t code);
+	 static bool canBreakBetween(uint32_t prev, uint32_t next);
+	 static KanjiFontBlob *fontBlob;
+	 static const KanjiFontTable *currentTable;
 
 	public:
-	 static const KanjiFont* FindKanji(uint32_t codeUTF);
-	 static const AsciiFont* FindAscii(uint8_t codeAscii);
+	 static void SetFont(const KanjiFontTable *table);
+	 static bool SetFont(const char *name);
+	 static void SetFontBlob(KanjiFontBlob *blob);
+	 static const KanjiFontTable &Table();
+	 static int32_t FindKanji(uint32_t codeUTF);
+	 static bool GetGlyph(uint32_t code, KanjiGlyph *glyph);
+	 static bool GetGlyphAt(const KanjiFontTable &table, uint16_t glyphIndex, KanjiGlyph *glyph);
+	 static uint16_t GetSjis(int32_t index);
+	 static uint16_t GetJis(int32_t index);
+	 static uint8_t DecodeUTF8(const char *text, uint32_t *code, bool forceHankana);
+	 static bool GetGlyphSize(uint32_t code, uint8_t *w, uint8_t *h);
+	 static bool IsNoBreakBefore(uint32_t code);
+	 static bool IsNoBreakAfter(uint32_t code);
+	 static uint16_t LayoutLines(const char *text, uint16_t startX, uint16_t wrapWidth, uint8_t size, bool forceHankana, KanjiLine *lines, uint16_t maxLines);
 };
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "ST7735_TFT.h"
+#include "KanjiHelper.h"
+
+/**
+ * @file KanjiText.h
+ * @brief 文字列リテラルを、コンパイル時に漢字フォントの文字の番号の並びに変換する。
+ * @details 表示する文字列が決まっている場合、UTF-8の解釈とテーブルの検索を実行時に毎回行う必要はない。
+ * TFT_KANJI_TEXT で作った KanjiText は、文字の番号と全体の幅だけを持ち、ST7735::drawTextKanji で検索なしに描画できる。<br/>
+ * フォントにない文字や不正なUTF-8が含まれていると、glyph_not_in_kanji_font / invalid_utf8_in_kanji_text の
+ * 呼び出しとしてコンパイルエラーになるので、表示されない文字に実行時に気づく、ということがなくなる。<br/>
+ * テーブルの索引（テーブル名_index）をconstexprとして読むため、C++17以降が必要。<br/>
+ * 使い方:
+ *
+ *     static constexpr auto title = TFT_KANJI_TEXT("温度：２５℃");
+ *     tft.drawTextKanji((160 - title.width) / 2, 0, title, ST7735_WHITE, ST7735_BLACK);
+ *
+ *     static constexpr auto small = TFT_KANJI_TEXT_FOR(Kanji16Jyoyo, "設定");	// TFT_KANJI_EXTRA_FILEnで読み込んだテーブル
+ */
+
+/// @brief コンパイル時に文字の番号に変換した文字列
+/// @tparam N 文字数
+template<size_t N>
+struct KanjiText {
+	const KanjiFontTable *table;	///< 番号を求めたテーブル
+	uint16_t count;					///< 文字数
+	uint16_t width;					///< 全体の幅（ドット、size=1のとき）
+	uint16_t height;				///< 全角文字の高さ（ドット、size=1のとき）
+	uint16_t glyphs[N ? N : 1];		///< 文字の番号。半角文字は KANJI_GLYPH_ASCII | 文字コード
+};
+
+/// @brief コンパイル時にフォントにない文字が見つかったときに呼ぶ。constexprではないので、コンパイルエラーになる
+void glyph_not_in_kanji_font();
+/// @brief コンパイル時に不正なUTF-8が見つかったときに呼ぶ。constexprではないので、コンパイルエラーになる
+void invalid_utf8_in_kanji_text();
+
+namespace KanjiTextImpl {
+
+/// @brief KanjiHelper::DecodeUTF8と同じ規則で、１文字分の文字コードを取り出す
+/// @return 文字のバイト数
+constexpr uint8_t decode(const char *text, uint32_t &code)
+{
+	uint8_t t0 = (uint8_t)text[0];
+	uint8_t step = 0;
+	if ((t0 & 0x80) == 0x00) {
+		step = 1;
+	} else if ((t0 & 0xE0) == 0xC0) {
+		step = 2;
+	} else if ((t0 & 0xF0) == 0xE0) {
+		step = 3;
+	} else if ((t0 & 0xF8) == 0xF0) {
+		step = 4;
+	} else {
+		invalid_utf8_in_kanji_text();
+	}
+	code = 0;
+	for (uint8_t i = 0; i < step; i++) {
+		uint8_t c = (uint8_t)text[i];
+		if (i > 0 && (c & 0xC0) != 0x80) {
+			invalid_utf8_in_kanji_text();
+		}
+		code = (code << 8) | c;
+	}
+	if (kanjiForceHankana) {					// 半角カナを1バイト文字として処理
+		if ((code >> 8) == 0xEFBD) {
+			code = code & 0xFF;
+		} else if ((code >> 8) == 0xEFBE) {
+			code = (code & 0xFF) + 0x40;
+		}
+	}
+	return step;
+}
+
+/// @brief 文字数を数える
+constexpr size_t count(const char *text)
+{
+	size_t n = 0;
+	for (size_t i = 0; text[i] != 0; n++) {
+		uint32_t code = 0;
+		i += decode(&text[i], code);
+	}
+	return n;
+}
+
+/// @brief KanjiHelper::FindKanjiと同じ方法で、索引から文字を探す
+/// @return 文字の番号。見つからないときはコンパイルエラー
+constexpr uint16_t find(const KanjiFontIndex &index, uint32_t code)
+{
+	uint32_t cp = code;
+	if (code > 0xFFFFFF) {
+		glyph_not_in_kanji_font();		// テーブルにはBMPの文字しかない
+	} else if (code > 0xFFFF) {
+		cp = ((code >> 16) & 0x0F) << 12 | ((code >> 8) & 0x3F) << 6 | (code & 0x3F);
+	} else if (code > 0x7F) {
+		cp = ((code >> 8) & 0x1F) << 6 | (code & 0x3F);
+	}
+	uint8_t low = cp & 0xFF;
+	int32_t left = index.bucket[cp >> 8];
+	int32_t right = index.bucket[(cp >> 8) + 1] - 1;
+	while (left <= right) {
+		int32_t middle = left + (right - left) / 2;
+		if (index.codes[middle] == low) {
+			return middle;
+		} else if (index.codes[middle] < low) {
+			left = middle + 1;
+		} else {
+			right = middle - 1;
+		}
+	}
+	glyph_not_in_kanji_font();
+	return 0;
+}
+
+/// @brief 文字列を文字の番号の並びに変換する
+template<size_t N>
+constexpr KanjiText<N> resolve(const char *text, const KanjiFontIndex &index, const KanjiFontTable *table)
+{
+	KanjiText<N> result {table, 0, 0, index.height, {}};
+	for (size_t i = 0; text[i] != 0;) {
+		uint32_t code = 0;
+		i += decode(&text[i], code);
+		if (code <= 0xFF) {				// 半角文字は、0x00を除く255が必ずある
+			result.glyphs[result.count++] = KANJI_GLYPH_ASCII | code;
+			result.width += index.asciiWidth;
+		} else {
+			result.glyphs[result.count++] = find(index, code);
+			result.width += index.width;
+		}
+	}
+	return result;
+}
+
+}  // namespace KanjiTextImpl
+
+#define TFT_KANJI_TEXT_INDEX_(font) font##_index
+#define TFT_KANJI_TEXT_INDEX(font) TFT_KANJI_TEXT_INDEX_(font)
+
+/// @brief 文字列リテラルを、指定したテーブルの文字の番号に変換した KanjiText を作る
+/// @param font テーブル名（Kanji16Allなど）。そのテーブルのFont_Kanji*.incがインクルードされている必要がある
+/// @param str UTF-8の文字列リテラル
+#define TFT_KANJI_TEXT_FOR(font, str) ([] {                                                         \
+	constexpr size_t n = KanjiTextImpl::count(str);                                                 \
+	constexpr KanjiText<n> t = KanjiTextImpl::resolve<n>(str, TFT_KANJI_TEXT_INDEX(font), &font);   \
+	return t;                                                                                       \
+}())
+
+/// @brief 文字列リテラルを、既定のフォント（TFT_KANJI_FONT）の文字の番号に変換した KanjiText を作る
+/// @param str UTF-8の文字列リテラル
+#define TFT_KANJI_TEXT(str) TFT_KANJI_TEXT_FOR(TFT_KANJI_FONT, str)
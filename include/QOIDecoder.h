@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include "ST7735_TFT.h"
+#include "ImageStream.h"
+
+/**
+ * @file QOIDecoder.h
+ * @brief QOI形式（The Quite OK Image Format）の画像を、展開しながら液晶に表示する。
+ * @details QOIは、写真や画面のキャプチャを、uint16_tの配列の数分の１に小さくでき、展開も簡単で速い画像形式。
+ * 画素はRGB(A)888なので、１画素ずつRGB565に変換し、１行ずつ送る。画像全体を展開するバッファは使わず、
+ * 使うRAMは、直前の色の表（256バイト）と１行分のバッファだけ。<br/>
+ * RGBの画像は、見えている範囲で１回だけアドレスウインドウを設定する。RGBAの画像は、アルファが128未満の画素を透過として、
+ * 透過しない画素のランごとに描画する。<br/>
+ * 使い方:
+ *
+ *     ImageStream in;
+ *     in.BeginMemory(photo_qoi, sizeof(photo_qoi));
+ *     QOIDecoder::Draw(&tft, 0, 0, in);
+ */
+
+/// @brief QOI形式の画像の情報
+typedef struct {
+	uint32_t width;		///< 幅
+	uint32_t height;	///< 高さ
+	uint8_t channels;	///< 3ならRGB、4ならRGBA
+} QOIInfo;
+
+/// @brief QOI形式の画像を展開して表示するクラス
+class QOIDecoder {
+	public:
+	 static bool ReadHeader(ImageStream &in, QOIInfo *info);
+	 static bool Draw(ST7735 *tft, int16_t x, int16_t y, ImageStream &in);
+	 /// @brief メモリ上のQOI形式の画像を表示する
+	 static bool Draw(ST7735 *tft, int16_t x, int16_t y, const uint8_t *data, uint32_t size)
+	 {
+		 ImageStream in;
+		 in.BeginMemory(data, size);
+		 return Draw(tft, x, y, in);
+	 }
+};
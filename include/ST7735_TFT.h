@@ -23,6 +23,7 @@
 #include "ST7735_commands.h"
 #include "ST7735_initcmd.h"
 #include "ST7735_struct.h"
+#include "ColorConvert.h"
 #include "TextFonts.h"
 
 /// @brief フォント機能を有効にするかのフラグ。
@@ -45,13 +46,7 @@
 /// フラッシュ側（プログラムメモリ）で消費する
 #define TFT_ENABLE_KANJI
 
-/// @brief 半角カナ文字の扱いを決定する
-/// @details 通常Unicodeのエディタ（VS Code)では、半角カナ文字をefbda1～efbdffまでの3バイト文字セットと
-/// して格納し、コンパイル時もそれが使用される。多バイト文字での半角表現は、JISコードには含まれていないため、
-/// UTF-8からJISへの変換で範囲外となってしまい、表示できない。
-/// このフラグを有効にすると、半角カナ文字（UTF:efbda1～efbdff)を、１バイト文字コード(a1～ff)として扱う
-/// ことで、UTF-8表現エディタで作成・コンパイルしたプログラムで半角カナを正しく表示できるようになる。
-#define TFT_FORCE_HANKANA
+// 半角カナ文字の扱い（TFT_FORCE_HANKANA）は、ホスト用のツールと同じ設定にするため、KanjiHelper.hで指定する。
 
 // #define TFT_ENABLE_GENERIC
 
@@ -110,14 +105,36 @@
 
 // extern uint8_t tft_width, tft_height;
 
+#ifdef TFT_ENABLE_KANJI
+struct KanjiLine;		// KanjiHelper.hで定義する、漢字文字列の行情報
+struct KanjiGlyph;		// KanjiHelper.hで定義する、漢字フォントの１文字分の情報
+struct KanjiFontTable;	// KanjiHelper.hで定義する、漢字フォントのテーブル
+template<size_t N> struct KanjiText;	// KanjiText.hで定義する、コンパイル時に文字の番号に変換した文字列
+#endif
+
 
 /// @brief 画面表示のクラス。インスタンス化して使用する。
 class ST7735 {
    private:
 	static const uint8_t ASCII_OFFSET = 0x20;  // ASCII フォントの字体テーブルの開始文字。0x20
+	static const uint16_t LINE_BUFFER_PIXELS = TFT_LINE_BUFFER_PIXELS;  // 1ライン分の画素を送信するためのバッファの画素数
 	
 	bool bTextWrap = true;
 
+	/// @brief measureText、measureTextKanjiの結果を保存しておくキャッシュの数
+	static const uint8_t METRICS_CACHE_SIZE = 4;
+	/// @brief measureText、measureTextKanjiの結果のキャッシュ。同じ文字列を何度も測るときに、文字の検索をしなくて済むようにする。
+	struct {
+		uint32_t hash;         // 文字列のハッシュ値（FNV-1a）
+		uint16_t length;       // 文字列の長さ
+		const void *font;      // 測ったときのフォント
+		uint16_t wrapWidth;    // 測ったときの折り返し幅
+		uint8_t size;          // 測ったときの文字のサイズ
+		TextMetrics metrics;   // 測った結果
+	} metricsCache[METRICS_CACHE_SIZE] = {};
+	/// @brief 次にキャッシュを上書きする位置
+	uint8_t metricsCacheNext = 0;
+
 	bool isTransparentColor = false;
 	/// @brief 透過色の設定。isTransparentColor がtrueの時に有効
 	/// @details ここで指定された色は、ビットマップ描画のときに透明として扱われる。使用しない場合は、is
@@ -186,6 +203,12 @@ class ST7735 {
 	/// + CSn信号をＨに設定
 	/// @param data_ 送信するデータ
 	 void writeData(uint8_t data_);
+
+	/// @brief	データをまとめて送信する。
+	/// @details writeDataと異なり、CSn信号の上げ下げは全体で１回だけになる。setAddrWindowの後に画素データを送る場合に使用する。
+	/// @param data_ 送信するデータ
+	/// @param len 送信するバイト数
+	 void writeDataBlock(const uint8_t *data_, size_t len);
 #pragma endregion
 
 
@@ -201,6 +224,17 @@ class ST7735 {
 	 /// これらは、ST7735_TFT.hで定義されている。変更の際はヘッダファイルを変更する。Pythonや、Arduino IDEなどではMicroPythonやライブラリの変更が必要になる。
 	 /// @return 画面の高さ
 	 int getHeight() { return st7735Init.height; };
+
+	 /// @brief 24ビットカラーを16ビットカラー（565方式）に変換する。
+	 /// @details それぞれの成分の上位のビット（赤5、緑6、青5ビット）を切り出して並べる。
+	 /// @param r 赤成分（0～255）
+	 /// @param g 緑成分（0～255）
+	 /// @param b 青成分（0～255）
+	 /// @return 565方式（R:5ビット/G:6ビット/B:5ビット）の色
+	 static uint16_t Color565(uint8_t r, uint8_t g, uint8_t b)
+	 {
+		 return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+	 }
 #pragma endregion
 
 #pragma region 設定メソッド
@@ -273,6 +307,63 @@ class ST7735 {
 	 
 	 /// @brief 画面の表示を通常に戻す
 	 void NormalDisplay();
+
+	private:
+	/// @brief 液晶に送る順（上位、下位）に並んだRGB565の画素の矩形を描画する。drawLabel、drawImageで使う。
+	/// @details 画面からはみ出す部分は切り取り、切り取りがなければ全体を、あれば１行ずつ、バッファにコピーせずにそのまま送る。
+	/// 透過色が有効なときは、透過色以外の画素のランごとに描画する。
+	/// @param x 表示位置のX座標
+	/// @param y 表示位置のY座標
+	/// @param data 画像全体の先頭
+	/// @param stride 画像全体の幅（1行あたりの画素数）
+	/// @param sx 描画する矩形の、画像の中での左上の座標
+	/// @param sy 描画する矩形の、画像の中での左上の座標
+	/// @param w 描画する矩形の幅
+	/// @param h 描画する矩形の高さ
+	void drawPanelPixels(int16_t x, int16_t y, const uint8_t *data, uint16_t stride, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h);
+
+	#ifdef TFT_ENABLE_BITMAP
+	/// @brief RGB565のビットマップの、１行の中で透過色でない点が連続している部分（ラン）を描画する。
+	/// @details ラン全体で１回だけアドレスウインドウを設定し、画面からはみ出した部分を切り取って連続送信する。
+	/// @param x ランの左端のX座標
+	/// @param y ランのY座標
+	/// @param p ランの先頭の画素
+	/// @param len ランの長さ
+	void bmpDrawRun(int16_t x, int16_t y, const uint16_t *p, uint16_t len);
+
+	/// @brief TFT_IMAGE_RLEの画像の矩形を、展開しながら描画する。drawImageで使う。
+	/// @details 画像全体を描画し、はみ出しも透過色もなければ、１つのアドレスウインドウに、そのままのパケットはそのまま、
+	/// 繰り返しのパケットは色を並べて１回で送る。それ以外の場合は１行ずつ展開し、見えている部分（透過色が有効なら、透過色以外のラン）を送る。
+	/// どちらの場合も、画像全体を展開するバッファは使わない。
+	/// @param x 表示位置のX座標
+	/// @param y 表示位置のY座標
+	/// @param image 画像
+	/// @param sx 描画する矩形の、画像の中での左上の座標
+	/// @param sy 描画する矩形の、画像の中での左上の座標
+	/// @param w 描画する矩形の幅
+	/// @param h 描画する矩形の高さ
+	void drawRLE(int16_t x, int16_t y, const TFTImage *image, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h);
+
+	/// @brief パレット形式（TFT_IMAGE_INDEXED1～8）の画像の矩形を、１行ずつ色に変換しながら描画する。drawImageで使う。
+	/// @details 描画の最初に、パレットを液晶に送る順のバイト列の表にしておき、画素ごとの変換は表を引くだけにする。
+	/// @param x 表示位置のX座標
+	/// @param y 表示位置のY座標
+	/// @param image 画像
+	/// @param sx 描画する矩形の、画像の中での左上の座標
+	/// @param sy 描画する矩形の、画像の中での左上の座標
+	/// @param w 描画する矩形の幅
+	/// @param h 描画する矩形の高さ
+	/// @param palette 使うパレット。2^ビット数の色を並べる
+	void drawIndexed(int16_t x, int16_t y, const TFTImage *image, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, const uint16_t *palette);
+	#endif
+
+	/// @brief 液晶に送る順に並んだ１行分の画素のうち、透過色以外の画素のランを、ランごとに描画する。
+	/// @param x 行の左端のX座標
+	/// @param y 行のY座標
+	/// @param row 画素
+	/// @param n 画素数
+	void drawOpaqueRuns(int16_t x, int16_t y, const uint8_t *row, int16_t n);
+	public:
 #pragma endregion
 
 
@@ -579,8 +670,89 @@ class ST7735 {
 
 #pragma region テキスト表示メソッド
 	#if defined TFT_ENABLE_TEXT
+	private:
+	/// @brief drawMonoRowsに、元のビットマップの１行を渡す関数。行は上から順に、１行ずつ呼び出される
+	/// @param context drawMonoRowsで指定した値
+	/// @param bit 行の左端の点の、返すポインタからのビット位置（MSBから順）を格納する
+	/// @return 行のビットを含むバイト列
+	typedef const uint8_t *(*MonoRowFunc)(void *context, uint32_t *bit);
+
+	/// @brief 1bppのビットマップを、元の行ごとに展開して描画する。drawMonoBitmap、drawMonoBitmapRuns、漢字の１文字の描画で使う。
+	/// @details 背景を描くときは、見えている範囲で１回だけアドレスウインドウを設定し、元の１行を横に拡大したものをsize回送る。
+	/// 透過するときは、元の１行の前景のランごとに、size行分の矩形を１つのアドレスウインドウで送る。
+	/// 横の拡大は元の点を順にたどって行い、画素ごとの割り算はしない。画面からはみ出す部分は切り取る。
+	/// @param x 表示位置のX座標
+	/// @param y 表示位置のY座標
+	/// @param w ビットマップの幅
+	/// @param h ビットマップの高さ
+	/// @param nextRow 元の行を返す関数。見えない行も含めて、上からh回呼び出す
+	/// @param context nextRowに渡す値
+	/// @param color 前景色
+	/// @param bg 背景色。transparentがtrueなら使わない
+	/// @param size 拡大率
+	/// @param transparent 背景を描かないならtrue
+	void drawMonoRows(int16_t x, int16_t y, uint16_t w, uint16_t h, MonoRowFunc nextRow, void *context, uint16_t color, uint16_t bg, uint8_t size, bool transparent);
+
+	/// @brief 1bppのビットマップを前景色と背景色に展開し、１つのアドレスウインドウへまとめて送信する。
+	/// @details 点(xx,yy)のビットは、bitmapの先頭から bitOffset + yy * rowBits + xx ビット目（MSBから順）にあるものとする。
+	/// sizeが２以上の場合、元の１行を横に一度だけ拡大し、それをsize回繰り返し送ることで、拡大した画像全体を１つのアドレスウインドウで描画する。
+	/// 画面からはみ出す部分は切り取られる。
+	/// @param x 表示位置のX座標
+	/// @param y 表示位置のY座標
+	/// @param w ビットマップの幅
+	/// @param h ビットマップの高さ
+	/// @param bitmap ビットマップデータ
+	/// @param bitOffset 左上の点のビット位置
+	/// @param rowBits 1行あたりのビット数
+	/// @param color 前景色
+	/// @param bg 背景色
+	/// @param size 拡大率。1で等倍。
+	void drawMonoBitmap(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint8_t *bitmap, uint32_t bitOffset, uint16_t rowBits, uint16_t color, uint16_t bg, uint8_t size);
+
+	/// @brief 1bppのビットマップの前景部分だけを描画する（背景は透過）。
+	/// @details 各行で前景の点が横に連続している部分（ラン）を探し、ランごとに１回のアドレスウインドウ設定と連続送信で描画する。
+	/// ビット配置と拡大の考え方、はみ出した部分の切り取りはdrawMonoBitmapと同じ。拡大時は、ランはsize x size倍の矩形１つとして送る。
+	/// @param x 表示位置のX座標
+	/// @param y 表示位置のY座標
+	/// @param w ビットマップの幅
+	/// @param h ビットマップの高さ
+	/// @param bitmap ビットマップデータ
+	/// @param bitOffset 左上の点のビット位置
+	/// @param rowBits 1行あたりのビット数
+	/// @param color 前景色
+	/// @param size 拡大率。1で等倍。
+	void drawMonoBitmapRuns(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint8_t *bitmap, uint32_t bitOffset, uint16_t rowBits, uint16_t color, uint8_t size);
+
+	/// @brief 測定結果のキャッシュを検索する。
+	/// @param text 測定する文字列
+	/// @param font 使用するフォント
+	/// @param wrapWidth 折り返し幅
+	/// @param size 文字のサイズ
+	/// @param metrics 見つかった場合に結果を格納する
+	/// @param hash 文字列のハッシュ値を格納する。見つからなかった場合にstoreMetricsCacheに渡す。
+	/// @return 見つかった場合はtrue
+	bool findMetricsCache(const char *text, const void *font, uint16_t wrapWidth, uint8_t size, TextMetrics *metrics, uint32_t *hash);
+
+	/// @brief 測定結果をキャッシュに保存する。一番古いものから上書きされる。
+	void storeMetricsCache(const char *text, uint32_t hash, const void *font, uint16_t wrapWidth, uint8_t size, const TextMetrics *metrics);
+
+	/// @brief 測定結果に１行を追加する
+	static void addMetricsLine(TextMetrics *metrics, uint16_t start, uint16_t width);
+	public:
 
 	#if defined TFT_ENABLE_FONTS
+	private:
+	/// @brief 文字列のうち、１行に収まる部分の終わりを求める。drawTextとmeasureTextで同じ折り返しにするために共通で使う。
+	/// @details 行の左端（x=0）以外では、文字の画像の右端がwrapRightを超える文字の前で行を終える。
+	/// @param text 行の先頭
+	/// @param startX 行の先頭の文字を描画するx座標
+	/// @param wrapRight 折り返す位置のx座標
+	/// @param size 文字のサイズ
+	/// @param endX 行の終わりのx座標を格納する
+	/// @return 次の行の先頭。文字列の最後まで収まる場合は終端のNUL文字の位置。
+	const char *findTextLineEnd(const char *text, int16_t startX, int16_t wrapRight, uint8_t size, int16_t *endX);
+	public:
+
 	/// @brief 英文のフォント指定機能を有効にした場合に、フォントを指定するメソッド。
 	/// @details このメソッドは、TFT_ENABLE_FONTSが有効な場合にのみ使用できる。
 	/// @param f フォント構造体へのポインタ。通常、AdafruitのGFXライブラリで定義されているフォントを指定する。
@@ -651,9 +823,65 @@ class ST7735 {
 	/// @param size 大きさ。１のときは文字の１ドットは画面上の１ドット。２にすると文字の１ドットは２ｘ２の矩形になる。
 	void drawText(Axis16 axis, const char *_text, uint16_t color, uint16_t bg, uint8_t size) { drawText(axis.x, axis.y, _text, color, bg, size); }
 
+	/// @brief tools/labelであらかじめ描画した文字列（ラベル）を表示する。
+	/// @details 文字の検索や展開をせず、ラベル全体を１つのアドレスウインドウで送信する。画面からはみ出す部分は切り取られる。<br/>
+	/// 透過色が有効なときは、TFT_LABEL_MONOでは背景が透過色なら前景のランだけを、TFT_LABEL_RGB565では透過色以外の画素のランだけを送る。
+	/// @param x 描画するx座標
+	/// @param y 描画するy座標。元の文字列を描画するときと同じ（GFXフォントではベースライン、漢字では上端）
+	/// @param label ラベル
+	/// @param color 文字の色。TFT_LABEL_MONOのときだけ使う
+	/// @param bg 背景色。TFT_LABEL_MONOのときだけ使う
+	void drawLabel(int16_t x, int16_t y, const TFTLabel *label, uint16_t color, uint16_t bg);
+
+	#if defined TFT_ENABLE_FONTS
+	/// @brief １文字を、送り幅(xAdvance) x 行の高さ(yAdvance)の枠全体を背景色で塗りつぶしながら表示する。
+	/// @details 枠全体を１つのアドレスウインドウで送信するので、同じ位置の文字を書き換える場合に前の文字を消す必要がない。
+	/// 背景は常に不透明として扱う。
+	/// @param x 描画するx座標（ベースラインの始点）
+	/// @param y 描画するy座標（ベースライン）
+	/// @param c 描画する文字
+	/// @param color 文字の色
+	/// @param bg 背景色
+	void drawCharCell(uint16_t x, uint16_t y, uint8_t c, uint16_t color, uint16_t bg);
+
+	/// @brief 文字列を１行分、１つのアドレスウインドウにまとめて表示する。
+	/// @details 文字列全体の送り幅 x 行の高さ(yAdvance)の矩形を背景色で塗りつぶしながら表示する。背景は常に不透明として扱う。
+	/// 折り返しは行わず、画面の右端を超えた部分は表示されない。斜体などで文字の画像が送り幅からはみ出す部分は切り取られる。
+	/// @param x 描画するx座標（ベースラインの始点）
+	/// @param y 描画するy座標（ベースライン）
+	/// @param _text 描画する文字列
+	/// @param color 文字の色
+	/// @param bg 背景色
+	void drawTextLine(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg);
+
+	/// @brief 文字列を描画したときの大きさと改行位置を、描画せずに求める。
+	/// @details 左端から幅wrapWidthの枠の中に、drawTextと同じ規則で折り返して描画した場合の結果を返す。
+	/// 右寄せや中央寄せの位置の計算や、書き換えが必要な範囲の計算に使用する。
+	/// 直近の結果はキャッシュされるので、同じ文字列を同じ条件で繰り返し測っても文字の検索は行われない。
+	/// @param _text 測定する文字列
+	/// @param wrapWidth 折り返す幅。0のときは折り返さない。
+	/// @param size 文字のサイズ
+	/// @param metrics 結果を格納する構造体
+	void measureText(const char *_text, uint16_t wrapWidth, uint8_t size, TextMetrics *metrics);
+	#endif
+
 	#pragma region 漢字表示メソッド
 	#ifdef TFT_ENABLE_KANJI				// 漢字表示が可能な場合
 
+	/// @brief 漢字の表示に使うフォントを、registeredKanjiFonts（KanjiHelper.h）に登録された名前で指定する
+	/// @details 既定のフォントはTFT_KANJI_DOT/TFT_KANJI_LEVELで選んだもの。TFT_KANJI_EXTRA_FONTnで指定したフォントに切り替えられる。
+	/// @param name テーブル名（Kanji16Allなど）
+	/// @return フォントが見つかればtrue。見つからなければ、フォントは変わらない
+	bool setKanjiFont(const char *name);
+	/// @brief 漢字の表示に使うフォントを、テーブルで指定する
+	/// @param table Font_Kanji*.incで定義されたテーブル。NULLのときは既定のフォントに戻る
+	void setKanjiFont(const KanjiFontTable *table);
+	/// @brief 登録済みの漢字フォントの名前を、カンマで区切って取得する。使い方はgetFontsと同じ
+	/// @param buf フォント名を格納するバッファ
+	/// @param size バッファの大きさ
+	/// @return バッファに収まればtrue
+	bool getKanjiFonts(char *buf, uint16_t size);
+
 
 	/// @brief 指定された座標に、指定された漢字パターン（ビットマップ）を１文字表示する。
 	/// @param x 表示位置のX座標 
@@ -663,7 +891,8 @@ class ST7735 {
 	/// @param bmpData ビットマップデータ
 	/// @param color 文字の色
 	/// @param bg	背景色
-	void drawKanjiBlock(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *bmpData, uint16_t color , uint16_t bg);
+	/// @param size 文字のサイズ。1がデフォルト。2で2倍の大きさになる。
+	void drawKanjiBlock(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *bmpData, uint16_t color , uint16_t bg, uint8_t size = 1);
 	
 	/// @brief 漢字１文字を表示する
 	/// @param x 表示するX座標
@@ -671,9 +900,22 @@ class ST7735 {
 	/// @param utf8codes 表示するUTF8、もしくはASCIIコード
 	/// @param color 表示色
 	/// @param bg 背景色	 
-	void drawKanji(uint16_t &x, uint16_t& y, uint32_t code, uint16_t color, uint16_t bg);
+	/// @param size 文字のサイズ。1がデフォルト。2で2倍の大きさになる。
+	void drawKanji(uint16_t &x, uint16_t& y, uint32_t code, uint16_t color, uint16_t bg, uint8_t size = 1);
+
+	/// @brief 漢字１文字を、文字の枠全体を背景色で塗りつぶしながら表示する。drawCharCellの漢字版
+	/// @details 折り返しはしない。フォントにない文字のときは、枠を背景色で塗りつぶす（背景が透過色のときは何もしない）。
+	/// @param x 表示するX座標
+	/// @param y 表示するY座標
+	/// @param code 表示するUTF8、もしくはASCIIコード
+	/// @param color 表示色
+	/// @param bg 背景色
+	/// @param size 文字のサイズ。1がデフォルト。2で2倍の大きさになる。
+	/// @return 文字の送り幅
+	uint16_t drawKanjiCell(uint16_t x, uint16_t y, uint32_t code, uint16_t color, uint16_t bg, uint8_t size = 1);
 
 	/// @brief 漢字文字列を表示する
+	/// @details 折り返しが有効な場合は、禁則処理を行って改行する。
 	/// @param x 		描画するx座標
 	/// @param y	描画するy座標
 	/// @param _text	描画する文字
@@ -681,6 +923,67 @@ class ST7735 {
 	/// @param bg 		背景色
 	/// @param size 		文字のサイズ。1がデフォルト。2で2倍の大きさになる。
 	void drawTextKanji(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg, uint8_t size);
+
+	/// @brief TFT_KANJI_TEXT（KanjiText.h）でコンパイル時に変換した文字列を表示する
+	/// @details 文字の検索をしないので、同じ文字列を何度も表示するときに速い。折り返しはしない。
+	/// 変換したときのテーブルで描画するので、setKanjiFontやフォントブロブの指定には影響されない。
+	/// @param x 		描画するx座標
+	/// @param y	描画するy座標
+	/// @param text	TFT_KANJI_TEXTで作った文字列
+	/// @param color	文字の色
+	/// @param bg 		背景色
+	/// @param size 		文字のサイズ。1がデフォルト。2で2倍の大きさになる。
+	template<size_t N>
+	void drawTextKanji(uint16_t x, uint16_t y, const KanjiText<N> &text, uint16_t color, uint16_t bg, uint8_t size = 1)
+	{
+		drawKanjiGlyphs(x, y, text.table, text.glyphs, text.count, color, bg, size);
+	}
+
+	/// @brief 漢字文字列を、禁則処理を行いながら行に分割する。
+	/// @details 求めた行情報はdrawTextKanjiLinesで何度でも使えるので、長い文章をページ送りやスクロールで表示するときに、
+	/// 毎回全体をレイアウトし直す必要がない。linesが一杯になったときは、最後の行のnextの位置から続きを求められる。
+	/// @param _text 文字列
+	/// @param wrapWidth 折り返す幅。0のときは'\n'以外では改行しない。
+	/// @param size 文字のサイズ
+	/// @param lines 行情報を格納する配列
+	/// @param maxLines linesの要素数
+	/// @return 格納した行数
+	uint16_t layoutTextKanji(const char *_text, uint16_t wrapWidth, uint8_t size, KanjiLine *lines, uint16_t maxLines);
+
+	/// @brief layoutTextKanjiで求めた行のうち、指定された行だけを描画する。
+	/// @param x 描画するx座標
+	/// @param y 最初の行を描画するy座標
+	/// @param _text layoutTextKanjiに渡した文字列
+	/// @param lines 行情報
+	/// @param firstLine 描画する最初の行
+	/// @param lineCount 描画する行数
+	/// @param color 文字の色
+	/// @param bg 背景色
+	/// @param size 文字のサイズ。layoutTextKanjiと同じ値を指定する。
+	void drawTextKanjiLines(uint16_t x, uint16_t y, const char *_text, const KanjiLine *lines, uint16_t firstLine, uint16_t lineCount, uint16_t color, uint16_t bg, uint8_t size = 1);
+
+	/// @brief 漢字文字列を描画したときの大きさと改行位置を、描画せずに求める。
+	/// @details 左端から幅wrapWidthの枠の中に、drawTextKanjiと同じ規則で折り返して描画した場合の結果を返す。
+	/// 結果はmeasureTextと同じようにキャッシュされる。
+	/// @param _text 測定する文字列
+	/// @param wrapWidth 折り返す幅。0のときは折り返さない。
+	/// @param size 文字のサイズ
+	/// @param metrics 結果を格納する構造体
+	void measureTextKanji(const char *_text, uint16_t wrapWidth, uint8_t size, TextMetrics *metrics);
+
+	private:
+	/// @brief 漢字フォントから取り出した１文字を描画する。
+	/// @details KanjiRowReaderで上の行から１行ずつ取り出して送るので、圧縮された文字も展開用のバッファなしで描画できる。
+	/// 背景を描く場合は１文字で１回だけアドレスウインドウを設定し、透過色のときは前景のランごとに描画する。
+	/// 行の展開と送信はdrawMonoBitmapと同じdrawMonoRowsで行う。
+	void drawKanjiGlyph(uint16_t x, uint16_t y, const KanjiGlyph *glyph, uint16_t color, uint16_t bg, uint8_t size);
+
+	/// @brief 折り返しをせずに、指定されたバイト数の漢字文字列を描画する
+	void drawKanjiRun(uint16_t x, uint16_t y, const char *_text, uint16_t length, uint16_t color, uint16_t bg, uint8_t size);
+
+	/// @brief 折り返しをせずに、テーブル内の番号で指定された文字を並べて描画する
+	void drawKanjiGlyphs(uint16_t x, uint16_t y, const KanjiFontTable *table, const uint16_t *glyphs, uint16_t count, uint16_t color, uint16_t bg, uint8_t size);
+	public:
 	#endif
 	#pragma endregion	
 
@@ -720,7 +1023,10 @@ class ST7735 {
 	}
 	/// @brief 画面にビットマップを表示する。ビットマップは、５６５形式の16bit値の配列へのポインタ。
 	/// @details 具体的には次のようなデータになる。<br/>
-	/// const uint16_t bmp1[] = {0x0821, 0x0821, 0x0821, 0x0821, 0x0000, 0xF223, 0xF223, … };
+	/// const uint16_t bmp1[] = {0x0821, 0x0821, 0x0821, 0x0821, 0x0000, 0xF223, 0xF223, … };<br/>
+	/// 透過色を使うときは、各行で透過色でない点が連続している部分（ラン）を探し、ランごとに１回のアドレスウインドウ設定と連続送信で描画する。
+	/// 同じビットマップを何度も表示するなら、bmpBuildRunsでランをあらかじめ求めておき、bmpDrawRunsで表示すると、色の比較もしなくて済む。
+	/// 画面からはみ出した部分は切り取る。画像の一部分だけを表示するときはbmpDrawRectを使う。
 	/// @param x 表示する左上の座標
 	/// @param y 表示する左上の座標
 	/// @param w ビットマップの大きさ
@@ -728,6 +1034,84 @@ class ST7735 {
 	/// @param p 表示するデータへのポインタ
 	/// @param direction 表示する方向。0…標準 1…ミラー表示		
 	void bmpDraw(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t *p , uint8_t direction);
+
+	/// @brief 大きな画像（アトラス）の一部分を表示する。
+	/// @details 複数のアイコンやアニメーションのコマを１枚の画像にまとめておき、その中の矩形 (sx, sy, w, h) を (x, y) に表示する。
+	/// 画面からはみ出した部分は切り取り、見えている行だけを送る。透過色を使わないときは、見えている範囲で１回だけアドレスウインドウを設定する。
+	/// 透過色を使うときは、bmpDrawと同じくランごとに描画する。
+	/// @param x 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param y 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param p 画像全体の先頭へのポインタ
+	/// @param stride 画像全体の幅（1行あたりの画素数）
+	/// @param sx 表示する矩形の、画像の中での左上の座標
+	/// @param sy 表示する矩形の、画像の中での左上の座標
+	/// @param w 表示する矩形の幅
+	/// @param h 表示する矩形の高さ
+	void bmpDrawRect(int16_t x, int16_t y, const uint16_t *p, uint16_t stride, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h);
+
+	/// @brief tools/imgconvで変換した画像（TFTImage）を表示する。
+	/// @details TFT_IMAGE_RGB565の画素は液晶に送る順に並んでいるので、bmpDrawのように１画素ずつバイトを入れ替えることなく、
+	/// 画像全体（画面からはみ出す場合は見えている行ごと）をそのまま送る。透過色が有効なときは、透過色以外の画素のランごとに描画する。<br/>
+	/// TFT_IMAGE_RLEの画像は、画像全体を展開するバッファを使わずに、展開しながら送る。
+	/// パレット形式の画像は、１行ずつパレットで色に変換しながら送る。<br/>
+	/// プログラムで作ったRAM上の画像（uint16_tの配列）はbmpDraw、bmpDrawRectで表示する。
+	/// @param x 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param y 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param image 画像
+	/// @param palette パレット形式の画像で、画像のパレットの代わりに使うパレット（テーマの色に変えるときなど）。NULLなら画像のパレットを使う。
+	/// 画像で使っていない番号の分も含めて、2^ビット数（2/4/16/256）の色を並べる（描画の前に全部を読むため）
+	void drawImage(int16_t x, int16_t y, const TFTImage *image, const uint16_t *palette = NULL) { drawImageRect(x, y, image, 0, 0, image->width, image->height, palette); }
+
+	/// @brief tools/imgconvで変換した画像（TFTImage）の一部分を表示する。アイコンなどをまとめた画像（アトラス）に使う。
+	/// @param x 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param y 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param image 画像
+	/// @param sx 表示する矩形の、画像の中での左上の座標
+	/// @param sy 表示する矩形の、画像の中での左上の座標
+	/// @param w 表示する矩形の幅
+	/// @param h 表示する矩形の高さ
+	/// @param palette パレット形式の画像で、画像のパレットの代わりに使うパレット。NULLなら画像のパレットを使う。
+	/// drawImageと同じく、2^ビット数（2/4/16/256）の色を並べる
+	void drawImageRect(int16_t x, int16_t y, const TFTImage *image, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, const uint16_t *palette = NULL);
+
+	/// @brief 24ビット、32ビットカラーやグレースケールの画像を、RGB565に変換しながら表示する。
+	/// @details カメラやセンサー（サーモグラフィのヒートマップなど）が作った画像を、RGB565の配列に変換せずにそのまま表示する。
+	/// １行ずつColorConvertで液晶に送る順のRGB565に変換して送るので、画像全体のRGB565のバッファは要らない。
+	/// TFT_COLOR_DITHERを指定すると、4x4の組織的ディザをかけて、グラデーションの縞を目立たなくする。ディザの模様は画面の座標で決まるので、
+	/// 画像を何回かに分けて（１行ずつなど）表示しても、つなぎ目はできない。<br/>
+	/// 画面からはみ出した部分は切り取る。透過色が有効なときは、変換した色が透過色の画素は描画しない。
+	/// @param x 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param y 表示する左上の座標。画面の外（負の値）でもよい
+	/// @param w 画像の幅
+	/// @param h 画像の高さ
+	/// @param p 画像の画素。行の間に隙間はないこと
+	/// @param format 画素の形式（TFT_PIXEL_RGB888、TFT_PIXEL_BGR888、TFT_PIXEL_ARGB8888、TFT_PIXEL_GRAY8）
+	/// @param options TFT_COLOR_DITHERならディザをかける
+	void drawRGB(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint8_t *p, uint8_t format, uint8_t options = 0);
+
+	/// @brief ビットマップの透過色でない部分（ラン）の表を作る。bmpDrawRunsで使う。
+	/// @details 表は uint16_t の配列で、行ごとに「ランの数 n、(開始位置, 長さ) x n」を並べたもの。
+	/// 大きさはビットマップの形で決まるので、runsにNULLを指定して必要な要素数を求めてから、配列を用意して呼び出す。
+	/// 表はビットマップと一緒に、フラッシュに置いておくこともできる。
+	/// @param p ビットマップ
+	/// @param w ビットマップの幅
+	/// @param h ビットマップの高さ
+	/// @param transColor 透過色
+	/// @param runs 表を書き込む配列。NULLなら要素数を求めるだけ
+	/// @param capacity runsの要素数
+	/// @return 表に必要な要素数。capacityより大きければ、runsには書き込まない
+	static size_t bmpBuildRuns(const uint16_t *p, uint16_t w, uint16_t h, uint16_t transColor, uint16_t *runs, size_t capacity);
+
+	/// @brief bmpBuildRunsで作った表を使って、ビットマップの透過色でない部分だけを描画する。
+	/// @details 色の比較をしないので、bmpUseTransColorの設定には関係なく、表を作ったときの透過色が透過する。
+	/// @param x 表示する左上の座標
+	/// @param y 表示する左上の座標
+	/// @param w ビットマップの幅
+	/// @param h ビットマップの高さ
+	/// @param p 表示するデータへのポインタ
+	/// @param runs bmpBuildRunsで作った表
+	/// @param direction 表示する方向。0…標準 1…ミラー表示
+	void bmpDrawRuns(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *p, const uint16_t *runs, uint8_t direction);
 	#endif
 #pragma endregion
 
@@ -742,30 +1126,4 @@ class ST7735 {
 //void setRotation(uint8_t m);
 #endif
 
-
-
-
-// ------ not functional yet ----------------------------------------------
-// needs fat-library
-
-// BMP processing from SD-card
-#if defined TFT_ENABLE_BMP
-	 
-	 /// @brief 24ビットカラーを16ビットカラーに変換する。もとになったAdafruitのコードにあったので残してあるが使用していない。
-	 /// @details それぞれの変数の「上位」を切り出しており、用途としては特殊なものと思われる。
-	 /// @param r 赤成分
-	 /// @param g 緑成分
-	 /// @param b 青成分
-	 /// @return 565方式（R:5bit/G:6ビット/ビットカラー
-	 int16_t Color565(int16_t r, int16_t g, int16_t b)
-	 {
-		 return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
-	 }
-	 /// @brief 画面に点を表示する。もとになったAdafruitのコードにあったので残してあるが使用していない。
-	 /// @param color	色 
-	 void pushColor(uint16_t color);
-
-	bool bmpDraw(int8_t x, int8_t y, int8_t *bmpname);
-#endif
-
 #endif
@@ -1,6 +1,14 @@
 #ifndef ST7735_STRUCT_H
 #define ST7735_STRUCT_H
 
+/// @brief フォントなどの大きな定数データを、専用のセクション(.flashdata.<group>)に置くための指定。
+/// @details RP2040のリンカスクリプトは .flashdata* をフラッシュに配置するので、データがRAMにコピーされることはない。
+/// セクション名でまとめておくことで、mapファイルやsizeコマンドでフォントの大きさを確認しやすくなる。
+#if defined(__ELF__)
+	#define TFT_FLASH_DATA(group) __attribute__((section(".flashdata." group)))
+#else
+	#define TFT_FLASH_DATA(group)
+#endif
 
 
 /// @brief 画面の回転方向を示す定義
@@ -152,6 +160,97 @@ class Region8 {
 	}
 };
 
+/// @brief TextMetricsに記録する行の数の上限。これを超える行は、行数と全体の大きさにだけ反映される。
+#define TFT_TEXT_MAX_LINES 8
+
+/// @brief 文字列を描画したときの大きさと改行位置を格納する構造体。measureText、measureTextKanjiで使用する。
+/// @details 描画位置を(x,y)とすると、文字列が描画される範囲は (x, y + top) から幅width、高さheightの矩形になる。
+typedef struct {
+	uint16_t width;                           ///< 一番長い行の幅（文字の送り幅の合計）
+	uint16_t height;                          ///< 全体の高さ（行の高さ x 行数）
+	int16_t top;                              ///< 描画するy座標から、文字の上端までの距離。GFXフォントではベースラインからの距離なので負の値になる
+	uint8_t lineCount;                        ///< 行数
+	uint16_t lineStart[TFT_TEXT_MAX_LINES];   ///< 各行の先頭の、文字列中のバイト位置
+	uint16_t lineWidth[TFT_TEXT_MAX_LINES];   ///< 各行の幅
+} TextMetrics;
+
+/// @brief ラベルの画素の形式
+#define TFT_LABEL_MONO 0		///< 1ドット1ビット。行はビット単位で詰められていて、描画時に前景色と背景色を指定する
+#define TFT_LABEL_RGB565 1		///< 1ドット2バイト（上位、下位の順）。色は作成時に決まっている
+
+/// @brief 変わらない文字列（タイトル、単位、ボタンの名前など）を、tools/labelであらかじめ描画した画像。drawLabelで表示する。
+/// @details TextMetricsと同じく、描画位置を(x,y)とすると、(x, y + top) から幅width、高さheightの矩形に描画される。
+typedef struct {
+	uint16_t width;			///< 幅
+	uint16_t height;		///< 高さ
+	int16_t top;			///< 描画するy座標から、画像の上端までの距離。GFXフォントではベースラインからの距離なので負の値になる
+	uint8_t format;			///< TFT_LABEL_MONO / TFT_LABEL_RGB565
+	const uint8_t *data;	///< 画素データ
+} TFTLabel;
+
+/// @brief 画像の画素の形式
+#define TFT_IMAGE_RGB565 0		///< 1ドット2バイト（上位、下位の順）。液晶に送る順に並んでいるので、そのまま送れる
+/// @brief ランレングス圧縮したRGB565。同じ色が続く部分を１つにまとめ、背景の多い画像を小さくする。
+/// @details 画像全体の画素を、行をまたいで左上から順に、次の「パケット」の並びにしたもの。<br/>
+/// 先頭の１バイト n の最上位ビットが1なら繰り返し：続く２バイト（上位、下位）の色が (n & 0x7F) + 1 個続く。<br/>
+/// 最上位ビットが0ならそのまま：続く ((n & 0x7F) + 1) x 2 バイトが、液晶に送る順に並んだ画素。
+#define TFT_IMAGE_RLE 1
+/// @brief パレット形式。画素はパレットの番号で、1/2/4/8ビットで詰められている（MSBから順、各行はバイト単位に揃える）。
+/// @details 描画時にpaletteで色に変換する。drawImageでパレットを差し替えれば、同じ画像を別の色で表示できる。
+#define TFT_IMAGE_INDEXED1 2	///< 1ビット（2色）
+#define TFT_IMAGE_INDEXED2 3	///< 2ビット（4色）
+#define TFT_IMAGE_INDEXED4 4	///< 4ビット（16色）
+#define TFT_IMAGE_INDEXED8 5	///< 8ビット（256色）
+
+/// @brief tools/imgconvで変換した画像。drawImageで表示する。
+/// @details bmpDrawで使うuint16_tの配列は、CPUのバイト順（リトルエンディアン）なので、送るときに１画素ずつ上位と下位を入れ替える必要がある。
+/// TFTImageの画素は液晶に送る順に並んでいるので、行ごと（切り取りがなければ画像全体）をそのまま送れる。
+typedef struct {
+	uint16_t width;			///< 幅
+	uint16_t height;		///< 高さ
+	uint8_t format;			///< TFT_IMAGE_RGB565 / TFT_IMAGE_RLE / TFT_IMAGE_INDEXED1～8
+	const uint8_t *data;	///< 画素データ
+	const uint16_t *palette;	///< パレット（RGB565）。パレット形式のときだけ使う。2^ビット数の色（imgconvは使わない番号を0で埋める）
+} TFTImage;
+
+/// @brief TFT_IMAGE_RLEのパケットを、先頭から１画素ずつ読み出す
+/// @details drawRLEが画像を展開するのに使う。液晶にはアクセスしないので、tools/imgconvの--verifyも同じ読み出し方で確かめる。
+struct TFTRleReader {
+	const uint8_t *p;	///< 次に読む位置
+	bool repeat;		///< 今のパケットが繰り返しならtrue
+	uint16_t left;		///< 今のパケットの残りの画素数
+
+	/// @brief 次の画素を、液晶に送る順で dst に書く。dstがNULLなら読み飛ばす
+	void next(uint8_t *dst)
+	{
+		if (left == 0) {
+			repeat = (*p & 0x80) != 0;
+			left = (*p & 0x7F) + 1;
+			p++;
+		}
+		if (dst) {
+			dst[0] = p[0];
+			dst[1] = p[1];
+		}
+		left--;
+		if (!repeat || left == 0) p += 2;
+	}
+};
+
+/// @brief tools/imgconv --animで変換したアニメーション。AnimationPlayerで再生する。
+/// @details dataはフレームの並び。最初のフレーム（キーフレーム）は画像全体を、以後のフレームは前のフレームから変わった矩形だけを持つ。<br/>
+/// フレームは、表示する時間（ミリ秒）と矩形の数（各2バイト）の後に、矩形を並べたもの。<br/>
+/// 矩形は、x、y、幅、高さ（各2バイト）、画素の形式（TFT_IMAGE_RGB565 / TFT_IMAGE_RLE / TFT_IMAGE_INDEXED1～8、1バイト）、
+/// 画素データのバイト数（4バイト）と、TFTImageと同じ形式の画素データ。数値はすべてリトルエンディアン。
+typedef struct {
+	uint16_t width;			///< 幅
+	uint16_t height;		///< 高さ
+	uint16_t frameCount;	///< フレーム数（キーフレームを含む）
+	uint32_t loopOffset;	///< 最後のフレームから最初のフレームに戻る差分フレームの、dataの中での位置。なければ0
+	const uint8_t *data;	///< フレームの並び
+	const uint16_t *palette;	///< パレット形式の矩形で使うパレット（RGB565）。なければNULL
+} TFTAnimation;
+
 /// TFT_ENABLE_FONTSが有効な場合に使用される、ビットマップ情報を含むフォント構造体を格納するための構造
 /// Font data stored PER GLYPH
 
@@ -180,8 +279,21 @@ typedef struct {
 } GFXfont;
 
 
-static struct {
+/// @brief setFont(名前)で指定できるフォントの最大数
+#define TFT_MAX_FONTS 16
+
+/// @brief 名前で指定できるように登録したフォント
+typedef struct {
 	const char *name;
 	const GFXfont* font;
-} registeredFonts[16];
+} RegisteredFont;
+
+/// @brief 登録済みのフォントの一覧。実体はST7735_fonts.cppに１つだけ置かれる。
+extern RegisteredFont registeredFonts[TFT_MAX_FONTS];
+
+/// @brief ライブラリに組み込まれているGFXフォント。実体はST7735_fonts.cppに１つだけ置かれる。
+extern const GFXfont FreeMono9pt7b;
+extern const GFXfont FreeMono18pt7b;
+extern const GFXfont FreeMonoOblique12pt7b;
+extern const GFXfont FreeMonoOblique12pt_sub;
 #endif
@@ -13,7 +13,10 @@
 #ifndef TEXTFONTS_H
 #define TEXTFONTS_H
 /// @brief TFT_ENABLE_FONTSが定義されていない場合（デフォルトの5x7の文字）が使用される場合の文字データ
-const char Font[] = {
+/// @details 実体はTFT_TEXT_FONT_IMPLを定義した翻訳単位（ST7735_fonts.cpp）にだけ置かれる。
+extern const char Font[];
+#ifdef TFT_TEXT_FONT_IMPL
+const char Font[] TFT_FLASH_DATA("textfont") = {
 0x00, 0x00, 0x00, 0x00, 0x00,
 0x00, 0x00, 0x5F, 0x00, 0x00,
 0x00, 0x07, 0x00, 0x07, 0x00,
@@ -113,6 +116,7 @@ const char Font[] = {
 0x00, 0x41, 0x36, 0x08, 0x00,
 0x02, 0x01, 0x02, 0x04, 0x02
 };
+#endif
 
 
 
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include "ST7735_TFT.h"
+
+/**
+ * @file TextLabel.h
+ * @brief 書き換えのあった文字の枠だけを描き直す、文字列表示の部品。
+ * @details 数値や状態の表示を１秒に何回も書き換える場合、枠を消してdrawText/drawTextKanjiで描き直すと、
+ * 変わっていない文字もすべて送ることになる。TextLabelは前回表示した文字とその位置を覚えておき、
+ * 文字か位置が変わった枠だけを、背景ごと描き直す。前回より短くなった場合は、残った部分を背景色で消す。
+ * "12345" → "12346" なら、送るのは最後の１文字の枠だけになる。<br/>
+ * 使い方:
+ *
+ *     TextLabel counter(&tft, 10, 20, true, ST7735_WHITE, ST7735_BLACK);	// 漢字フォントで表示
+ *     counter.update("12345");
+ *     counter.update("12346");		// "6"の枠だけを送る
+ */
+
+/// @brief TextLabelが覚えておく文字数。これを超える文字は表示されない
+#ifndef TFT_TEXT_LABEL_MAX_GLYPHS
+#define TFT_TEXT_LABEL_MAX_GLYPHS 24
+#endif
+
+/// @brief 書き換えのあった文字の枠だけを描き直す、文字列表示の部品
+class TextLabel {
+	public:
+	 TextLabel(ST7735 *tft, int16_t x, int16_t y, bool kanji, uint16_t color, uint16_t bg, uint8_t size = 1);
+
+	 void update(const char *text);
+	 void setColor(uint16_t color, uint16_t bg);
+	 void invalidate();
+	 /// @brief 前回表示した文字列の幅
+	 uint16_t width() const { return totalWidth; }
+
+	private:
+	 ST7735 *tft;
+	 int16_t x;
+	 int16_t y;
+	 bool kanji;				///< trueなら漢字フォント(drawKanjiCell)、falseならGFXフォント(drawCharCell)で表示する
+	 uint16_t color;
+	 uint16_t bg;
+	 uint8_t size;
+	 const void *font;		///< 前回表示したときのフォント。変わっていればすべて描き直す
+	 bool valid;				///< falseなら、次のupdateですべて描き直す
+	 uint8_t count;			///< 前回表示した文字数
+	 uint16_t totalWidth;	///< 前回表示した文字列の幅
+	 struct {
+		 uint32_t code;		///< 文字コード
+		 uint16_t x;			///< 枠の左端の、xからの距離
+	 } cells[TFT_TEXT_LABEL_MAX_GLYPHS];
+
+	 const void *currentFont() const;
+	 uint8_t nextGlyph(const char *text, uint32_t *code, uint16_t *advance) const;
+	 void clear(uint16_t left, uint16_t right);
+};
@@ -3,7 +3,7 @@
 	#include "../ST7735_struct.h"
 #endif
 
-const uint8_t FreeMono9pt7bBitmaps[]  = {
+const uint8_t FreeMono9pt7bBitmaps[] TFT_FLASH_DATA("gfxfont") = {
 	0xAA, 0xA8, 0x0C, 0xED, 0x24, 0x92, 0x48, 0x24, 0x48, 0x91, 0x2F, 0xE4,
 	0x89, 0x7F, 0x28, 0x51, 0x22, 0x40, 0x08, 0x3E, 0x62, 0x40, 0x30, 0x0E,
 	0x01, 0x81, 0xC3, 0xBE, 0x08, 0x08, 0x71, 0x12, 0x23, 0x80, 0x23, 0xB8,
@@ -76,7 +76,7 @@ const uint8_t FreeMono9pt7bBitmaps[]  = {
 	0xBF, 0x29, 0x24, 0xA2, 0x49, 0x26, 0xFF, 0xF8, 0x89, 0x24, 0x8A, 0x49,
 	0x2C, 0x61, 0x24, 0x30};
 
-const GFXglyph FreeMono9pt7bGlyphs[]  = {
+const GFXglyph FreeMono9pt7bGlyphs[] TFT_FLASH_DATA("gfxfont") = {
 	{0, 0, 0, 11, 0, 1},       // 0x20 ' '
 	{0, 2, 11, 11, 4, -10},    // 0x21 '!'
 	{3, 6, 5, 11, 2, -10},     // 0x22 '"'
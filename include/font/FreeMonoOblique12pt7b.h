@@ -1,5 +1,5 @@
 #include "../ST7735_struct.h"
-const uint8_t FreeMonoOblique12pt7bBitmaps[]  = {
+const uint8_t FreeMonoOblique12pt7bBitmaps[] TFT_FLASH_DATA("gfxfont") = {
     0x11, 0x11, 0x12, 0x22, 0x22, 0x00, 0x0E, 0xE0, 0xE7, 0xE7, 0xC6, 0xC6,
     0xC6, 0x84, 0x84, 0x02, 0x40, 0x88, 0x12, 0x02, 0x40, 0x48, 0x7F, 0xC2,
     0x40, 0x48, 0x11, 0x1F, 0xF8, 0x48, 0x09, 0x02, 0x40, 0x48, 0x09, 0x02,
@@ -144,7 +144,7 @@ const uint8_t FreeMonoOblique12pt7bBitmaps[]  = {
     0x04, 0x08, 0x0C, 0x20, 0x81, 0x02, 0x04, 0x08, 0x21, 0x80, 0x38, 0x28,
     0x88, 0x0E, 0x00};
 
-const GFXglyph FreeMonoOblique12pt7bGlyphs[]  = {
+const GFXglyph FreeMonoOblique12pt7bGlyphs[] TFT_FLASH_DATA("gfxfont") = {
     {0, 0, 0, 14, 0, 1},        // 0x20 ' '
     {0, 4, 15, 14, 6, -14},     // 0x21 '!'
     {8, 8, 7, 14, 5, -14},      // 0x22 '"'
@@ -1,5 +1,5 @@
 #include "../ST7735_struct.h"
-const uint8_t FreeMonoOblique12pt_subBitmaps[]  = {
+const uint8_t FreeMonoOblique12pt_subBitmaps[] TFT_FLASH_DATA("gfxfont") = {
   0x00, 0x07, 0x06, 0x23, 0x04, 0x81, 0x40, 0x50, 0x14, 0x06, 0x02, 0x80,
   0xA0, 0x28, 0x0A, 0x04, 0x83, 0x11, 0x83, 0xC0, 0x03, 0x03, 0x83, 0x83,
   0x43, 0x20, 0x10, 0x08, 0x08, 0x04, 0x02, 0x01, 0x01, 0x00, 0x80, 0x43,
@@ -31,7 +31,7 @@ const uint8_t FreeMonoOblique12pt_subBitmaps[]  = {
   0x04, 0x00, 0x60, 0x02, 0x00, 0x7F, 0x00, 0x1F, 0xC0, 0x06, 0x00, 0x20,
   0x02, 0x1F, 0xE6, 0x04, 0xC0, 0x48, 0x04, 0x81, 0xC7, 0xEF };
 
-const GFXglyph FreeMonoOblique12pt_subGlyphs[]  = {
+const GFXglyph FreeMonoOblique12pt_subGlyphs[] TFT_FLASH_DATA("gfxfont") = {
   {     0,   1,   1,  14,    0,    0 },   // 0x20 ' '
   {     1,  10,  15,  14,    4,  -14 },   // 0x30 '0'
   {    20,   9,  15,  14,    3,  -14 },   // 0x31 '1'
@@ -140,6 +140,12 @@ class HW
     return ret;
   }
 
+  int spiWrite(const uint8_t* data, size_t len)
+  {
+    int ret = spi_write_blocking(portSPI, data, len);
+    return ret;
+  }
+
   volatile inline void CSLow()
   {
     asm volatile("nop \n nop \n nop");
@@ -187,6 +193,7 @@ class HW
 
   void writeCommand(uint8_t cmd_);
   void writeData(uint8_t data_);
+  void writeDataBlock(const uint8_t* data_, size_t len);
 };
 
 #define TFT_OPTIONS
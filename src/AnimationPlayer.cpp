@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <string.h>
+#include "../include/AnimationPlayer.h"
+#include "pico/stdlib.h"
+
+/**
+ * @file AnimationPlayer.cpp
+ * @brief アニメーションを、変わった部分だけ描き直して再生する、AnimationPlayerクラスを定義する。
+ */
+
+#if defined(TFT_ENABLE_BITMAP)
+#define ANIMATION_FRAME_HEADER 4	// 時間、矩形の数
+#define ANIMATION_RECT_HEADER 13	// x、y、幅、高さ、形式、バイト数
+
+static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+/// @brief アニメーションを再生する部品を作る。表示は最初のupdateで行う
+/// @param tft 表示先
+/// @param animation アニメーション
+/// @param x 表示する左上の座標
+/// @param y 表示する左上の座標
+AnimationPlayer::AnimationPlayer(ST7735 *tft, const TFTAnimation *animation, int16_t x, int16_t y)
+{
+	this->tft = tft;
+	this->animation = animation;
+	this->x = x;
+	this->y = y;
+	loop = false;
+	overrunCount = 0;
+	rewind();
+}
+
+/// @brief 最初のフレーム（キーフレーム）から再生し直す。次のupdateで、画像全体を描き直す
+void AnimationPlayer::rewind()
+{
+	next = 0;
+	offset = 0;
+	firstDelta = 0;
+	duration = 0;
+	started = false;
+}
+
+/// @brief dataのposにあるフレームの矩形を、すべて描画する
+/// @return 次のフレームの位置
+uint32_t AnimationPlayer::drawFrame(uint32_t pos)
+{
+	const uint8_t *p = animation->data + pos;
+	duration = le16(p);
+	uint16_t count = le16(p + 2);
+	p += ANIMATION_FRAME_HEADER;
+	for (uint16_t i = 0; i < count; i++) {
+		TFTImage rect;
+		rect.width = le16(p + 4);
+		rect.height = le16(p + 6);
+		rect.format = p[8];
+		rect.data = p + ANIMATION_RECT_HEADER;
+		rect.palette = animation->palette;
+		tft->drawImage(x + le16(p), y + le16(p + 2), &rect);
+		p += ANIMATION_RECT_HEADER + le32(p + 9);
+	}
+	return p - animation->data;
+}
+
+/// @brief 時間に関係なく、すぐに次のフレームを表示する
+/// @details 最後のフレームの後は、ループする設定なら最初のフレームに戻る。
+/// 最初に戻る差分フレームがあればそれを、なければキーフレームを表示する。
+void AnimationPlayer::drawNextFrame()
+{
+	if (next >= animation->frameCount) {
+		if (!loop) return;
+		if (animation->loopOffset == 0) {
+			next = 0;
+			offset = 0;
+		}
+	}
+	if (next >= animation->frameCount) {
+		// 最後のフレームから最初のフレームに戻る差分。表示されるのは最初のフレームなので、続きはキーフレームの次から
+		drawFrame(animation->loopOffset);
+		next = 1;
+		offset = firstDelta;
+		return;
+	}
+	offset = drawFrame(offset);
+	if (next == 0) firstDelta = offset;
+	next++;
+}
+
+/// @brief 次のフレームを表示する時刻になっていれば、表示する。loopの中などから、繰り返し呼び出す
+/// @details 最初の呼び出しでは、すぐにキーフレームを表示する。
+/// @return フレームを表示したらtrue
+bool AnimationPlayer::update()
+{
+	if (finished()) return false;
+	uint32_t now = time_us_32();
+	if (started && (int32_t)(now - due) < 0) return false;
+	if (!started) {
+		due = now;
+		started = true;
+	}
+	drawNextFrame();
+	due += (uint32_t)duration * 1000;
+	now = time_us_32();
+	if ((int32_t)(now - due) > 0) {
+		// 間に合わなかった。遅れは取り戻さず、次のフレームの時間はここから数える
+		overrunCount++;
+		due = now;
+	}
+	return true;
+}
+
+/// @brief 最後のフレームを表示するまで、時間に合わせて再生する。ループする設定なら戻らない
+void AnimationPlayer::play()
+{
+	while (!finished()) {
+		if (started) {
+			int32_t wait = (int32_t)(due - time_us_32());
+			if (wait > 0) sleep_us(wait);
+		}
+		update();
+	}
+}
+#endif
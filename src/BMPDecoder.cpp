@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <string.h>
+#include "../include/BMPDecoder.h"
+#include "../include/ColorConvert.h"
+#if !defined(TFT_HOST_TOOL)
+#include "../include/ST7735_TFT.h"
+#endif
+
+/**
+ * @file BMPDecoder.cpp
+ * @brief BMPファイルを読み込んで表示する、BMPDecoderクラスを定義する。
+ */
+
+#define BMP_FILE_HEADER 14		// BITMAPFILEHEADERの大きさ
+#define BMP_INFO_HEADER 40		// BITMAPINFOHEADERの大きさ。V4、V5のヘッダはこれより大きい
+#define BMP_RGB 0				// 無圧縮
+#define BMP_BITFIELDS 3			// 無圧縮で、色の成分の位置をマスクで指定する
+
+static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+/// @brief ヘッダを読み、画像の大きさと形式を求める
+/// @param in 画像データ。画素の先頭まで読み進める
+/// @param info 画像の情報
+/// @return 読めない形式ならfalse
+bool BMPDecoder::ReadHeader(ImageStream &in, BMPInfo *info)
+{
+	uint8_t h[BMP_FILE_HEADER + BMP_INFO_HEADER];
+	if (!in.Read(h, sizeof(h)) || h[0] != 'B' || h[1] != 'M') return false;
+	uint32_t offset = le32(&h[10]);
+	int32_t width = (int32_t)le32(&h[18]);
+	int32_t height = (int32_t)le32(&h[22]);
+	uint32_t compression = le32(&h[30]);
+	if (le32(&h[14]) < BMP_INFO_HEADER || le16(&h[26]) != 1) return false;
+	info->depth = le16(&h[28]);
+	info->topDown = height < 0;
+	if (height < 0) height = -height;
+	if (width <= 0 || width > 0xFFFF || height == 0 || height > 0xFFFF) return false;
+	info->width = width;
+	info->height = height;
+	info->rgb555 = info->depth == 16;  // 16ビットの無圧縮は555
+
+	if (compression == BMP_BITFIELDS) {
+		// マスクはINFOHEADERの直後（V4、V5ではヘッダの中の同じ位置）にある
+		uint8_t m[12];
+		if (!in.Read(m, sizeof(m))) return false;
+		uint32_t r = le32(&m[0]), g = le32(&m[4]), b = le32(&m[8]);
+		if (info->depth == 16 && r == 0xF800 && g == 0x07E0 && b == 0x001F) {
+			info->rgb555 = false;
+		} else if (info->depth == 16 && r == 0x7C00 && g == 0x03E0 && b == 0x001F) {
+			info->rgb555 = true;
+		} else if (!(info->depth == 32 && r == 0xFF0000 && g == 0xFF00 && b == 0xFF)) {
+			return false;
+		}
+	} else if (compression != BMP_RGB) {
+		return false;
+	}
+	if (info->depth != 16 && info->depth != 24 && info->depth != 32) return false;
+
+	uint32_t pos = in.Position();
+	if (offset < pos) return false;
+	return in.Skip(offset - pos);
+}
+
+/// @brief 読み込んだ画素を、RGB565（送る順）に変換する。バッファの中でそのまま変換する
+static void bmpConvert(const BMPInfo &info, uint16_t *line, uint16_t n)
+{
+	uint8_t *d = (uint8_t *)line;
+	if (info.depth == 16 && !info.rgb555) {
+		for (; n > 0; n--, d += 2) {
+			uint8_t lo = d[0];
+			d[0] = d[1];
+			d[1] = lo;
+		}
+	} else if (info.depth == 16) {
+		for (; n > 0; n--, d += 2) {
+			uint16_t v = le16(d);
+			uint16_t g = (v >> 5) & 0x1F;
+			uint16_t c = ((v << 1) & 0xF800) | (((g << 1) | (g >> 4)) << 5) | (v & 0x1F);
+			d[0] = c >> 8;
+			d[1] = c;
+		}
+	} else if (info.depth == 24) {
+		ColorConvert::FromBGR888(line, d, n, TFT_COLOR_PANEL_ORDER);
+	} else {
+		ColorConvert::FromARGB8888(line, d, n, TFT_COLOR_PANEL_ORDER);  // BGRX
+	}
+}
+
+/// @brief BMPファイルの矩形の部分を、１行ずつ読み込んで出力関数に渡す
+/// @details 行は、ファイルに並んでいる順（普通のBMPでは下から上）に渡す。
+/// 矩形の外の行と列は読み飛ばす。１行がTFT_LINE_BUFFER_PIXELSより広いときは、何回かに分けて渡す。
+/// @param in 画像データ
+/// @param sx 読み込む矩形の、画像の中での左上の座標
+/// @param sy 読み込む矩形の、画像の中での左上の座標
+/// @param w 読み込む矩形の幅。画像からはみ出す部分は切り取る
+/// @param h 読み込む矩形の高さ。画像からはみ出す部分は切り取る
+/// @param output 出力関数
+/// @param context 出力関数に渡す値
+/// @return 読めない形式か、データが途中で終わっていればfalse。出力関数がfalseを返して止めたときはtrue
+bool BMPDecoder::Decode(ImageStream &in, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, BMPOutputFunc output, void *context)
+{
+	BMPInfo info;
+	if (!ReadHeader(in, &info)) return false;
+	return DecodeRows(in, info, sx, sy, w, h, output, context);
+}
+
+/// @brief ReadHeaderの後で、矩形の部分の行を読み込む。引数はDecodeと同じ
+bool BMPDecoder::DecodeRows(ImageStream &in, const BMPInfo &info, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, BMPOutputFunc output, void *context)
+{
+	if (sx >= info.width || sy >= info.height) return true;
+	if (w > info.width - sx) w = info.width - sx;
+	if (h > info.height - sy) h = info.height - sy;
+
+	uint8_t bytes = info.depth / 8;
+	uint32_t rowBytes = (info.width * bytes + 3) & ~3u;  // 行は4バイト単位
+	uint32_t after = rowBytes - (uint32_t)(sx + w) * bytes;  // 矩形の右の列と詰め物
+	uint16_t line[TFT_LINE_BUFFER_PIXELS * 2];  // 32ビットの画素で1行分
+	uint16_t rows = 0;
+
+	for (uint32_t i = 0; i < info.height && rows < h; i++) {
+		uint32_t row = info.topDown ? i : info.height - 1 - i;
+		if (row < sy || row >= (uint32_t)sy + h) {
+			if (!in.Skip(rowBytes)) return false;
+			continue;
+		}
+		if (!in.Skip(sx * bytes)) return false;
+		for (uint16_t col = 0; col < w;) {
+			uint16_t n = (w - col > TFT_LINE_BUFFER_PIXELS) ? TFT_LINE_BUFFER_PIXELS : w - col;
+			if (!in.Read(line, n * bytes)) return false;
+			bmpConvert(info, line, n);
+			if (!output(context, sx + col, row, n, (const uint8_t *)line)) return true;
+			col += n;
+		}
+		if (!in.Skip(after)) return false;
+		rows++;
+	}
+	return true;
+}
+
+#if !defined(TFT_HOST_TOOL)
+/// @brief Drawの表示先
+struct BMPDrawTarget {
+	ST7735 *tft;
+	int16_t x, y;
+	int32_t left, width, bottom;	///< 見えている範囲（画面の座標）
+	int32_t nextY;					///< 設定してあるアドレスウインドウで、次に送る行。なければ-1
+};
+
+/// @brief 読み込んだ行を送る
+static bool bmpDrawRow(void *context, uint16_t x, uint16_t y, uint16_t w, const uint8_t *pixels)
+{
+	BMPDrawTarget *t = (BMPDrawTarget *)context;
+	int32_t px = t->x + x, py = t->y + y;
+	if (px == t->left && w == t->width) {
+		// 行全体。続きの行なら、設定してあるアドレスウインドウにそのまま送る
+		if (py != t->nextY) t->tft->setAddrWindow(px, py, px + w - 1, t->bottom);
+		t->nextY = py + 1;
+	} else {
+		t->tft->setAddrWindow(px, py, px + w - 1, py);
+		t->nextY = -1;
+	}
+	t->tft->writeDataBlock((uint8_t *)pixels, w * 2);
+	return true;
+}
+
+/// @brief BMPファイルを、１行ずつ読み込みながら表示する
+/// @details 画面からはみ出す部分は切り取り、読み飛ばす。
+/// @param tft 表示先
+/// @param x 表示する左上の座標。画面の外（負の値）でもよい
+/// @param y 表示する左上の座標。画面の外（負の値）でもよい
+/// @param in 画像データ
+/// @return 読めない形式か、データが途中で終わっていればfalse
+bool BMPDecoder::Draw(ST7735 *tft, int16_t x, int16_t y, ImageStream &in)
+{
+	// 画面の範囲を、画像の中の矩形にする
+	int32_t sx = (x < 0) ? -x : 0;
+	int32_t sy = (y < 0) ? -y : 0;
+	int32_t w = tft->st7735Init.width - (x + sx);
+	int32_t h = tft->st7735Init.height - (y + sy);
+	if (w <= 0 || h <= 0) return true;
+	BMPInfo info;
+	if (!ReadHeader(in, &info)) return false;
+	if ((uint32_t)sx >= info.width || (uint32_t)sy >= info.height) return true;
+	if ((uint32_t)w > info.width - sx) w = info.width - sx;
+	if ((uint32_t)h > info.height - sy) h = info.height - sy;
+
+	BMPDrawTarget target;
+	target.tft = tft;
+	target.x = x;
+	target.y = y;
+	target.left = x + sx;
+	target.width = (w > TFT_LINE_BUFFER_PIXELS) ? -1 : w;
+	target.bottom = y + sy + h - 1;
+	target.nextY = -1;
+	return DecodeRows(in, info, sx, sy, w, h, bmpDrawRow, &target);
+}
+#endif
@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include "../include/ColorConvert.h"
+
+/**
+ * @file ColorConvert.cpp
+ * @brief 画素の並びをRGB565に変換する、ColorConvertクラスを定義する。
+ * @details 形式（成分の位置と１画素のバイト数）とオプションの組み合わせごとに、分岐のないループをテンプレートで作る。
+ * ループの中では、画素ごとに形式やオプションを調べない。
+ */
+
+/// @brief 4x4のBayer行列（0～15）。ディザのしきい値になる
+static const uint8_t colorBayer[4][4] = {
+	{0, 8, 2, 10},
+	{12, 4, 14, 6},
+	{3, 11, 1, 9},
+	{15, 7, 13, 5},
+};
+
+/// @brief RGB565の値を、液晶に送る順（上位、下位）のバイトでメモリに置いたときのuint16_tの値にする
+static inline uint16_t colorPanelOrder(uint16_t c)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	return c;
+#else
+	return (uint16_t)((c >> 8) | (c << 8));  // コンパイラがREV16などの１命令にする
+#endif
+}
+
+/// @brief １画素をRGB565に変換する
+/// @details ディザをかけるときは、成分を 0～(255 - 255 / 32) に縮めてからしきい値（5ビットの成分では0～7、
+/// 6ビットでは0～3）を足して切り捨てる。縮めてあるので、足しても成分の最大値を超えず、飽和の処理が要らない。
+/// @tparam R 画素の中の赤の位置（バイト）
+/// @tparam G 画素の中の緑の位置（バイト）
+/// @tparam B 画素の中の青の位置（バイト）
+/// @tparam DITHER ディザをかけるならtrue
+/// @tparam PANEL 液晶に送る順のバイトにするならtrue
+/// @param t ディザのしきい値（Bayer行列の値）
+template <uint8_t R, uint8_t G, uint8_t B, bool DITHER, bool PANEL>
+static inline uint16_t colorPixel(const uint8_t *src, uint8_t t)
+{
+	uint8_t r = src[R], g = src[G], b = src[B];
+	uint16_t c;
+	if (DITHER) {
+		c = (((r - (r >> 5) + (t >> 1)) >> 3) << 11) | (((g - (g >> 6) + (t >> 2)) >> 2) << 5) | ((b - (b >> 5) + (t >> 1)) >> 3);
+	} else {
+		c = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+	}
+	return PANEL ? colorPanelOrder(c) : c;
+}
+
+/// @brief 画素の並びをRGB565に変換する
+/// @details ４画素ずつ変換する。ディザの模様は４画素で一回りするので、４画素の中の位置ごとのしきい値は、ループの外で決まる。
+/// 出力の画素は入力の画素より小さいので（グレースケールを除く）、同じバッファでも、書く前に読み終わっている。
+/// @tparam STEP １画素のバイト数。他はcolorPixelと同じ
+template <uint8_t R, uint8_t G, uint8_t B, uint8_t STEP, bool DITHER, bool PANEL>
+static void colorConvert(uint16_t *dst, const uint8_t *src, uint32_t count, uint16_t x, uint16_t y)
+{
+	const uint8_t *threshold = colorBayer[y & 3];
+	uint8_t t[4];
+	for (uint8_t i = 0; i < 4; i++) t[i] = threshold[(x + i) & 3];
+	for (; count >= 4; count -= 4, src += STEP * 4, dst += 4) {
+		dst[0] = colorPixel<R, G, B, DITHER, PANEL>(src, t[0]);
+		dst[1] = colorPixel<R, G, B, DITHER, PANEL>(src + STEP, t[1]);
+		dst[2] = colorPixel<R, G, B, DITHER, PANEL>(src + STEP * 2, t[2]);
+		dst[3] = colorPixel<R, G, B, DITHER, PANEL>(src + STEP * 3, t[3]);
+	}
+	for (uint8_t i = 0; i < count; i++) dst[i] = colorPixel<R, G, B, DITHER, PANEL>(src + STEP * i, t[i]);
+}
+
+/// @brief オプションに合ったループを選んで変換する
+template <uint8_t R, uint8_t G, uint8_t B, uint8_t STEP>
+static void colorConvertOptions(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options, uint16_t x, uint16_t y)
+{
+	switch (options & (TFT_COLOR_PANEL_ORDER | TFT_COLOR_DITHER)) {
+		case 0:
+			colorConvert<R, G, B, STEP, false, false>(dst, src, count, x, y);
+			break;
+		case TFT_COLOR_PANEL_ORDER:
+			colorConvert<R, G, B, STEP, false, true>(dst, src, count, x, y);
+			break;
+		case TFT_COLOR_DITHER:
+			colorConvert<R, G, B, STEP, true, false>(dst, src, count, x, y);
+			break;
+		default:
+			colorConvert<R, G, B, STEP, true, true>(dst, src, count, x, y);
+			break;
+	}
+}
+
+/// @brief R、G、Bの順に並んだ画素を変換する
+/// @param dst 出力先。count個のuint16_t
+/// @param src 変換元。srcと同じバッファでもよい
+/// @param count 画素数
+/// @param options TFT_COLOR_PANEL_ORDER、TFT_COLOR_DITHERの組み合わせ
+/// @param x 先頭の画素の画面での座標。ディザの模様を決める
+/// @param y 先頭の画素の画面での座標。ディザの模様を決める
+void ColorConvert::FromRGB888(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options, uint16_t x, uint16_t y)
+{
+	colorConvertOptions<0, 1, 2, 3>(dst, src, count, options, x, y);
+}
+
+/// @brief B、G、Rの順に並んだ画素を変換する。引数はFromRGB888と同じ
+void ColorConvert::FromBGR888(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options, uint16_t x, uint16_t y)
+{
+	colorConvertOptions<2, 1, 0, 3>(dst, src, count, options, x, y);
+}
+
+/// @brief 0xAARRGGBBの画素（バイトはB、G、R、Aの順）を変換する。αは使わない。引数はFromRGB888と同じ
+void ColorConvert::FromARGB8888(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options, uint16_t x, uint16_t y)
+{
+	colorConvertOptions<2, 1, 0, 4>(dst, src, count, options, x, y);
+}
+
+/// @brief グレースケールの画素を変換する。引数はFromRGB888と同じ
+/// @details 出力の方が大きいので、srcとdstに同じバッファは使えない。
+void ColorConvert::FromGray8(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options, uint16_t x, uint16_t y)
+{
+	colorConvertOptions<0, 0, 0, 1>(dst, src, count, options, x, y);
+}
+
+/// @brief 形式を指定して変換する。引数はFromRGB888と同じ
+/// @param format 変換元の形式（TFT_PIXEL_RGB888など）
+/// @return 知らない形式ならfalse
+bool ColorConvert::Convert(uint8_t format, uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options, uint16_t x, uint16_t y)
+{
+	switch (format) {
+		case TFT_PIXEL_RGB888:
+			FromRGB888(dst, src, count, options, x, y);
+			return true;
+		case TFT_PIXEL_BGR888:
+			FromBGR888(dst, src, count, options, x, y);
+			return true;
+		case TFT_PIXEL_ARGB8888:
+			FromARGB8888(dst, src, count, options, x, y);
+			return true;
+		case TFT_PIXEL_GRAY8:
+			FromGray8(dst, src, count, options, x, y);
+			return true;
+	}
+	return false;
+}
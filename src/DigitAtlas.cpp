@@ -0,0 +1,262 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/DigitAtlas.h"
+#include "../include/GlyphRaster.h"
+#if defined(TFT_ENABLE_KANJI)
+#include "../include/KanjiHelper.h"
+#endif
+
+/**
+ * @file DigitAtlas.cpp
+ * @brief 数字や単位の文字をRGB565に展開して持ち、数値を表示する、DigitAtlasクラスを定義する。
+ */
+
+#if defined(TFT_ENABLE_TEXT) && defined(TFT_ENABLE_FONTS)
+/// @brief アトラスに必ず入れる文字。先頭の10文字は数字で、entriesの添字が数字の値になる
+static const char baseChars[] = "0123456789 -+.:";
+#define ATLAS_SPACE 10
+#define ATLAS_MINUS 11
+#define ATLAS_POINT 13
+#define ATLAS_BASE_COUNT 15
+
+/// @brief GlyphRasterが描く前景の矩形を、アトラスの１文字の枠に前景色で書き込む
+struct AtlasCell {
+	uint8_t *pixels;	///< 枠の左上
+	uint16_t width;		///< 枠の幅
+	uint8_t fh, fl;		///< 前景色（送信順に上位、下位）
+};
+
+static void fillAtlasCell(void *context, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+	AtlasCell *cell = (AtlasCell *)context;
+	for (uint16_t yy = y; yy < y + h; yy++) {
+		uint8_t *q = cell->pixels + ((uint32_t)yy * cell->width + x) * 2;
+		for (uint16_t xx = 0; xx < w; xx++) {
+			*q++ = cell->fh;
+			*q++ = cell->fl;
+		}
+	}
+}
+
+DigitAtlas::DigitAtlas()
+{
+	tft = NULL;
+	kanji = false;
+	pixels = NULL;
+	cellHeight = 0;
+	top = 0;
+	count = 0;
+}
+
+DigitAtlas::~DigitAtlas()
+{
+	end();
+}
+
+/// @brief アトラスを解放する
+void DigitAtlas::end()
+{
+	free(pixels);
+	pixels = NULL;
+	count = 0;
+}
+
+/// @brief 数字と単位の文字を、指定された色でRGB565に展開する
+/// @details GFXフォントは、setFontで指定されているフォントを使い、drawTextLineと同じく送り幅 x 行の高さの枠に描く。
+/// 漢字フォントは、setKanjiFontで指定されているテーブルの半角（単位の文字は全角も可）を使う。
+/// beginの後でフォントを変えても、アトラスは変わらない。
+/// @param tft 表示先
+/// @param kanji trueなら漢字フォント、falseならGFXフォント
+/// @param color 文字の色
+/// @param bg 背景色。アトラスは背景ごと展開するので、透過色は使えない
+/// @param size 文字のサイズ
+/// @param units 単位として加える文字（UTF-8、TFT_DIGIT_ATLAS_MAX_UNITS文字まで）。"℃%V" など
+/// @return アトラスのメモリが確保できなければfalse
+bool DigitAtlas::begin(ST7735 *tft, bool kanji, uint16_t color, uint16_t bg, uint8_t size, const char *units)
+{
+	end();
+	this->tft = tft;
+	this->kanji = kanji;
+	if (size < 1) size = 1;
+
+	// 文字コードと送り幅を並べ、アトラスの大きさを決める
+	const GFXfont *font = _gfxFont;
+	int8_t ascent = 0;
+#if defined(TFT_ENABLE_KANJI)
+	if (kanji) {
+		cellHeight = KanjiHelper::Table().height * size;
+		top = 0;
+	} else
+#endif
+	{
+		// 枠の上端は、フォント中で一番高い文字の上端（drawTextLineと同じ）
+		ascent = GlyphRaster::FontAscent(font);
+		cellHeight = font->yAdvance * size;
+		top = ascent * size;
+	}
+	uint8_t n = 0;
+	uint32_t total = 0;
+	const char *p = baseChars;
+	for (int pass = 0; pass < 2; pass++) {
+		while (p && *p && n < ATLAS_BASE_COUNT + TFT_DIGIT_ATLAS_MAX_UNITS) {
+			uint32_t code = (uint8_t)*p;
+			uint8_t step = 1;
+			uint16_t w = 0;
+#if defined(TFT_ENABLE_KANJI)
+			if (kanji) {
+				step = KanjiHelper::DecodeUTF8(p, &code, kanjiForceHankana);
+				if (step == 0) break;  // 不正なUTF-8バイト
+				uint8_t gw, gh;
+				KanjiHelper::GetGlyphSize(code, &gw, &gh);
+				w = gw * size;
+			} else
+#endif
+			if (code >= font->first && code <= font->last) {
+				w = font->glyph[code - font->first].xAdvance * size;
+			}
+			p += step;
+			entries[n].code = code;
+			entries[n].width = w;
+			entries[n].offset = total;
+			total += (uint32_t)w * cellHeight * 2;
+			n++;
+		}
+		p = units;
+	}
+	pixels = (uint8_t *)malloc(total ? total : 1);
+	if (pixels == NULL) return false;
+	count = n;
+
+	// 背景色で埋めてから、前景のドットを描く
+	uint8_t bh = bg >> 8, bl = bg & 0xFF;
+	for (uint32_t i = 0; i < total; i += 2) {
+		pixels[i] = bh;
+		pixels[i + 1] = bl;
+	}
+	AtlasCell cell;
+	cell.fh = color >> 8;
+	cell.fl = color & 0xFF;
+	for (uint8_t i = 0; i < count; i++) {
+		cell.pixels = pixels + entries[i].offset;
+		cell.width = entries[i].width;
+		if (cell.width == 0) continue;
+#if defined(TFT_ENABLE_KANJI)
+		if (kanji) {
+			KanjiGlyph glyph;
+			if (KanjiHelper::GetGlyph(entries[i].code, &glyph)) {
+				GlyphRaster::RasterizeKanji(&glyph, size, fillAtlasCell, &cell);
+			}
+			continue;
+		}
+#endif
+		GlyphRaster::RasterizeGfx(font, entries[i].code, ascent, size, fillAtlasCell, &cell);
+	}
+	return true;
+}
+
+/// @brief 単位の文字を、アトラスの添字にして並べる。アトラスにない文字は飛ばす
+/// @return 並べた後の文字数
+uint8_t DigitAtlas::appendUnit(const char *unit, uint8_t *glyphs, uint8_t n)
+{
+	const char *p = unit;
+	while (p && *p && n < TFT_DIGIT_ATLAS_MAX_CHARS) {
+		// アトラスの文字コードは、beginと同じ手順で求める
+		uint32_t code = (uint8_t)*p;
+		uint8_t step = 1;
+#if defined(TFT_ENABLE_KANJI)
+		if (kanji) {
+			step = KanjiHelper::DecodeUTF8(p, &code, kanjiForceHankana);
+			if (step == 0) break;
+		}
+#endif
+		p += step;
+		for (uint8_t i = ATLAS_BASE_COUNT; i < count; i++) {
+			if (entries[i].code == code) {
+				glyphs[n++] = i;
+				break;
+			}
+		}
+	}
+	return n;
+}
+
+/// @brief 整数を表示する
+/// @param x 表示するx座標
+/// @param y 表示するy座標。GFXフォントではベースライン、漢字フォントでは上端（drawText/drawTextKanjiと同じ）
+/// @param value 表示する値
+/// @param width 数値部分の文字数。値の桁数が足りなければ、左を空白で埋めて右寄せにする。
+/// 前回より桁数が減っても残りが消えるよう、表示する最大の桁数を指定しておく。0なら詰めない
+/// @param unit 数値の後に表示する単位（beginで加えた文字のみ）
+/// @return 表示した幅
+uint16_t DigitAtlas::drawInt(int16_t x, int16_t y, int32_t value, uint8_t width, const char *unit)
+{
+	return drawFixed(x, y, value, 0, width, unit);
+}
+
+/// @brief 固定小数点数を表示する。value / 10^decimals を、小数点以下decimals桁で表示する
+/// @details 2537, decimals=2 なら "25.37"、-5, decimals=2 なら "-0.05" になる。sprintfは使わない
+/// @param decimals 小数点以下の桁数
+/// @return 表示した幅
+uint16_t DigitAtlas::drawFixed(int16_t x, int16_t y, int32_t value, uint8_t decimals, uint8_t width, const char *unit)
+{
+	if (pixels == NULL) return 0;
+	// 下の桁から逆順に並べる。INT32_MINでも溢れないよう、符号なしで扱う
+	uint8_t digits[TFT_DIGIT_ATLAS_MAX_CHARS];
+	uint8_t n = 0;
+	uint32_t v = (value < 0) ? 0u - (uint32_t)value : (uint32_t)value;
+	uint8_t minLen = decimals ? decimals + 2 : 1;  // "0.05" のように、小数点の前に少なくとも１桁
+	do {
+		digits[n++] = v % 10;
+		v /= 10;
+		if (n == decimals) digits[n++] = ATLAS_POINT;
+	} while ((v != 0 || n < minLen) && n < TFT_DIGIT_ATLAS_MAX_CHARS - 2);
+	if (value < 0) digits[n++] = ATLAS_MINUS;
+
+	uint8_t glyphs[TFT_DIGIT_ATLAS_MAX_CHARS];
+	uint8_t len = 0;
+	for (uint8_t i = n; i < width && len < TFT_DIGIT_ATLAS_MAX_CHARS; i++) glyphs[len++] = ATLAS_SPACE;
+	while (n > 0 && len < TFT_DIGIT_ATLAS_MAX_CHARS) glyphs[len++] = digits[--n];
+	len = appendUnit(unit, glyphs, len);
+	return drawGlyphs(x, y, glyphs, len);
+}
+
+/// @brief アトラスの文字を並べて表示する。全体を１つのアドレスウインドウにし、１ラインずつアトラスの行をつないで送る
+uint16_t DigitAtlas::drawGlyphs(int16_t x, int16_t y, const uint8_t *glyphs, uint8_t n)
+{
+	uint16_t total = 0;
+	for (uint8_t i = 0; i < n; i++) total += entries[glyphs[i]].width;
+
+	// 画面の範囲に切り取る
+	int16_t y0 = y + top;
+	int16_t x0 = (x < 0) ? 0 : x;
+	int16_t x1 = x + total;
+	int16_t y1 = y0 + cellHeight;
+	if (x1 > (int16_t)tft->st7735Init.width) x1 = tft->st7735Init.width;
+	if (x1 > x0 + TFT_LINE_BUFFER_PIXELS) x1 = x0 + TFT_LINE_BUFFER_PIXELS;
+	if (y1 > (int16_t)tft->st7735Init.height) y1 = tft->st7735Init.height;
+	int16_t row0 = (y0 < 0) ? -y0 : 0;
+	if (y0 < 0) y0 = 0;
+	if (x0 >= x1 || y0 >= y1) return total;
+
+	uint8_t line[TFT_LINE_BUFFER_PIXELS * 2];
+	tft->setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	for (int16_t row = row0; row < row0 + (y1 - y0); row++) {
+		uint8_t *p = line;
+		int16_t cx = x;
+		for (uint8_t i = 0; i < n && cx < x1; i++) {
+			uint16_t w = entries[glyphs[i]].width;
+			int16_t left = (cx < x0) ? x0 - cx : 0;			// 左で切り取られる列数
+			int16_t right = (cx + w > x1) ? x1 - cx : w;	// 見えている列の終わり
+			if (right > left) {
+				const uint8_t *src = pixels + entries[glyphs[i]].offset + ((uint32_t)row * w + left) * 2;
+				memcpy(p, src, (right - left) * 2);
+				p += (right - left) * 2;
+			}
+			cx += w;
+		}
+		tft->writeDataBlock(line, p - line);
+	}
+	return total;
+}
+#endif
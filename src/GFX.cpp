@@ -10,15 +10,11 @@ extern "C" {
 
 	#include "../include/ST7735_TFT.h"
 	#include "../include/hw.h"
+	#if defined(TFT_ENABLE_KANJI)
+	#include "../include/KanjiHelper.h"
+	#endif
 	#include "hardware/spi.h"
 
-	#ifdef TFT_ENABLE_FONTS
-		#include "../include/font/Font_Mono9p.h"
-		#include "../include/font/Font_Mono18p.h"
-		#include "../include/font/FreeMonoOblique12pt7b.h"
-		#include "../include/font/FreeMonoOblique12pt_sub.h"
-
-	#endif
 	#pragma GCC diagnostic ignored "-Wunused-variable"
 
 
@@ -50,13 +46,6 @@ extern "C" {
 	// そのため文字列リテラル以外を使う時にはこの静的変数を使う
 	static char errTxt[128];			
 
-	// フォントを保存しておく構造体。
-#ifdef TFT_ENABLE_FONTS
-	static struct {
-		const char *name;
-		const GFXfont* font;
-	} fontList[16];
-#endif
 
 
 	/// @brief 与えられた変数のタイプを文字列で返す関数。デバッグ用
@@ -110,22 +99,7 @@ extern "C" {
 	/// @brief グラフィックスオブジェクトを作成する。ソフトウェア関連の初期化を行う
 	mp_obj_t CreateGFX(mp_obj_t a_pHW)
 	{
-		// フォント関連の初期化
-#ifdef TFT_ENABLE_FONTS
-		for (int i = 0; i < 16; i++) {
-			fontList[i].name = NULL;
-			fontList[i].font = NULL;
-		}
-		fontList[0].font = &FreeMono9pt7b;
-		fontList[0].name = "FreeMono9pt7b";
-		fontList[1].font = &FreeMono18pt7b;
-		fontList[1].name = "FreeMono18pt7b";
-		fontList[2].font = &FreeMonoOblique12pt_sub;
-		fontList[2].name = "FreeMonoOblique12pt_sub";
-		fontList[3].font = &FreeMonoOblique12pt7b;
-		fontList[3].name = "FreeMonoOblique12pt7b";
-
-#endif
+		// フォントの一覧はライブラリと共通のregisteredFonts（ST7735_fonts.cpp）を使う
 
 		if (HWObj.portSPI == NULL) {
 			mp_raise_ValueError("Must call InitHW before CreateGFX");
@@ -319,13 +293,13 @@ extern "C" {
 	#else
 		if (!mp_obj_is_str(a_fontname)) mp_raise_TypeError("Expected a string for 1st argument");
 		const char* str = mp_obj_str_get_str(a_fontname);
-		for (int i = 0; fontList[i].name != NULL;i++){
-			if (strcmp(str,fontList[i].name) == 0) {
-				ST7735Obj.setFont(fontList[i].font);
+		for (int i = 0; i < TFT_MAX_FONTS && registeredFonts[i].name != NULL;i++){
+			if (strcmp(str,registeredFonts[i].name) == 0) {
+				ST7735Obj.setFont(registeredFonts[i].font);
 				return mp_obj_new_int(1);
 			}
 		}
-		mp_raise_ValueError("Font name {str} not found. Check the specified font name or define the font in the fontList structure in GFX.cpp");
+		mp_raise_ValueError("Font name {str} not found. Check the specified font name or define the font in the registeredFonts structure in ST7735_fonts.cpp");
 	#endif
 	}
 
@@ -341,14 +315,52 @@ extern "C" {
 		return mp_obj_new_int(0);
 	#else
 		mp_obj_t list = mp_obj_new_list(0, NULL);
-		for (int i = 0; fontList[i].name != NULL; i++) {
-			mp_obj_list_append(list, mp_obj_new_str(fontList[i].name, strlen(fontList[i].name)));
+		for (int i = 0; i < TFT_MAX_FONTS && registeredFonts[i].name != NULL; i++) {
+			mp_obj_list_append(list, mp_obj_new_str(registeredFonts[i].name, strlen(registeredFonts[i].name)));
 		}
 		return list;
 	#endif		
 	}
-	
-	
+
+
+	/// @brief 漢字機能が有効な時、drawTextKanjiで使用される漢字フォントを名前で指定する
+	mp_obj_t setKanjiFont(mp_obj_t a_fontname)
+	{
+	#if !defined(TFT_ENABLE_TEXT)
+		mp_raise_NotImplementedError("since TFT_ENABLE_TEXT is disabled during the build, this function cannot be used. Check ST7735_TFT.h ");
+		return mp_obj_new_int(0);
+	#elif !defined(TFT_ENABLE_KANJI)
+		mp_raise_NotImplementedError("since TFT_ENABLE_KANJI is disabled during the build, this function cannot be used. Check ST7735_TFT.h ");
+		return mp_obj_new_int(0);
+	#else
+		if (!mp_obj_is_str(a_fontname)) mp_raise_TypeError("Expected a string for 1st argument");
+		const char* str = mp_obj_str_get_str(a_fontname);
+		if (!ST7735Obj.setKanjiFont(str)) {
+			mp_raise_ValueError("Kanji font name not found. Check the specified font name or TFT_KANJI_EXTRA_FONTn in KanjiHelper.h");
+		}
+		return mp_obj_new_int(1);
+	#endif
+	}
+
+	/// @brief 漢字機能が有効な時、drawTextKanjiで使用できる漢字フォント名を返す
+	mp_obj_t getAvailableKanjiFonts()
+	{
+	#if !defined(TFT_ENABLE_TEXT)
+		mp_raise_NotImplementedError("since TFT_ENABLE_TEXT is disabled during the build, this function cannot be used. Check ST7735_TFT.h ");
+		return mp_obj_new_int(0);
+	#elif !defined(TFT_ENABLE_KANJI)
+		mp_raise_NotImplementedError("since TFT_ENABLE_KANJI is disabled during the build, this function cannot be used. Check ST7735_TFT.h ");
+		return mp_obj_new_int(0);
+	#else
+		mp_obj_t list = mp_obj_new_list(0, NULL);
+		for (int i = 0; i < TFT_MAX_KANJI_FONTS && registeredKanjiFonts[i].name != NULL; i++) {
+			mp_obj_list_append(list, mp_obj_new_str(registeredKanjiFonts[i].name, strlen(registeredKanjiFonts[i].name)));
+		}
+		return list;
+	#endif
+	}
+
+
 	/// @brief 基本的な描画処理関数…　横線
 	mp_obj_t drawFastHLine(mp_obj_t a_xy , mp_obj_t a_w, mp_obj_t a_c)
 	{
@@ -694,12 +706,58 @@ extern "C" {
 		return mp_obj_new_int(1);
 	#endif
 	}
+	mp_obj_t bmpDrawRect(mp_obj_t a_xy, mp_obj_t a_bmpData, mp_obj_t a_src)
+	{
+	#if !defined(TFT_ENABLE_BITMAP)
+		mp_raise_NotImplementedError("since TFT_ENABLE_BITMAP is disabled during the build, this function cannot be used. Check ST7735_TFT.h ");
+	#else
+		if (!mp_obj_is_type(a_xy, &mp_type_tuple)) mp_raise_TypeError("Expected a tuple for 1st argument");
+		if (!mp_obj_is_type(a_bmpData, &mp_type_array)) mp_raise_TypeError("Expected a array for 2nd argument");
+		if (!mp_obj_is_type(a_src, &mp_type_tuple)) mp_raise_TypeError("Expected a tuple for 3rd argument");
+		int x, y, stride, sx, sy, w, h;
+		{
+			size_t len;
+			mp_obj_t* items;
+			mp_obj_tuple_get(a_xy, &len, &items);
+			if (len != 2) mp_raise_ValueError("Expected 2 elements in the tuple containing x,y");
+			x = mp_obj_get_int(items[0]);
+			y = mp_obj_get_int(items[1]);
+			mp_obj_tuple_get(a_src, &len, &items);
+			if (len != 5) mp_raise_ValueError("Expected 5 elements in the tuple containing stride,sx,sy,w,h");
+			stride = mp_obj_get_int(items[0]);
+			sx = mp_obj_get_int(items[1]);
+			sy = mp_obj_get_int(items[2]);
+			w = mp_obj_get_int(items[3]);
+			h = mp_obj_get_int(items[4]);
+		}
+		if (stride <= 0 || sx < 0 || sy < 0 || w < 0 || h < 0 || sx + w > stride) mp_raise_ValueError("invalid source rectangle");
+		uint16_t* data;
+		{
+			mp_buffer_info_t bufInfo;
+			mp_get_buffer_raise(a_bmpData, &bufInfo, MP_BUFFER_READ);
+			size_t len = bufInfo.len / sizeof(uint16_t);
+
+			unsigned int dataCnt = (sy + h) * stride;
+			if (len < dataCnt) {
+				snprintf(errTxt, sizeof(errTxt), "invalid data size. Expected at least %d words, actual %d words", dataCnt, len);
+				mp_raise_ValueError(errTxt);
+			}
+			data = (uint16_t*)bufInfo.buf;
+		}
+
+		ST7735Obj.bmpDrawRect(x, y, data, stride, sx, sy, w, h);
+		return mp_obj_new_int(1);
+	#endif
+	}
+
+	/// @brief registerBitmapで登録できるビットマップの数。アイコンをたくさん使うときは、１枚の画像にまとめて登録し、bmpRegDrawRectで一部分を表示する
+	#define BMP_REGISTER_COUNT 16
 	struct {
-		uint8_t w;
-		uint8_t h;
+		uint16_t w;
+		uint16_t h;
 		uint16_t* data;
 	}
-	bmpData[16];
+	bmpData[BMP_REGISTER_COUNT];
 
 	mp_obj_t registerBitmap(mp_obj_t a_idx , mp_obj_t a_wh, mp_obj_t a_bmpData)
 	{
@@ -712,6 +770,7 @@ extern "C" {
 		if (!mp_obj_is_type(a_bmpData, &mp_type_array)) mp_raise_TypeError("Expected a array for 3rd argument");
 
 		int idx = mp_obj_get_int(a_idx);
+		if (idx < 0 || idx >= BMP_REGISTER_COUNT) mp_raise_ValueError("bitmap index out of range");
 		int w, h;
 		{
 			size_t len;
@@ -763,6 +822,37 @@ extern "C" {
 
 		return mp_obj_new_int(1);
 	}
+	mp_obj_t bmpRegDrawRect(mp_obj_t a_idx, mp_obj_t a_xy, mp_obj_t a_src)
+	{
+#if !defined(TFT_ENABLE_BITMAP)
+		mp_raise_NotImplementedError("since TFT_ENABLE_BITMAP is disabled during the build, this function cannot be used. Check ST7735_TFT.h ");
+#else
+		if (!mp_obj_is_int(a_idx)) mp_raise_TypeError("Expected a int for 1st argument");
+		if (!mp_obj_is_type(a_xy, &mp_type_tuple)) mp_raise_TypeError("Expected a tuple for 2nd argument");
+		if (!mp_obj_is_type(a_src, &mp_type_tuple)) mp_raise_TypeError("Expected a tuple for 3rd argument");
+		int idx = mp_obj_get_int(a_idx);
+		if (idx < 0 || idx >= BMP_REGISTER_COUNT || bmpData[idx].data == NULL) mp_raise_ValueError("bitmap is not registered");
+		int x, y, sx, sy, w, h;
+		{
+			size_t len;
+			mp_obj_t* items;
+			mp_obj_tuple_get(a_xy, &len, &items);
+			if (len != 2) mp_raise_ValueError("Expected 2 elements in the tuple containing x,y");
+			x = mp_obj_get_int(items[0]);
+			y = mp_obj_get_int(items[1]);
+			mp_obj_tuple_get(a_src, &len, &items);
+			if (len != 4) mp_raise_ValueError("Expected 4 elements in the tuple containing sx,sy,w,h");
+			sx = mp_obj_get_int(items[0]);
+			sy = mp_obj_get_int(items[1]);
+			w = mp_obj_get_int(items[2]);
+			h = mp_obj_get_int(items[3]);
+		}
+		if (sx < 0 || sy < 0 || w < 0 || h < 0 || sx + w > bmpData[idx].w || sy + h > bmpData[idx].h) mp_raise_ValueError("invalid source rectangle");
+
+		ST7735Obj.bmpDrawRect(x, y, bmpData[idx].data, bmpData[idx].w, sx, sy, w, h);
+		return mp_obj_new_int(1);
+#endif
+	}
 	mp_obj_t bmpUseTransColor(mp_obj_t a_c)
 	{
 #if !defined(TFT_ENABLE_BITMAP)
@@ -783,6 +873,54 @@ extern "C" {
 		return mp_obj_new_int(1);
 	}
 #endif
+	/// @brief 24ビット、32ビットカラーやグレースケールの画像を表示する。drawRGB((x, y, w, h), data, (format, options))
+	/// @details dataはbytes、bytearray、arrayなど、バッファを持つオブジェクト。3番目の引数は形式だけ（int）でもよい
+	mp_obj_t drawRGB(mp_obj_t a_xywh, mp_obj_t a_data, mp_obj_t a_format)
+	{
+	#if !defined(TFT_ENABLE_BITMAP)
+		mp_raise_NotImplementedError("since TFT_ENABLE_BITMAP is disabled during the build, this function cannot be used. Check ST7735_TFT.h ");
+	#else
+		if (!mp_obj_is_type(a_xywh, &mp_type_tuple)) mp_raise_TypeError("Expected a tuple for 1st argument");
+		int x, y, w, h, format, options = 0;
+		{
+			size_t len;
+			mp_obj_t* items;
+			mp_obj_tuple_get(a_xywh, &len, &items);
+			if (len != 4) mp_raise_ValueError("Expected 4 elements in the tuple containing x,y,w,h");
+			x = mp_obj_get_int(items[0]);
+			y = mp_obj_get_int(items[1]);
+			w = mp_obj_get_int(items[2]);
+			h = mp_obj_get_int(items[3]);
+			if (mp_obj_is_int(a_format)) {
+				format = mp_obj_get_int(a_format);
+			} else if (mp_obj_is_type(a_format, &mp_type_tuple)) {
+				mp_obj_tuple_get(a_format, &len, &items);
+				if (len != 2) mp_raise_ValueError("Expected 2 elements in the tuple containing format,options");
+				format = mp_obj_get_int(items[0]);
+				options = mp_obj_get_int(items[1]);
+			} else {
+				mp_raise_TypeError("Expected a int or tuple for 3rd argument");
+			}
+		}
+		int bytes = ColorConvert::BytesPerPixel(format);
+		if (bytes == 0) mp_raise_ValueError("unknown pixel format");
+		if (w < 0 || h < 0) mp_raise_ValueError("invalid size");
+		const uint8_t* data;
+		{
+			mp_buffer_info_t bufInfo;
+			mp_get_buffer_raise(a_data, &bufInfo, MP_BUFFER_READ);
+			unsigned int dataCnt = w * h * bytes;
+			if (bufInfo.len < dataCnt) {
+				snprintf(errTxt, sizeof(errTxt), "invalid data size. Expected at least %d bytes, actual %d bytes", dataCnt, bufInfo.len);
+				mp_raise_ValueError(errTxt);
+			}
+			data = (const uint8_t*)bufInfo.buf;
+		}
+
+		ST7735Obj.drawRGB(x, y, w, h, data, format, options);
+		return mp_obj_new_int(1);
+	#endif
+	}
 #endif
 }
 
@@ -20,6 +20,8 @@ static MP_DEFINE_CONST_FUN_OBJ_1(setAsciiFont_obj, setAsciiFont);
 static MP_DEFINE_CONST_FUN_OBJ_0(getAvaiableAsciiFonts_obj, getAvaiableAsciiFonts);
 static MP_DEFINE_CONST_FUN_OBJ_2(drawText_obj, drawText);
 static MP_DEFINE_CONST_FUN_OBJ_2(drawTextKanji_obj, drawTextKanji);
+static MP_DEFINE_CONST_FUN_OBJ_1(setKanjiFont_obj, setKanjiFont);
+static MP_DEFINE_CONST_FUN_OBJ_0(getAvailableKanjiFonts_obj, getAvailableKanjiFonts);
 
 // スクロール関連関数
 static MP_DEFINE_CONST_FUN_OBJ_3(setScrollDefinition_obj, setScrollDefinition);
@@ -50,10 +52,13 @@ static MP_DEFINE_CONST_FUN_OBJ_2(drawLine_obj, drawLine);
 
 // ビットマップ関数 static MP_DEFINE_CONST_FUN_OBJ_3(_obj, );
 static MP_DEFINE_CONST_FUN_OBJ_3(bmpDraw_obj, bmpDraw);
+static MP_DEFINE_CONST_FUN_OBJ_3(bmpDrawRect_obj, bmpDrawRect);
 static MP_DEFINE_CONST_FUN_OBJ_3(registerBitmap_obj, registerBitmap);
 static MP_DEFINE_CONST_FUN_OBJ_3(bmpRegDraw_obj, bmpRegDraw);
+static MP_DEFINE_CONST_FUN_OBJ_3(bmpRegDrawRect_obj, bmpRegDrawRect);
 static MP_DEFINE_CONST_FUN_OBJ_1(bmpUseTransColor_obj, bmpUseTransColor);
 static MP_DEFINE_CONST_FUN_OBJ_0(bmpUnuseTransColor_obj, bmpUnuseTransColor);
+static MP_DEFINE_CONST_FUN_OBJ_3(drawRGB_obj, drawRGB);
 
 // Define all attributes of the module.
 // Table entries are key/value pairs of the attribute name (a string)
@@ -80,6 +85,8 @@ static const mp_rom_map_elem_t KNJGfx_globals_table[] = {
 	{MP_ROM_QSTR(MP_QSTR_getAvaiableAsciiFonts), MP_ROM_PTR(&getAvaiableAsciiFonts_obj)},
 	{MP_ROM_QSTR(MP_QSTR_drawText), MP_ROM_PTR(&drawText_obj)},
 	{MP_ROM_QSTR(MP_QSTR_drawTextKanji), MP_ROM_PTR(&drawTextKanji_obj)},
+	{MP_ROM_QSTR(MP_QSTR_setKanjiFont), MP_ROM_PTR(&setKanjiFont_obj)},
+	{MP_ROM_QSTR(MP_QSTR_getAvailableKanjiFonts), MP_ROM_PTR(&getAvailableKanjiFonts_obj)},
 
 	// スクロール関連関数
 	{MP_ROM_QSTR(MP_QSTR_setScrollDefinition), MP_ROM_PTR(&setScrollDefinition_obj)},
@@ -108,10 +115,18 @@ static const mp_rom_map_elem_t KNJGfx_globals_table[] = {
 
 	// ビットマップ関数　		{MP_ROM_QSTR(MP_QSTR_), MP_ROM_PTR(&_obj)},
 	{MP_ROM_QSTR(MP_QSTR_bmpDraw), MP_ROM_PTR(&bmpDraw_obj)},
+	{MP_ROM_QSTR(MP_QSTR_bmpDrawRect), MP_ROM_PTR(&bmpDrawRect_obj)},
 	{MP_ROM_QSTR(MP_QSTR_registerBitmap), MP_ROM_PTR(&registerBitmap_obj)},
 	{MP_ROM_QSTR(MP_QSTR_bmpRegDraw), MP_ROM_PTR(&bmpRegDraw_obj)},
+	{MP_ROM_QSTR(MP_QSTR_bmpRegDrawRect), MP_ROM_PTR(&bmpRegDrawRect_obj)},
 	{MP_ROM_QSTR(MP_QSTR_bmpUseTransColor), MP_ROM_PTR(&bmpUseTransColor_obj)},
 	{MP_ROM_QSTR(MP_QSTR_bmpUnuseTransColor), MP_ROM_PTR(&bmpUnuseTransColor_obj)},
+	{MP_ROM_QSTR(MP_QSTR_drawRGB), MP_ROM_PTR(&drawRGB_obj)},
+	{MP_ROM_QSTR(MP_QSTR_PIXEL_RGB888), MP_ROM_INT(TFT_PIXEL_RGB888)},
+	{MP_ROM_QSTR(MP_QSTR_PIXEL_BGR888), MP_ROM_INT(TFT_PIXEL_BGR888)},
+	{MP_ROM_QSTR(MP_QSTR_PIXEL_ARGB8888), MP_ROM_INT(TFT_PIXEL_ARGB8888)},
+	{MP_ROM_QSTR(MP_QSTR_PIXEL_GRAY8), MP_ROM_INT(TFT_PIXEL_GRAY8)},
+	{MP_ROM_QSTR(MP_QSTR_COLOR_DITHER), MP_ROM_INT(TFT_COLOR_DITHER)},
 };
 
 static MP_DEFINE_CONST_DICT(KNJGfx_module_globals, KNJGfx_globals_table);
@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include "../include/GlyphRaster.h"
+#include "../include/KanjiHelper.h"
+
+/**
+ * @file GlyphRaster.cpp
+ * @brief 文字を前景の矩形の並びにする、GlyphRasterクラスを定義する。
+ */
+
+/// @brief フォントのすべての文字から、ベースラインから上端までの距離の最大値を求める。文字枠の上端を決めるために使う。
+/// @param font フォント
+/// @return 一番上に出る文字のyOffset
+int8_t GlyphRaster::FontAscent(const GFXfont *font)
+{
+	int8_t ascent = 0;
+	for (uint16_t c = font->first; c <= font->last; c++) {
+		const GFXglyph *glyph = &(font->glyph[c - font->first]);
+		if (glyph->height > 0 && glyph->yOffset < ascent) {
+			ascent = glyph->yOffset;
+		}
+	}
+	return ascent;
+}
+
+/// @brief GFXフォントの１文字を、送り幅 x 行の高さの枠に描く
+/// @details 送り幅の外や行の枠の外にはみ出す点は、drawTextLineと同じく切り取る。
+/// @param font フォント
+/// @param c 文字コード。フォントにない文字なら何もしない
+/// @param ascent 枠の上端のベースラインからの距離（FontAscentの値）
+/// @param size 拡大率
+/// @param fill 前景の矩形を受け取る関数
+/// @param context fillに渡す値
+void GlyphRaster::RasterizeGfx(const GFXfont *font, uint8_t c, int8_t ascent, uint8_t size, GlyphFillFunc fill, void *context)
+{
+	if (c < font->first || c > font->last) return;
+	if (size < 1) size = 1;
+	const GFXglyph *glyph = &font->glyph[c - font->first];
+	// 枠の中に見えている、文字の画像の中での列の範囲
+	int16_t gx0 = (glyph->xOffset < 0) ? -glyph->xOffset : 0;
+	int16_t gx1 = glyph->xAdvance - glyph->xOffset;
+	if (gx1 > glyph->width) gx1 = glyph->width;
+	for (int16_t gy = 0; gy < glyph->height; gy++) {
+		int16_t cy = gy + glyph->yOffset - ascent;
+		if (cy < 0 || cy >= font->yAdvance) continue;
+		uint32_t rowBit = (uint32_t)glyph->bitmapOffset * 8 + (uint32_t)gy * glyph->width;
+		int16_t gx = gx0;
+		while (gx < gx1) {
+			// 前景のランを探す
+			while (gx < gx1 && !(font->bitmap[(rowBit + gx) >> 3] & (0x80 >> ((rowBit + gx) & 7)))) gx++;
+			if (gx >= gx1) break;
+			int16_t runStart = gx;
+			while (gx < gx1 && (font->bitmap[(rowBit + gx) >> 3] & (0x80 >> ((rowBit + gx) & 7)))) gx++;
+			fill(context, (runStart + glyph->xOffset) * size, cy * size, (gx - runStart) * size, size);
+		}
+	}
+}
+
+/// @brief 漢字フォントの１文字を、文字の幅 x 高さの枠に描く
+/// @details KanjiRowReaderで上の行から１行ずつ取り出すので、圧縮された文字も展開用のバッファなしで描ける。
+/// @param glyph KanjiHelper::GetGlyphなどで取り出した文字
+/// @param size 拡大率
+/// @param fill 前景の矩形を受け取る関数
+/// @param context fillに渡す値
+void GlyphRaster::RasterizeKanji(const KanjiGlyph *glyph, uint8_t size, GlyphFillFunc fill, void *context)
+{
+	if (glyph->width == 0 || glyph->width > KANJI_CODEC_MAX_WIDTH) return;  // KanjiRowReaderが扱える幅を超える
+	if (size < 1) size = 1;
+	int16_t w = glyph->width;
+	KanjiRowReader reader;
+	reader.Begin(glyph);
+	for (int16_t sy = 0; sy < glyph->height; sy++) {
+		uint32_t row = reader.NextRow();
+		int16_t sx = 0;
+		while (sx < w) {
+			// 前景のランを探す
+			while (sx < w && !((row >> (w - 1 - sx)) & 1)) sx++;
+			if (sx >= w) break;
+			int16_t runStart = sx;
+			while (sx < w && ((row >> (w - 1 - sx)) & 1)) sx++;
+			fill(context, runStart * size, sy * size, (sx - runStart) * size, size);
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <string.h>
+#include "../include/ImageStream.h"
+
+/**
+ * @file ImageStream.cpp
+ * @brief 画像データを先頭から順に読み出す、ImageStreamクラスを定義する。
+ */
+
+ImageStream::ImageStream()
+{
+	BeginMemory(NULL, 0);
+}
+
+/// @brief 読み出し関数で、少しずつ読み込む
+/// @param read 読み出し関数
+/// @param context 読み出し関数に渡す値
+void ImageStream::Begin(ImageReadFunc read, void *context)
+{
+	this->read = read;
+	this->context = context;
+	start = pos = end = buffer;
+	consumed = 0;
+	failed = false;
+}
+
+/// @brief メモリ上のデータを、コピーせずにそのまま読む
+/// @param data データ
+/// @param size データの大きさ
+void ImageStream::BeginMemory(const uint8_t *data, uint32_t size)
+{
+	read = NULL;
+	context = NULL;
+	start = pos = data;
+	end = data + size;
+	consumed = 0;
+	failed = false;
+}
+
+/// @brief バッファが空のとき、次のブロックを読み込んで１バイト返す
+uint8_t ImageStream::Refill()
+{
+	consumed += (uint32_t)(end - start);
+	start = pos = end = buffer;
+	uint32_t n = (read && !failed) ? read(context, buffer, sizeof(buffer)) : 0;
+	if (n == 0) {
+		failed = true;
+		return 0;
+	}
+	end = buffer + n;
+	return *pos++;
+}
+
+/// @brief 指定したバイト数を読む
+/// @details バッファが空で、バッファより大きく読むときは、読み出し関数で直接bufferに読み込む（BMPの１行など）
+/// @return すべて読めたらtrue
+bool ImageStream::Read(void *buffer, uint32_t length)
+{
+	uint8_t *dst = (uint8_t *)buffer;
+	while (length > 0) {
+		if (pos == end && read && length >= sizeof(this->buffer)) {
+			consumed += (uint32_t)(end - start);
+			start = pos = end = this->buffer;
+			uint32_t n = failed ? 0 : read(context, dst, length);
+			if (n == 0) {
+				failed = true;
+				return false;
+			}
+			consumed += n;
+			dst += n;
+			length -= n;
+			continue;
+		}
+		if (pos == end) {
+			*dst++ = Refill();
+			length--;
+			if (failed) return false;
+			continue;
+		}
+		uint32_t n = (uint32_t)(end - pos);
+		if (n > length) n = length;
+		memcpy(dst, pos, n);
+		pos += n;
+		dst += n;
+		length -= n;
+	}
+	return true;
+}
+
+/// @brief 指定したバイト数を読み飛ばす
+/// @return すべて読み飛ばせたらtrue
+bool ImageStream::Skip(uint32_t length)
+{
+	while (length > 0) {
+		if (pos == end) {
+			Refill();
+			length--;
+			if (failed) return false;
+			continue;
+		}
+		uint32_t n = (uint32_t)(end - pos);
+		if (n > length) n = length;
+		pos += n;
+		length -= n;
+	}
+	return true;
+}
+
+uint16_t ImageStream::ReadLE16()
+{
+	uint16_t v = ReadByte();
+	return v | (ReadByte() << 8);
+}
+
+uint32_t ImageStream::ReadLE32()
+{
+	uint32_t v = ReadLE16();
+	return v | ((uint32_t)ReadLE16() << 16);
+}
+
+uint32_t ImageStream::ReadBE32()
+{
+	uint32_t v = 0;
+	for (int i = 0; i < 4; i++) v = (v << 8) | ReadByte();
+	return v;
+}
@@ -0,0 +1,668 @@
+#include <stdint.h>
+#include <string.h>
+#include "../include/JPEGDecoder.h"
+#include "../include/ColorConvert.h"
+#if !defined(TFT_HOST_TOOL)
+#include "../include/ST7735_TFT.h"
+#endif
+
+/**
+ * @file JPEGDecoder.cpp
+ * @brief ベースラインJPEGを展開する、JPEGDecoderクラスを定義する。
+ * @details 形式は ITU-T T.81 による。逆DCTは、IJG libjpeg の jidctint.c（ISLOW）と同じ整数演算の方法。
+ */
+
+// マーカー
+#define JPEG_SOF0 0xC0	// ベースライン
+#define JPEG_SOF1 0xC1	// 拡張シーケンシャル（ハフマン符号）
+#define JPEG_DHT 0xC4
+#define JPEG_RST0 0xD0
+#define JPEG_RST7 0xD7
+#define JPEG_SOI 0xD8
+#define JPEG_EOI 0xD9
+#define JPEG_SOS 0xDA
+#define JPEG_DQT 0xDB
+#define JPEG_DRI 0xDD
+
+// 逆DCTの定数（13ビットの固定小数点）
+#define IDCT_CONST_BITS 13
+#define IDCT_PASS1_BITS 2
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+#define DESCALE(x, n) (((x) + (1 << ((n) - 1))) >> (n))
+
+/// @brief ジグザグ順の番号から、8x8のブロックの中の位置を求める表
+static const uint8_t zigzag[64] = {
+	0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+static inline uint8_t clamp8(int32_t v)
+{
+	return (v < 0) ? 0 : (v > 255) ? 255 : (uint8_t)v;
+}
+
+/// @brief 8x8の係数を逆DCTし、0～255の画素にする
+/// @param in 逆量子化した係数（ブロックの中の位置の順）
+/// @param out 画素
+static void idct8x8(const int32_t *in, uint8_t *out)
+{
+	int32_t ws[64];
+	int32_t tmp0, tmp1, tmp2, tmp3, tmp10, tmp11, tmp12, tmp13, z1, z2, z3, z4, z5;
+
+	// 1回目：列ごと。結果はPASS1_BITSだけ大きくしておく
+	for (int col = 0; col < 8; col++) {
+		const int32_t *p = in + col;
+		int32_t *w = ws + col;
+		if ((p[8] | p[16] | p[24] | p[32] | p[40] | p[48] | p[56]) == 0) {
+			// 交流成分がない列（よくある）
+			int32_t dc = p[0] * (1 << IDCT_PASS1_BITS);
+			for (int i = 0; i < 64; i += 8) w[i] = dc;
+			continue;
+		}
+		// 偶数の部分
+		z2 = p[16];
+		z3 = p[48];
+		z1 = (z2 + z3) * FIX_0_541196100;
+		tmp2 = z1 - z3 * FIX_1_847759065;
+		tmp3 = z1 + z2 * FIX_0_765366865;
+		tmp0 = (p[0] + p[32]) * (1 << IDCT_CONST_BITS);
+		tmp1 = (p[0] - p[32]) * (1 << IDCT_CONST_BITS);
+		tmp10 = tmp0 + tmp3;
+		tmp13 = tmp0 - tmp3;
+		tmp11 = tmp1 + tmp2;
+		tmp12 = tmp1 - tmp2;
+		// 奇数の部分
+		tmp0 = p[56];
+		tmp1 = p[40];
+		tmp2 = p[24];
+		tmp3 = p[8];
+		z1 = tmp0 + tmp3;
+		z2 = tmp1 + tmp2;
+		z3 = tmp0 + tmp2;
+		z4 = tmp1 + tmp3;
+		z5 = (z3 + z4) * FIX_1_175875602;
+		tmp0 *= FIX_0_298631336;
+		tmp1 *= FIX_2_053119869;
+		tmp2 *= FIX_3_072711026;
+		tmp3 *= FIX_1_501321110;
+		z1 *= -FIX_0_899976223;
+		z2 *= -FIX_2_562915447;
+		z3 = z3 * -FIX_1_961570560 + z5;
+		z4 = z4 * -FIX_0_390180644 + z5;
+		tmp0 += z1 + z3;
+		tmp1 += z2 + z4;
+		tmp2 += z2 + z3;
+		tmp3 += z1 + z4;
+		const int n = IDCT_CONST_BITS - IDCT_PASS1_BITS;
+		w[0] = DESCALE(tmp10 + tmp3, n);
+		w[56] = DESCALE(tmp10 - tmp3, n);
+		w[8] = DESCALE(tmp11 + tmp2, n);
+		w[48] = DESCALE(tmp11 - tmp2, n);
+		w[16] = DESCALE(tmp12 + tmp1, n);
+		w[40] = DESCALE(tmp12 - tmp1, n);
+		w[24] = DESCALE(tmp13 + tmp0, n);
+		w[32] = DESCALE(tmp13 - tmp0, n);
+	}
+
+	// 2回目：行ごと。PASS1_BITSと、2次元の逆DCTの1/8を戻し、128を足す
+	for (int row = 0; row < 64; row += 8) {
+		const int32_t *w = ws + row;
+		uint8_t *o = out + row;
+		if ((w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7]) == 0) {
+			uint8_t v = clamp8(DESCALE(w[0], IDCT_PASS1_BITS + 3) + 128);
+			memset(o, v, 8);
+			continue;
+		}
+		z2 = w[2];
+		z3 = w[6];
+		z1 = (z2 + z3) * FIX_0_541196100;
+		tmp2 = z1 - z3 * FIX_1_847759065;
+		tmp3 = z1 + z2 * FIX_0_765366865;
+		tmp0 = (w[0] + w[4]) * (1 << IDCT_CONST_BITS);
+		tmp1 = (w[0] - w[4]) * (1 << IDCT_CONST_BITS);
+		tmp10 = tmp0 + tmp3;
+		tmp13 = tmp0 - tmp3;
+		tmp11 = tmp1 + tmp2;
+		tmp12 = tmp1 - tmp2;
+		tmp0 = w[7];
+		tmp1 = w[5];
+		tmp2 = w[3];
+		tmp3 = w[1];
+		z1 = tmp0 + tmp3;
+		z2 = tmp1 + tmp2;
+		z3 = tmp0 + tmp2;
+		z4 = tmp1 + tmp3;
+		z5 = (z3 + z4) * FIX_1_175875602;
+		tmp0 *= FIX_0_298631336;
+		tmp1 *= FIX_2_053119869;
+		tmp2 *= FIX_3_072711026;
+		tmp3 *= FIX_1_501321110;
+		z1 *= -FIX_0_899976223;
+		z2 *= -FIX_2_562915447;
+		z3 = z3 * -FIX_1_961570560 + z5;
+		z4 = z4 * -FIX_0_390180644 + z5;
+		tmp0 += z1 + z3;
+		tmp1 += z2 + z4;
+		tmp2 += z2 + z3;
+		tmp3 += z1 + z4;
+		const int n = IDCT_CONST_BITS + IDCT_PASS1_BITS + 3;
+		o[0] = clamp8(DESCALE(tmp10 + tmp3, n) + 128);
+		o[7] = clamp8(DESCALE(tmp10 - tmp3, n) + 128);
+		o[1] = clamp8(DESCALE(tmp11 + tmp2, n) + 128);
+		o[6] = clamp8(DESCALE(tmp11 - tmp2, n) + 128);
+		o[2] = clamp8(DESCALE(tmp12 + tmp1, n) + 128);
+		o[5] = clamp8(DESCALE(tmp12 - tmp1, n) + 128);
+		o[3] = clamp8(DESCALE(tmp13 + tmp0, n) + 128);
+		o[4] = clamp8(DESCALE(tmp13 - tmp0, n) + 128);
+	}
+}
+
+JPEGDecoder::JPEGDecoder()
+{
+	memset(dc, 0, sizeof(dc));
+	memset(ac, 0, sizeof(ac));
+	memset(&info, 0, sizeof(info));
+	restartInterval = 0;
+	in = NULL;
+}
+
+/// @brief ヘッダを読み、画像の大きさを求める
+/// @param in 画像データ。フレームヘッダ（SOF）の次まで読み進める
+/// @param info 画像の情報
+/// @return 対応しているJPEGでなければfalse
+bool JPEGDecoder::ReadHeader(ImageStream &in, JPEGInfo *info)
+{
+	restartInterval = 0;
+	dc[0].defined = dc[1].defined = ac[0].defined = ac[1].defined = false;
+	if (in.ReadByte() != 0xFF || in.ReadByte() != JPEG_SOI) return false;
+	if (!ReadSegments(in, false)) return false;
+	*info = this->info;
+	return true;
+}
+
+/// @brief マーカーで始まるセグメントを順に読む
+/// @param untilScan trueならスキャンヘッダ（SOS）まで、falseならフレームヘッダ（SOF）まで読む
+/// @return 対応していない形式か、データが途中で終わっていればfalse
+bool JPEGDecoder::ReadSegments(ImageStream &in, bool untilScan)
+{
+	for (;;) {
+		if (in.ReadByte() != 0xFF) return false;
+		uint8_t m;
+		do {
+			m = in.ReadByte();  // 0xFFは詰め物
+		} while (m == 0xFF && !in.Failed());
+		if (in.Failed() || m == JPEG_EOI) return false;
+		if (m == JPEG_SOI || (m >= JPEG_RST0 && m <= JPEG_RST7) || m == 0x01) continue;  // 長さのないマーカー
+		uint16_t length = in.ReadByte() << 8;
+		length |= in.ReadByte();
+		if (in.Failed() || length < 2) return false;
+		length -= 2;
+
+		switch (m) {
+			case JPEG_SOF0:
+			case JPEG_SOF1:
+				if (!ReadFrame(in, length)) return false;
+				if (!untilScan) return true;
+				break;
+			case JPEG_SOS:
+				if (!untilScan) return false;
+				return ReadScan(in, length);
+			case JPEG_DQT:
+				if (!ReadQuant(in, length)) return false;
+				break;
+			case JPEG_DHT:
+				if (!ReadHuffman(in, length)) return false;
+				break;
+			case JPEG_DRI:
+				if (length != 2) return false;
+				restartInterval = in.ReadByte() << 8;
+				restartInterval |= in.ReadByte();
+				break;
+			default:
+				// プログレッシブ、算術符号などのフレームには対応しない
+				if (m >= 0xC2 && m <= 0xCF && m != JPEG_DHT && m != 0xC8 && m != 0xCC) return false;
+				if (!in.Skip(length)) return false;
+				break;
+		}
+	}
+}
+
+/// @brief 量子化テーブル（DQT）を読む
+bool JPEGDecoder::ReadQuant(ImageStream &in, uint16_t length)
+{
+	while (length > 0) {
+		uint8_t pq = in.ReadByte();
+		uint8_t id = pq & 0x0F;
+		bool wide = (pq >> 4) != 0;  // 16ビットの値
+		uint16_t size = 1 + (wide ? 128 : 64);
+		if (id > 3 || length < size) return false;
+		for (int i = 0; i < 64; i++) {
+			uint16_t v = in.ReadByte();
+			if (wide) v = (v << 8) | in.ReadByte();
+			quant[id][i] = v;
+		}
+		length -= size;
+	}
+	return !in.Failed();
+}
+
+/// @brief ハフマン符号の表（DHT）を読む
+/// @details 符号長ごとの最初の符号と、その符号の値の位置から、符号を値に変換する表を作る
+bool JPEGDecoder::ReadHuffman(ImageStream &in, uint16_t length)
+{
+	while (length > 0) {
+		if (length < 17) return false;
+		uint8_t tc = in.ReadByte();
+		uint8_t id = tc & 0x0F;
+		if (id > 1 || (tc >> 4) > 1) return false;  // ベースラインでは表は2つずつ
+		Huffman &t = (tc >> 4) ? ac[id] : dc[id];
+		uint8_t counts[17];
+		if (!in.Read(counts + 1, 16)) return false;
+		int32_t code = 0;
+		uint16_t total = 0;
+		for (int len = 1; len <= 16; len++) {
+			t.delta[len] = total - code;
+			code += counts[len];
+			total += counts[len];
+			t.maxCode[len] = code;
+			if (code > (1 << len)) return false;  // 符号が長さに収まらない
+			code <<= 1;
+		}
+		if (total > 256 || length < 17 + total) return false;
+		if (!in.Read(t.values, total)) return false;
+		t.defined = true;
+		length -= 17 + total;
+	}
+	return true;
+}
+
+/// @brief フレームヘッダ（SOF）を読む
+bool JPEGDecoder::ReadFrame(ImageStream &in, uint16_t length)
+{
+	uint8_t precision = in.ReadByte();
+	info.height = in.ReadByte() << 8;
+	info.height |= in.ReadByte();
+	info.width = in.ReadByte() << 8;
+	info.width |= in.ReadByte();
+	info.components = in.ReadByte();
+	if (precision != 8 || info.width == 0 || info.height == 0) return false;
+	if ((info.components != 1 && info.components != 3) || length != 6 + info.components * 3) return false;
+
+	hMax = vMax = 1;
+	uint8_t blockCount = 0;
+	for (int i = 0; i < info.components; i++) {
+		Component &c = comp[i];
+		c.id = in.ReadByte();
+		uint8_t hv = in.ReadByte();
+		c.h = hv >> 4;
+		c.v = hv & 0x0F;
+		c.quant = in.ReadByte();
+		if (c.quant > 3 || c.h < 1 || c.h > 2 || c.v < 1 || c.v > 2) return false;
+		if (info.components == 1) c.h = c.v = 1;  // 成分が１つなら、MCUは常に１ブロック
+		if (c.h > hMax) hMax = c.h;
+		if (c.v > vMax) vMax = c.v;
+		blockCount += c.h * c.v;
+	}
+	// 色差は輝度を縦横整数倍に引き伸ばして使うので、4:4:4、4:2:2、4:4:0、4:2:0 だけ
+	for (int i = 0; i < info.components; i++) {
+		if (hMax % comp[i].h != 0 || vMax % comp[i].v != 0) return false;
+	}
+	return blockCount <= 6 && !in.Failed();
+}
+
+/// @brief スキャンヘッダ（SOS）を読む
+/// @details ベースラインでも成分ごとにスキャンを分けられるが、全成分を１つのスキャンに含むものにだけ対応する
+bool JPEGDecoder::ReadScan(ImageStream &in, uint16_t length)
+{
+	uint8_t n = in.ReadByte();
+	if (info.components == 0 || n != info.components || length != 4 + n * 2) return false;
+	for (int i = 0; i < n; i++) {
+		uint8_t id = in.ReadByte();
+		uint8_t tables = in.ReadByte();
+		if (comp[i].id != id) return false;
+		comp[i].dcTable = tables >> 4;
+		comp[i].acTable = tables & 0x0F;
+		if (comp[i].dcTable > 1 || comp[i].acTable > 1) return false;
+		if (!dc[comp[i].dcTable].defined || !ac[comp[i].acTable].defined) return false;
+	}
+	in.Skip(3);  // スペクトル選択と逐次近似。ベースラインでは固定
+	return !in.Failed();
+}
+
+/// @brief ビットのバッファに、24ビットを超えるまで符号化データを読み込む
+/// @details 0xFFの後の0x00は取り除く。マーカーに達したら、以後は0を補う
+void JPEGDecoder::FillBits()
+{
+	while (bitCount <= 24) {
+		uint32_t b = 0;
+		if (!marker) {
+			b = in->ReadByte();
+			if (b == 0xFF) {
+				uint8_t m;
+				do {
+					m = in->ReadByte();
+				} while (m == 0xFF && !in->Failed());
+				if (m != 0x00) {
+					marker = true;
+					markerCode = m;
+					b = 0;
+				}
+			}
+		}
+		bits |= b << (24 - bitCount);
+		bitCount += 8;
+	}
+}
+
+/// @brief nビットを読み、符号付きの値にする（T.81のRECEIVEとEXTEND）
+int32_t JPEGDecoder::Receive(uint8_t n)
+{
+	if (n == 0) return 0;
+	if (bitCount < n) FillBits();
+	int32_t v = bits >> (32 - n);
+	bits <<= n;
+	bitCount -= n;
+	if (v < (1 << (n - 1))) v -= (1 << n) - 1;
+	return v;
+}
+
+/// @brief ハフマン符号を１つ読み、値を返す
+/// @return 値。符号が表にないときは-1
+int16_t JPEGDecoder::DecodeHuffman(const Huffman &table)
+{
+	if (bitCount < 16) FillBits();
+	for (int len = 1; len <= 16; len++) {
+		int32_t code = bits >> (32 - len);
+		if (code < table.maxCode[len]) {
+			bits <<= len;
+			bitCount -= len;
+			return table.values[code + table.delta[len]];
+		}
+	}
+	return -1;
+}
+
+/// @brief １ブロックの符号を読み、逆DCTして縮小した画素にする
+/// @param c 色成分
+/// @param out 画素（8/scale x 8/scale）
+/// @param scale 縮小率（1、2、4、8）
+/// @return 符号が正しくなければfalse
+bool JPEGDecoder::DecodeBlock(Component &c, uint8_t *out, uint8_t scale)
+{
+	const uint16_t *q = quant[c.quant];
+	int16_t s = DecodeHuffman(dc[c.dcTable]);
+	if (s < 0 || s > 11) return false;
+	c.pred += Receive(s);
+
+	if (scale == 8) {
+		// 直流成分（ブロックの平均）だけを使う。交流成分は読み飛ばす
+		const Huffman &t = ac[c.acTable];
+		for (int k = 1; k < 64;) {
+			int16_t rs = DecodeHuffman(t);
+			if (rs < 0) return false;
+			if ((rs & 0x0F) == 0) {
+				if (rs != 0xF0) break;  // EOB
+				k += 16;
+			} else {
+				Receive(rs & 0x0F);
+				k += (rs >> 4) + 1;
+			}
+		}
+		out[0] = clamp8(DESCALE(c.pred * q[0], 3) + 128);
+		return true;
+	}
+
+	int32_t coef[64];
+	memset(coef, 0, sizeof(coef));
+	coef[0] = c.pred * q[0];
+	if (coef[0] < -2048) coef[0] = -2048;
+	else if (coef[0] > 2047) coef[0] = 2047;
+	const Huffman &t = ac[c.acTable];
+	for (int k = 1; k < 64;) {
+		int16_t rs = DecodeHuffman(t);
+		if (rs < 0) return false;
+		if ((rs & 0x0F) == 0) {
+			if (rs != 0xF0) break;  // EOB
+			k += 16;
+			continue;
+		}
+		k += rs >> 4;
+		if (k > 63) return false;
+		// 8ビットの画像の係数は±1024程度に収まる。壊れたデータで逆DCTが桁あふれしないよう制限する
+		int32_t v = Receive(rs & 0x0F) * q[k];
+		coef[zigzag[k]] = (v < -2048) ? -2048 : (v > 2047) ? 2047 : v;
+		k++;
+	}
+
+	if (scale == 1) {
+		idct8x8(coef, out);
+		return true;
+	}
+	// 縮小するときは、scale x scale の画素の平均にする
+	uint8_t full[64];
+	idct8x8(coef, full);
+	uint8_t n = 8 / scale;
+	uint8_t shift = (scale == 2) ? 2 : 4;
+	for (int y = 0; y < n; y++) {
+		for (int x = 0; x < n; x++) {
+			const uint8_t *p = full + y * scale * 8 + x * scale;
+			uint16_t sum = 0;
+			for (int j = 0; j < scale; j++, p += 8) {
+				for (int i = 0; i < scale; i++) sum += p[i];
+			}
+			out[y * n + x] = (sum + (1 << (shift - 1))) >> shift;
+		}
+	}
+	return true;
+}
+
+/// @brief リスタートマーカー（RSTn）を読み、直流成分の予測をリセットする
+bool JPEGDecoder::Restart()
+{
+	bits = 0;
+	bitCount = 0;
+	if (!marker) {
+		// まだマーカーを読んでいない（ビットの詰め物の後にある）
+		uint8_t b;
+		do {
+			b = in->ReadByte();
+		} while (b != 0xFF && !in->Failed());
+		do {
+			markerCode = in->ReadByte();
+		} while (markerCode == 0xFF && !in->Failed());
+	}
+	marker = false;
+	for (int i = 0; i < info.components; i++) comp[i].pred = 0;
+	return !in->Failed() && markerCode >= JPEG_RST0 && markerCode <= JPEG_RST7;
+}
+
+/// @brief MCUの各ブロックをRGB565に変換し、pixelsに並べる
+/// @param scale 縮小率
+/// @param w 出力する幅（右端では、MCUより小さい）
+/// @param h 出力する高さ（下端では、MCUより小さい）
+void JPEGDecoder::ConvertMCU(uint8_t scale, uint16_t w, uint16_t h)
+{
+	uint8_t n = 8 / scale;  // ブロックの１辺の画素数
+
+	if (info.components == 1) {
+		for (int y = 0; y < h; y++) ColorConvert::FromGray8(pixels + y * w, blocks[0] + y * n, w, TFT_COLOR_PANEL_ORDER);
+		return;
+	}
+	uint8_t rgb[16 * 3];  // MCUの１行分のRGB888。行ごとにColorConvertでRGB565にする
+
+	// 色差の成分は、輝度の画素に合わせて引き伸ばす（最も近い画素）
+	const Component &cy = comp[0], &cb = comp[1], &cr = comp[2];
+	const uint8_t *by = blocks[0];
+	const uint8_t *bb = blocks[cy.h * cy.v];
+	const uint8_t *br = bb + 64 * cb.h * cb.v;
+	uint8_t sy = vMax / cy.v, sb = vMax / cb.v, sr = vMax / cr.v;  // 縦の引き伸ばし
+	uint8_t ty = hMax / cy.h, tb = hMax / cb.h, tr = hMax / cr.h;  // 横の引き伸ばし
+	for (int y = 0; y < h; y++) {
+		int yy = y / sy, yb = y / sb, yr = y / sr;
+		const uint8_t *rowY = by + (yy / n) * cy.h * 64 + (yy % n) * n;
+		const uint8_t *rowB = bb + (yb / n) * cb.h * 64 + (yb % n) * n;
+		const uint8_t *rowR = br + (yr / n) * cr.h * 64 + (yr % n) * n;
+		uint8_t *dst = rgb;
+		for (int x = 0; x < w; x++) {
+			int xy = x / ty, xb = x / tb, xr = x / tr;
+			int32_t Y = rowY[(xy / n) * 64 + xy % n];
+			int32_t Cb = rowB[(xb / n) * 64 + xb % n] - 128;
+			int32_t Cr = rowR[(xr / n) * 64 + xr % n] - 128;
+			*dst++ = clamp8(Y + ((91881 * Cr + 32768) >> 16));
+			*dst++ = clamp8(Y + ((-22554 * Cb - 46802 * Cr + 32768) >> 16));
+			*dst++ = clamp8(Y + ((116130 * Cb + 32768) >> 16));
+		}
+		ColorConvert::FromRGB888(pixels + y * w, rgb, w, TFT_COLOR_PANEL_ORDER);
+	}
+}
+
+/// @brief JPEGの画像を展開し、MCUごとに出力関数に渡す
+/// @param in 画像データ
+/// @param scale 縮小率。1、2、4、8のどれか
+/// @param output 出力関数。MCUは左上から右へ、上から下への順
+/// @param context 出力関数に渡す値
+/// @return 対応していない形式か、データが壊れているか途中で終わっていればfalse。出力関数がfalseを返して止めたときはtrue
+bool JPEGDecoder::Decode(ImageStream &in, uint8_t scale, JPEGOutputFunc output, void *context)
+{
+	if (scale != 1 && scale != 2 && scale != 4 && scale != 8) return false;
+	JPEGInfo header;
+	if (!ReadHeader(in, &header)) return false;
+	if (!ReadSegments(in, true)) return false;
+
+	this->in = &in;
+	bits = 0;
+	bitCount = 0;
+	marker = false;
+	for (int i = 0; i < info.components; i++) comp[i].pred = 0;
+
+	uint8_t n = 8 / scale;
+	uint16_t mcuW = hMax * n, mcuH = vMax * n;          // 縮小したMCUの大きさ
+	uint16_t cols = (info.width + hMax * 8 - 1) / (hMax * 8);
+	uint16_t rows = (info.height + vMax * 8 - 1) / (vMax * 8);
+	uint16_t outW = (info.width + scale - 1) / scale;  // 縮小した画像の大きさ
+	uint16_t outH = (info.height + scale - 1) / scale;
+	uint16_t restarts = restartInterval;
+
+	for (uint16_t my = 0; my < rows; my++) {
+		for (uint16_t mx = 0; mx < cols; mx++) {
+			if (restartInterval) {
+				if (restarts == 0) {
+					if (!Restart()) return false;
+					restarts = restartInterval;
+				}
+				restarts--;
+			}
+			uint8_t *block = blocks[0];
+			for (int i = 0; i < info.components; i++) {
+				Component &c = comp[i];
+				for (int j = c.h * c.v; j > 0; j--, block += 64) {
+					if (!DecodeBlock(c, block, scale)) return false;
+				}
+			}
+			if (in.Failed()) return false;
+
+			uint16_t x = mx * mcuW, y = my * mcuH;
+			uint16_t w = (outW - x < mcuW) ? outW - x : mcuW;
+			uint16_t h = (outH - y < mcuH) ? outH - y : mcuH;
+			ConvertMCU(scale, w, h);
+			if (!output(context, x, y, w, h, (const uint8_t *)pixels)) return true;
+		}
+	}
+	return true;
+}
+
+#if !defined(TFT_HOST_TOOL)
+/// @brief Drawの表示先
+/// @details 1/8に縮小すると、MCUは1～2画素の大きさしかない。MCUごとにアドレスウインドウを設定すると遅いので、
+/// 横に並ぶMCUをstripにつなげて、MCUの１行を１回で送る
+struct JPEGDrawTarget {
+	ST7735 *tft;
+	int16_t x, y;
+	uint16_t stripX, stripY, stripW, stripH;  ///< stripにつなげたMCUの、画像の中での範囲
+	uint8_t strip[TFT_LINE_BUFFER_PIXELS * 2 * 2];  ///< 1/8に縮小したMCUを横につなげるバッファ。2行分
+};
+
+/// @brief 画素のかたまりを、画面の範囲に切り取って送る
+/// @param stride pixelsの１行のバイト数
+static void jpegSend(JPEGDrawTarget *t, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *pixels, uint16_t stride)
+{
+	int32_t left = t->x + x, top = t->y + y;
+	int32_t width = t->tft->st7735Init.width, height = t->tft->st7735Init.height;
+	int32_t x0 = (left < 0) ? 0 : left;
+	int32_t y0 = (top < 0) ? 0 : top;
+	int32_t x1 = (left + w > width) ? width : left + w;
+	int32_t y1 = (top + h > height) ? height : top + h;
+	if (x0 >= x1 || y0 >= y1) return;
+
+	t->tft->setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	if (x1 - x0 == w && stride == w * 2) {
+		t->tft->writeDataBlock((uint8_t *)pixels + (y0 - top) * stride, w * (y1 - y0) * 2);
+		return;
+	}
+	for (int32_t row = y0; row < y1; row++) {
+		t->tft->writeDataBlock((uint8_t *)pixels + (row - top) * stride + (x0 - left) * 2, (x1 - x0) * 2);
+	}
+}
+
+/// @brief stripにつなげたMCUを送る
+static void jpegFlushStrip(JPEGDrawTarget *t)
+{
+	if (t->stripW == 0) return;
+	jpegSend(t, t->stripX, t->stripY, t->stripW, t->stripH, t->strip, TFT_LINE_BUFFER_PIXELS * 2);
+	t->stripW = 0;
+}
+
+/// @brief 展開したMCUを送る
+static bool jpegDrawMCU(void *context, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *pixels)
+{
+	JPEGDrawTarget *t = (JPEGDrawTarget *)context;
+	if (t->y + y >= t->tft->st7735Init.height) return false;  // 以後のMCUはすべて画面の下
+	if (h > 2) {
+		jpegSend(t, x, y, w, h, pixels, w * 2);
+		return true;
+	}
+	if (t->stripW > 0 && (y != t->stripY || x != t->stripX + t->stripW || t->stripW + w > TFT_LINE_BUFFER_PIXELS)) jpegFlushStrip(t);
+	if (t->stripW == 0) {
+		t->stripX = x;
+		t->stripY = y;
+		t->stripH = h;
+	}
+	for (int row = 0; row < h; row++) {
+		memcpy(t->strip + row * TFT_LINE_BUFFER_PIXELS * 2 + t->stripW * 2, pixels + row * w * 2, w * 2);
+	}
+	t->stripW += w;
+	return true;
+}
+
+/// @brief JPEGの画像を、MCUごとに展開しながら表示する
+/// @details 画面からはみ出す部分は切り取る。画面の下端より下のMCUは展開しない。
+/// @param tft 表示先
+/// @param x 表示する左上の座標。画面の外（負の値）でもよい
+/// @param y 表示する左上の座標。画面の外（負の値）でもよい
+/// @param in 画像データ
+/// @param scale 縮小率。1、2、4、8のどれか
+/// @return 対応していない形式か、データが壊れているか途中で終わっていればfalse
+bool JPEGDecoder::Draw(ST7735 *tft, int16_t x, int16_t y, ImageStream &in, uint8_t scale)
+{
+	JPEGDrawTarget target;
+	target.tft = tft;
+	target.x = x;
+	target.y = y;
+	target.stripW = 0;
+	bool ok = Decode(in, scale, jpegDrawMCU, &target);
+	jpegFlushStrip(&target);
+	return ok;
+}
+#endif
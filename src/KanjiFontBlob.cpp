@@ -0,0 +1,328 @@
+#include <stdlib.h>
+#include <string.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "../include/KanjiFontBlob.h"
+
+/**
+ * @file KanjiFontBlob.cpp
+ * @brief フォントブロブを読み出すKanjiFontBlobクラスを定義する。
+ */
+
+KanjiFontBlob::KanjiFontBlob()
+{
+	read = NULL;
+	context = NULL;
+	memoryData = NULL;
+	memorySize = 0;
+	mapped = false;
+	modelBuffer = NULL;
+	End();
+}
+
+KanjiFontBlob::~KanjiFontBlob()
+{
+	End();
+}
+
+/// @brief 配列が、大きさsizeのブロブの中に収まっているか
+static bool blobSectionFits(uint32_t offset, uint32_t length, uint32_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+/// @brief 読み出し関数を指定して、フォントブロブを使い始める
+/// @details ヘッダとbucketを読み込み、キャッシュを空にする。圧縮されたブロブの場合は、確率表(4KBytes)もSRAMに読み込む。<br/>
+/// メモリから読めるブロブ（BeginMemory、OpenFile）では、各配列がブロブの中に収まっていることも確かめる。
+/// 読み出し関数で読むブロブは大きさが分からないので、範囲の外を読もうとしたときにfalseを返すのは読み出し関数の役目。
+/// @param read 読み出し関数
+/// @param context 読み出し関数に渡す値
+/// @return ブロブの形式が正しく、使えるならtrue
+bool KanjiFontBlob::Begin(KanjiReadFunc read, void *context)
+{
+	if (read != readMemory) {
+		End();
+	}
+	this->read = read;
+	this->context = context;
+	if (!read(context, 0, &header, sizeof(header)) || memcmp(header.magic, "KFNT", 4) != 0 || header.version != KANJI_BLOB_VERSION) {
+		End();
+		return false;
+	}
+	// 文字の幅は、KanjiRowReaderで描ける（圧縮された文字を復号できる）KANJI_CODEC_MAX_WIDTHまで
+	if (header.width > KANJI_CODEC_MAX_WIDTH || header.asciiWidth > KANJI_CODEC_MAX_WIDTH ||
+		(header.width * header.height + 7) / 8 > TFT_KANJI_CACHE_SLOT_BYTES ||
+		(header.asciiWidth * header.asciiHeight + 7) / 8 > TFT_KANJI_CACHE_SLOT_BYTES ||
+		!read(context, header.bucket, bucket, sizeof(bucket))) {
+		End();
+		return false;
+	}
+	// 壊れたブロブで、FindKanjiがcodesの範囲の外やスタックのバッファの外を読まないように、bucketを確かめる
+	for (uint16_t i = 0; i < 256; i++) {
+		if (bucket[i + 1] < bucket[i] || bucket[i + 1] - bucket[i] > 256) {
+			End();
+			return false;
+		}
+	}
+	if (bucket[256] > header.count) {
+		End();
+		return false;
+	}
+	// メモリから読めるブロブでは、確率表を直接参照するので、壊れたブロブで領域の外を読まないように各配列の位置と大きさを確かめる。
+	// 長さがヘッダから決まらない配列（半角文字と、圧縮された全角文字のビットマップ）は、先頭の位置だけを確かめる
+	if (memoryData != NULL) {
+		bool compressed = header.model != 0;
+		uint32_t bitmapBytes = compressed ? 0 : (uint32_t)header.count * ((header.width * header.height + 7) / 8);
+		uint32_t blockBytes = (header.count + KANJI_CODEC_BLOCK - 1) / KANJI_CODEC_BLOCK * 4;
+		if (!blobSectionFits(header.codes, header.count, memorySize) ||
+			!blobSectionFits(header.bitmaps, bitmapBytes, memorySize) ||
+			!blobSectionFits(header.asciiBitmaps, 0, memorySize) ||
+			(header.sjis != 0 && !blobSectionFits(header.sjis, header.count * 2, memorySize)) ||
+			(header.jis != 0 && !blobSectionFits(header.jis, header.count * 2, memorySize)) ||
+			(compressed && (!blobSectionFits(header.model, 1 << KANJI_CODEC_CONTEXT_BITS, memorySize) ||
+				!blobSectionFits(header.lengths, header.count, memorySize) ||
+				!blobSectionFits(header.blocks, blockBytes, memorySize)))) {
+			End();
+			return false;
+		}
+	}
+	if (header.model != 0 && memoryData == NULL) {
+		modelBuffer = (uint8_t *)malloc(1 << KANJI_CODEC_CONTEXT_BITS);
+		if (modelBuffer == NULL || !read(context, header.model, modelBuffer, 1 << KANJI_CODEC_CONTEXT_BITS)) {
+			End();
+			return false;
+		}
+	}
+
+	memset(&table, 0, sizeof(table));
+	table.width = header.width;
+	table.height = header.height;
+	table.asciiWidth = header.asciiWidth;
+	table.asciiHeight = header.asciiHeight;
+	table.count = header.count;
+	return true;
+}
+
+/// @brief メモリから読めるフォントブロブを使い始める
+/// @details XIPで読めるフラッシュの領域や、mmapしたファイルに使う。確率表はSRAMに読み込まずにそのまま使う。
+/// @param data ブロブの先頭
+/// @param size ブロブの大きさ
+/// @return ブロブの形式が正しく、使えるならtrue
+bool KanjiFontBlob::BeginMemory(const uint8_t *data, uint32_t size)
+{
+	End();
+	memoryData = data;
+	memorySize = size;
+	return Begin(readMemory, this);
+}
+
+#if defined(__linux__)
+/// @brief ファイルをmmapして、フォントブロブとして使い始める（Linuxのみ）
+/// @param path ファイル名
+/// @return ファイルを開けて、ブロブの形式が正しければtrue
+bool KanjiFontBlob::OpenFile(const char *path)
+{
+	End();
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (data == MAP_FAILED) return false;
+	if (!BeginMemory((const uint8_t *)data, st.st_size)) {
+		munmap(data, st.st_size);
+		return false;
+	}
+	mapped = true;
+	return true;
+}
+#endif
+
+/// @brief フォントブロブの使用を終える。OpenFileで開いたファイルは閉じる
+void KanjiFontBlob::End()
+{
+#if defined(__linux__)
+	if (mapped) {
+		munmap((void *)memoryData, memorySize);
+	}
+#endif
+	free(modelBuffer);
+	modelBuffer = NULL;
+	mapped = false;
+	memoryData = NULL;
+	memorySize = 0;
+	read = NULL;
+	context = NULL;
+	memset(&header, 0, sizeof(header));
+	memset(&table, 0, sizeof(table));
+	memset(bucket, 0, sizeof(bucket));
+	memset(cacheTags, 0, sizeof(cacheTags));
+	useCounter = 0;
+	cacheHits = 0;
+	cacheMisses = 0;
+}
+
+bool KanjiFontBlob::readMemory(void *context, uint32_t offset, void *buffer, uint32_t length)
+{
+	KanjiFontBlob *blob = (KanjiFontBlob *)context;
+	if (offset > blob->memorySize || length > blob->memorySize - offset) return false;
+	memcpy(buffer, blob->memoryData + offset, length);
+	return true;
+}
+
+/// @brief 文字を探す。探し方はKanjiHelper::FindKanjiと同じ
+/// @details bucketの範囲のcodesを１回で読み出してから、その中をバイナリサーチする。
+/// @param codeUTF 検索対象のUTF-8コード
+/// @return 検索された文字のブロブ内の番号。見つからなかったときは-1。
+int32_t KanjiFontBlob::FindKanji(uint32_t codeUTF)
+{
+	if (read == NULL) return -1;
+	uint32_t cp;
+	if (codeUTF <= 0x7F) {
+		cp = codeUTF;
+	} else if (codeUTF <= 0xFFFF) {
+		cp = ((codeUTF >> 8) & 0x1F) << 6 | (codeUTF & 0x3F);
+	} else if (codeUTF <= 0xFFFFFF) {
+		cp = ((codeUTF >> 16) & 0x0F) << 12 | ((codeUTF >> 8) & 0x3F) << 6 | (codeUTF & 0x3F);
+	} else {
+		return -1;				// ブロブにはBMPの文字しかない
+	}
+	uint16_t first = bucket[cp >> 8];
+	uint16_t count = bucket[(cp >> 8) + 1] - first;
+	uint8_t codes[256];
+	if (count == 0 || count > sizeof(codes) || !read(context, header.codes + first, codes, count)) {
+		return -1;
+	}
+	uint8_t low = cp & 0xFF;
+	int16_t left = 0, right = count - 1;
+	while (left <= right) {
+		int16_t middle = (left + right) / 2;
+		if (codes[middle] == low) {
+			return first + middle;
+		} else if (codes[middle] < low) {
+			left = middle + 1;
+		} else {
+			right = middle - 1;
+		}
+	}
+	return -1;
+}
+
+/// @brief １文字分のビットマップをキャッシュのスロットに読み込む。圧縮されている文字は復号する
+bool KanjiFontBlob::loadGlyph(uint32_t code, int32_t index, uint8_t *slot)
+{
+	if (code <= 0xFF) {
+		uint32_t bytes = (header.asciiWidth * header.asciiHeight + 7) / 8;
+		return read(context, header.asciiBitmaps + (code - 1) * bytes, slot, bytes);
+	}
+	uint32_t bytes = (header.width * header.height + 7) / 8;
+	if (header.model == 0) {
+		return read(context, header.bitmaps + index * bytes, slot, bytes);
+	}
+
+	// 圧縮されている文字。ブロックの先頭位置と、そこからこの文字までの長さを読んで位置を求める
+	uint32_t block = index / KANJI_CODEC_BLOCK;
+	uint32_t offset;
+	uint8_t lengths[KANJI_CODEC_BLOCK];
+	uint8_t n = index % KANJI_CODEC_BLOCK + 1;
+	if (!read(context, header.blocks + block * 4, &offset, 4) ||
+		!read(context, header.lengths + block * KANJI_CODEC_BLOCK, lengths, n)) {
+		return false;
+	}
+	for (uint8_t i = 0; i < n - 1; i++) {
+		offset += lengths[i];
+	}
+	uint8_t data[255];
+	if (!read(context, header.bitmaps + offset, data, lengths[n - 1])) {
+		return false;
+	}
+	KanjiGlyph glyph;
+	glyph.bitmap = data;
+	glyph.model = modelBuffer ? modelBuffer : memoryData + header.model;
+	glyph.length = lengths[n - 1];
+	glyph.width = header.width;
+	glyph.height = header.height;
+	KanjiRowReader reader;
+	reader.Begin(&glyph);
+	memset(slot, 0, bytes);
+	uint16_t bit = 0;
+	for (uint8_t y = 0; y < header.height; y++) {
+		uint32_t row = reader.NextRow();
+		for (int8_t x = header.width - 1; x >= 0; x--, bit++) {
+			if ((row >> x) & 1) slot[bit >> 3] |= 0x80 >> (bit & 7);
+		}
+	}
+	return true;
+}
+
+/// @brief １文字分のビットマップと大きさを取り出す。KanjiHelper::GetGlyphと同じ
+/// @details ビットマップはキャッシュの中を指すので、TFT_KANJI_CACHE_GLYPHS文字を取り出すまでの間だけ有効。
+/// 圧縮されたブロブでも、キャッシュには復号したものを置くので、取り出した文字は常に圧縮されていない。
+/// @param code 文字コード
+/// @param glyph 結果を格納する
+/// @return 文字がブロブにあればtrue
+bool KanjiFontBlob::GetGlyph(uint32_t code, KanjiGlyph *glyph)
+{
+	bool ascii = code <= 0xFF;
+	glyph->width = ascii ? header.asciiWidth : header.width;
+	glyph->height = ascii ? header.asciiHeight : header.height;
+	glyph->model = NULL;
+	glyph->length = 0;
+	if (code == 0 || read == NULL) {
+		return false;
+	}
+
+	useCounter++;
+	uint8_t victim = 0;
+	for (uint8_t i = 0; i < TFT_KANJI_CACHE_GLYPHS; i++) {
+		if (cacheTags[i].code == code) {
+			cacheHits++;
+			cacheTags[i].lastUse = useCounter;
+			glyph->bitmap = cacheData[i];
+			return true;
+		}
+		if (cacheTags[i].lastUse < cacheTags[victim].lastUse) {
+			victim = i;		// 最も長く使われていないスロット（空きはlastUseが0）
+		}
+	}
+
+	int32_t index = 0;
+	if (!ascii) {
+		index = FindKanji(code);
+		if (index < 0) return false;
+	}
+	cacheMisses++;
+	cacheTags[victim].code = 0;
+	if (!loadGlyph(code, index, cacheData[victim])) {
+		return false;
+	}
+	cacheTags[victim].code = code;
+	cacheTags[victim].lastUse = useCounter;
+	glyph->bitmap = cacheData[victim];
+	return true;
+}
+
+/// @brief ブロブ内の番号から、シフトJISコードを求める
+/// @return シフトJISコード。ブロブに表がないときは0
+uint16_t KanjiFontBlob::GetSjis(int32_t index)
+{
+	uint16_t sjis = 0;
+	if (index < 0 || header.sjis == 0 || !read(context, header.sjis + index * 2, &sjis, 2)) return 0;
+	return sjis;
+}
+
+/// @brief ブロブ内の番号から、JISコードを求める
+/// @return JISコード。ブロブに表がないときは0
+uint16_t KanjiFontBlob::GetJis(int32_t index)
+{
+	uint16_t jis = 0;
+	if (index < 0 || header.jis == 0 || !read(context, header.jis + index * 2, &jis, 2)) return 0;
+	return jis;
+}
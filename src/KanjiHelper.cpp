@@ -3,7 +3,9 @@
 #include <iconv.h>
 #include <stdlib.h>
 #include <string.h>
+#define TFT_KANJI_FONT_IMPL			// 漢字フォントのデータの実体はこのファイルに置く
 #include "../include/KanjiHelper.h"
+#include "../include/KanjiFontBlob.h"
 #pragma GCC diagnostic ignored "-Wunused-variable"
 /**
  * @file KanjiHelper.cpp
@@ -11,76 +13,424 @@
  * 処理を行う、KanjiHelperクラスを定義する。KanjiHelperクラスはすべてstaticメソッドで、インスタンス化することはできない。
  */
 
-/// @brief フォントテーブルからUTF-8を使って特定のフォントをバイナリサーチで探し出す際のサブ関数。<br/>
-/// フォントへのポインタを受け取り、大小を比較する。第一円数の方が
-/// @param a 比較するUTF-8コード
-/// @param b 比較するUTF-8コード
-/// @return a が b より大きければ1、小さければ-1、等しければ0を返す。
-int KanjiHelper::compareUnicode(const void *a, const void *b)
-{
-	uint32_t unicodeA = ((KanjiFont *)a)->Unicode;
-	uint32_t unicodeB = ((KanjiFont *)b)->Unicode;
-	return (unicodeA > unicodeB) - (unicodeA < unicodeB);
-}
-/// @brief フォントテーブルからUTF-8を使って特定のフォントをバイナリサーチで探し出す。<br/>
-/// 漢字テーブルにはUTF-8がソートされて格納されている。<br/>
-/// UTF-8は非連続、バイト長も１～４とバラバラなので、計算でピンポイントに見つけ出すのは難しい。そこで漢字テーブルからバイナリサーチで探し出す。
-/// 検索回数は、6000文字でも13回程度なので良しとする。
-/// @param array 検索対象の漢字テーブル
-/// @param size 検索対象の漢字テーブルの要素数
-/// @param unicode 検索するUTF-8コード
-/// @return 検索された漢字データのポインタ。見つからなかったときはNULL。
-const KanjiFont* KanjiHelper::binarySearchUnicode(const KanjiFont array[], size_t size, uint32_t unicode)
+/// @brief UTF-8のバイト列をそのまま並べた値を、Unicodeのコードポイントに変換する
+/// @param codeUTF UTF-8のバイト列をそのまま並べた値
+/// @return コードポイント
+uint32_t KanjiHelper::codePoint(uint32_t codeUTF)
 {
-	size_t left = 0;
-	size_t right = size - 1;
+	if (codeUTF <= 0x7F) return codeUTF;
+	if (codeUTF <= 0xFFFF) return ((codeUTF >> 8) & 0x1F) << 6 | (codeUTF & 0x3F);
+	if (codeUTF <= 0xFFFFFF) return ((codeUTF >> 16) & 0x0F) << 12 | ((codeUTF >> 8) & 0x3F) << 6 | (codeUTF & 0x3F);
+	return ((codeUTF >> 24) & 0x07) << 18 | ((codeUTF >> 16) & 0x3F) << 12 | ((codeUTF >> 8) & 0x3F) << 6 | (codeUTF & 0x3F);
+}
+
+#define TFT_KANJI_NAME_(name) #name
+#define TFT_KANJI_NAME(name) TFT_KANJI_NAME_(name)
 
+RegisteredKanjiFont registeredKanjiFonts[TFT_MAX_KANJI_FONTS] = {
+	{TFT_KANJI_NAME(TFT_KANJI_FONT), &TFT_KANJI_FONT},
+#ifdef TFT_KANJI_EXTRA_FONT1
+	{TFT_KANJI_NAME(TFT_KANJI_EXTRA_FONT1), &TFT_KANJI_EXTRA_FONT1},
+#endif
+#ifdef TFT_KANJI_EXTRA_FONT2
+	{TFT_KANJI_NAME(TFT_KANJI_EXTRA_FONT2), &TFT_KANJI_EXTRA_FONT2},
+#endif
+#ifdef TFT_KANJI_EXTRA_FONT3
+	{TFT_KANJI_NAME(TFT_KANJI_EXTRA_FONT3), &TFT_KANJI_EXTRA_FONT3},
+#endif
+};
+
+KanjiFontBlob *KanjiHelper::fontBlob = NULL;
+const KanjiFontTable *KanjiHelper::currentTable = &TFT_KANJI_FONT;
+
+/// @brief 使用するテーブルを切り替える
+/// @param table 使用するテーブル。NULLを指定すると既定のテーブルに戻る
+void KanjiHelper::SetFont(const KanjiFontTable *table)
+{
+	currentTable = table ? table : &TFT_KANJI_FONT;
+}
+
+/// @brief 使用するテーブルを、registeredKanjiFontsに登録された名前で切り替える
+/// @param name テーブル名（Kanji16Allなど）
+/// @return 見つかればtrue。見つからなければ、テーブルは変わらない
+bool KanjiHelper::SetFont(const char *name)
+{
+	for (int i = 0; i < TFT_MAX_KANJI_FONTS; i++) {
+		if (registeredKanjiFonts[i].name != NULL && strcmp(name, registeredKanjiFonts[i].name) == 0) {
+			SetFont(registeredKanjiFonts[i].table);
+			return true;
+		}
+	}
+	return false;
+}
+
+/// @brief 組み込みのテーブルの代わりに使うフォントブロブを指定する
+/// @param blob Beginしたフォントブロブ。NULLを指定すると組み込みのテーブルに戻る
+void KanjiHelper::SetFontBlob(KanjiFontBlob *blob)
+{
+	fontBlob = blob;
+}
+
+/// @brief 使用中のテーブルを返す
+/// @details フォントブロブを使っているときは、大きさと文字数だけが入ったもの（配列へのポインタはすべてNULL）を返す
+const KanjiFontTable &KanjiHelper::Table()
+{
+	return fontBlob ? fontBlob->Table() : *currentTable;
+}
+
+/// @brief フォントテーブルからUTF-8を使って特定の文字を探し出す。<br/>
+/// コードポイントの上位8ビットでbucketから範囲を求め、その中を下位8ビットだけでバイナリサーチする。
+/// 範囲は最大でも256文字なので、検索回数は8回以下になる。
+/// @param targetCodeUTF 検索対象のUTF-8コード
+/// @return　検索された文字のテーブル内の番号。見つからなかったときは-1。
+int32_t KanjiHelper::FindKanji(uint32_t targetCodeUTF)
+{
+	if (fontBlob) return fontBlob->FindKanji(targetCodeUTF);
+	const KanjiFontTable &table = *currentTable;
+	uint32_t cp = codePoint(targetCodeUTF);
+	if (cp > 0xFFFF) {
+		return -1;				// テーブルにはBMPの文字しかない
+	}
+	uint8_t low = cp & 0xFF;
+	int32_t left = table.bucket[cp >> 8];
+	int32_t right = table.bucket[(cp >> 8) + 1] - 1;
 	while (left <= right) {
-		size_t middle = left + (right - left) / 2;
-		if (array[middle].Unicode == unicode) {
-			return (KanjiFont *)&array[middle];
-		} else if (array[middle].Unicode < unicode) {
+		int32_t middle = left + (right - left) / 2;
+		if (table.codes[middle] == low) {
+			return middle;
+		} else if (table.codes[middle] < low) {
 			left = middle + 1;
 		} else {
 			right = middle - 1;
 		}
 	}
-	return NULL;
+	return -1;
 }
-/// @brief フォントテーブルからASCII文字を検索する。<br/>
-/// ASCII文字は、0x00を除く255が必ずあるので、検索ではなく計算でピンポイントで返す
-/// @param array 検索対象のASCIIテーブル
-/// @param asciicode 検索対象のASCIIコード
-/// @return 検索されたASCIIデータのポインタ
-const AsciiFont* KanjiHelper::SearchAscii(const AsciiFont array[],uint8_t asciicode)
+
+/// @brief フォントテーブルから１文字分のビットマップと大きさを取り出す。<br/>
+/// ASCII文字は、0x00を除く255が必ずあるので、検索ではなく計算でピンポイントで求める
+/// @param code 文字コード。0xFF以下は半角文字、それ以外はUTF-8のバイト列をそのまま並べた値
+/// @param glyph 結果を格納する。フォントにない文字のときも、width,heightには送り幅が入る
+/// @return 文字がフォントにあればtrue
+bool KanjiHelper::GetGlyph(uint32_t code, KanjiGlyph *glyph)
 {
-	return (AsciiFont *)&array[asciicode-1];
-	
+	if (fontBlob) return fontBlob->GetGlyph(code, glyph);
+	const KanjiFontTable &table = *currentTable;
+	if (code <= 0xFF) {  // １バイト文字
+		glyph->width = table.asciiWidth;
+		glyph->height = table.asciiHeight;
+		if (code == 0) {
+			return false;
+		}
+		return GetGlyphAt(table, KANJI_GLYPH_ASCII | code, glyph);
+	}
+	glyph->width = table.width;
+	glyph->height = table.height;
+	int32_t index = FindKanji(code);
+	if (index < 0) {
+		return false;
+	}
+	return GetGlyphAt(table, index, glyph);
 }
 
-/// @brief フォントテーブルからUTF-8を使って特定のフォントをバイナリサーチで探し出す。<br/>
-/// 漢字テーブルにはUTF-8がソートされてはいっている。
-/// UTF-8は非連続、バイト長も１～４とバラバラなので、計算でピンポイントに見つけ出すのは難しい。そこで漢字テーブルからバイナリサーチで探し出す。
-/// 検索回数は、6000文字でも13回程度なので良しとする。
-/// @param targetCodeUTF 検索対象のUTF-8コード
-/// @return　検索された漢字データのポインタ。見つからなかったときはNULL。
-const KanjiFont* KanjiHelper::FindKanji(uint32_t targetCodeUTF)
+/// @brief 検索済みの文字の番号から、１文字分のビットマップと大きさを取り出す。
+/// @details KanjiText.hでコンパイル時に求めた番号を描画するときに使う。フォントブロブは使わない。
+/// @param table 番号を求めたときのテーブル
+/// @param glyphIndex FindKanjiで求めた番号。半角文字は KANJI_GLYPH_ASCII | 文字コード
+/// @param glyph 結果を格納する
+/// @return 番号がテーブルの範囲内ならtrue
+bool KanjiHelper::GetGlyphAt(const KanjiFontTable &table, uint16_t glyphIndex, KanjiGlyph *glyph)
 {
-//	uint32_t targetCodeUTF = 0x0000C2A8;  // 探すUnicode値
-	size_t arraySize = sizeof(KFont) / sizeof(KFont[0]);
+	glyph->model = NULL;
+	glyph->length = 0;
+	if (glyphIndex & KANJI_GLYPH_ASCII) {
+		uint8_t code = glyphIndex & 0xFF;
+		glyph->width = table.asciiWidth;
+		glyph->height = table.asciiHeight;
+		if (code == 0) {
+			return false;
+		}
+		glyph->bitmap = table.asciiBitmaps + (code - 1) * ((table.asciiWidth * table.asciiHeight + 7) / 8);
+		return true;
+	}
+	glyph->width = table.width;
+	glyph->height = table.height;
+	if (glyphIndex >= table.count) {
+		return false;
+	}
+	if (table.model != NULL) {  // 圧縮されたテーブル。ブロックの先頭から、符号の長さを足して位置を求める
+		uint32_t offset = table.blocks[glyphIndex / KANJI_CODEC_BLOCK];
+		for (uint16_t i = glyphIndex - glyphIndex % KANJI_CODEC_BLOCK; i < glyphIndex; i++) {
+			offset += table.lengths[i];
+		}
+		glyph->bitmap = table.bitmaps + offset;
+		glyph->model = table.model;
+		glyph->length = table.lengths[glyphIndex];
+		return true;
+	}
+	glyph->bitmap = table.bitmaps + glyphIndex * ((table.width * table.height + 7) / 8);
+	return true;
+}
 
-	const KanjiFont *result = binarySearchUnicode(KFont, arraySize, targetCodeUTF);
-	return result;
+/// @brief 文字の読み出しを始める
+/// @param glyph GetGlyphで取り出した文字
+void KanjiRowReader::Begin(const KanjiGlyph *glyph)
+{
+	bitmap = glyph->bitmap;
+	model = glyph->model;
+	width = glyph->width;
+	bit = 0;
+	prev1 = prev2 = 0;
+	if (model != NULL) {
+		kanjiCodecBegin(&decoder, bitmap, glyph->length);
+	}
 }
-/// @brief フォントテーブルからASCII文字を検索する。<br/>
-/// ASCII文字は、0x00を除く255が必ずあるので、検索ではなく計算でピンポイントで返す
-/// @param targetCodeAscii 検索対象のASCIIコード
-/// @return 検索されたASCIIデータのポインタ
-const AsciiFont *KanjiHelper::FindAscii(uint8_t targetCodeAscii)
+
+/// @brief 次の行を取り出す
+/// @return 行のビット列。列xのドットはビット (width - 1 - x) にある
+uint32_t KanjiRowReader::NextRow()
 {
-	//	uint32_t targetCodeUTF = 0x0000C2A8;  // 探すUnicode値
-	size_t arraySize = sizeof(AFont) / sizeof(AFont[0]);
+	if (model == NULL) {
+		// 行は文字の途中から始まることがあるので、必要なバイトだけを読んでから切り出す
+		const uint8_t *p = bitmap + (bit >> 3);
+		uint8_t skip = bit & 7;
+		uint8_t bytes = (skip + width + 7) / 8;
+		uint32_t v = 0;
+		for (uint8_t i = 0; i < bytes; i++) {
+			v = (v << 8) | p[i];
+		}
+		bit += width;
+		return (v >> (bytes * 8 - skip - width)) & ((1u << width) - 1);
+	}
+	uint32_t cur = 0;
+	for (uint8_t x = 0; x < width; x++) {
+		if (kanjiCodecDecodeBit(&decoder, model[kanjiCodecContext(cur, prev1, prev2, x, width)] << 4)) {
+			cur |= 1u << (width + 3 - x);
+		}
+	}
+	prev2 = prev1;
+	prev1 = cur;
+	return cur >> 4;
+}
 
-	const AsciiFont *result = SearchAscii(AFont, targetCodeAscii);
-	return result;
+/// @brief テーブル内の番号から、シフトJISコードを求める
+/// @param index FindKanjiで求めた番号
+/// @return シフトJISコード。TFT_KANJI_SJIS_TABLEが未定義のときは0
+uint16_t KanjiHelper::GetSjis(int32_t index)
+{
+	if (fontBlob) return fontBlob->GetSjis(index);
+	const KanjiFontTable &table = *currentTable;
+	if (index < 0 || table.sjis == NULL) return 0;
+	return table.sjis[index];
+}
+
+/// @brief テーブル内の番号から、JISコードを求める
+/// @param index FindKanjiで求めた番号
+/// @return JISコード。TFT_KANJI_SJIS_TABLEが未定義のときは0
+uint16_t KanjiHelper::GetJis(int32_t index)
+{
+	if (fontBlob) return fontBlob->GetJis(index);
+	const KanjiFontTable &table = *currentTable;
+	if (index < 0 || table.jis == NULL) return 0;
+	return table.jis[index];
+}
+
+/// @brief 行頭に置いてはいけない文字（行頭禁則文字）。閉じ括弧、句読点、小書きのかななど。
+/// UTF-8のバイト列をそのまま並べた値で、昇順に並んでいる。0xA1～0xB0は、1バイトに変換された半角カナ。
+static const uint32_t NoBreakBeforeCodes[] = {
+	0x000021, 0x000029, 0x00002C, 0x00002E, 0x00003A, 0x00003B, 0x00003F, 0x00005D,
+	0x00007D, 0x0000A1, 0x0000A3, 0x0000A4, 0x0000A5, 0x0000A7, 0x0000A8, 0x0000A9,
+	0x0000AA, 0x0000AB, 0x0000AC, 0x0000AD, 0x0000AE, 0x0000AF, 0x0000B0, 0xE28090,
+	0xE28093, 0xE28099, 0xE2809D, 0xE38081, 0xE38082, 0xE38085, 0xE38089, 0xE3808B,
+	0xE3808D, 0xE3808F, 0xE38091, 0xE38095, 0xE38097, 0xE38099, 0xE3809C, 0xE3809F,
+	0xE380BB, 0xE38181, 0xE38183, 0xE38185, 0xE38187, 0xE38189, 0xE381A3, 0xE38283,
+	0xE38285, 0xE38287, 0xE3828E, 0xE38295, 0xE38296, 0xE3829D, 0xE3829E, 0xE382A0,
+	0xE382A1, 0xE382A3, 0xE382A5, 0xE382A7, 0xE382A9, 0xE38383, 0xE383A3, 0xE383A5,
+	0xE383A7, 0xE383AE, 0xE383B5, 0xE383B6, 0xE383BB, 0xE383BC, 0xE383BD, 0xE383BE,
+	0xEFBC81, 0xEFBC89, 0xEFBC8C, 0xEFBC8E, 0xEFBC9A, 0xEFBC9B, 0xEFBC9F, 0xEFBCBD,
+	0xEFBD9D, 0xEFBD9E, 0xEFBDA1, 0xEFBDA3, 0xEFBDA4, 0xEFBDA5, 0xEFBDA7, 0xEFBDA8,
+	0xEFBDA9, 0xEFBDAA, 0xEFBDAB, 0xEFBDAC, 0xEFBDAD, 0xEFBDAE, 0xEFBDAF, 0xEFBDB0
+};
+
+/// @brief 行末に置いてはいけない文字（行末禁則文字）。開き括弧など。
+static const uint32_t NoBreakAfterCodes[] = {
+	0x000028, 0x00005B, 0x00007B, 0x0000A2, 0xE28098, 0xE2809C, 0xE38088, 0xE3808A,
+	0xE3808C, 0xE3808E, 0xE38090, 0xE38094, 0xE38096, 0xE38098, 0xE3809D, 0xEFBC88,
+	0xEFBCBB, 0xEFBD9B, 0xEFBDA2
+};
+
+/// @brief 昇順に並んだコード表に、指定されたコードがあるかをバイナリサーチで調べる
+/// @param array コード表
+/// @param size コード表の要素数
+/// @param code 調べるコード
+/// @return コード表にあればtrue
+bool KanjiHelper::findCode(const uint32_t array[], size_t size, uint32_t code)
+{
+	size_t left = 0;
+	size_t right = size;
+	while (left < right) {
+		size_t middle = left + (right - left) / 2;
+		if (array[middle] == code) {
+			return true;
+		} else if (array[middle] < code) {
+			left = middle + 1;
+		} else {
+			right = middle;
+		}
+	}
+	return false;
+}
+
+/// @brief UTF-8の文字列から１文字分の文字コードを取り出す。
+/// @param text 文字の先頭
+/// @param code 文字コードを格納する。漢字テーブルと同じく、UTF-8のバイト列をそのまま並べた値になる。
+/// @param forceHankana trueのとき、半角カナを１バイトの文字コード（0xA1～0xDF）に変換する。
+/// @return 文字のバイト数。不正なUTF-8（途中で終わっている文字を含む）の場合は0
+uint8_t KanjiHelper::DecodeUTF8(const char *text, uint32_t *code, bool forceHankana)
+{
+	const uint8_t *t = (const uint8_t *)text;
+	uint8_t step = 0;
+	if ((t[0] & 0x80) == 0x00) {
+		step = 1;  			// 1バイト文字 (ASCII)
+	} else if ((t[0] & 0xE0) == 0xC0) {
+		step = 2;  // 2バイト文字
+	} else if ((t[0] & 0xF0) == 0xE0) {
+		step =  3;  // 3バイト文字
+	} else if ((t[0] & 0xF8) == 0xF0) {
+		step = 4;  // 4バイト文字
+	} else {
+		return 0;  // 不正なUTF-8バイト
+	}
+	uint32_t utf8codes = t[0];
+	for (uint8_t i = 1; i < step; i++) {
+		// 続きのバイト（0x80～0xBF）でなければ不正。途中で終わっている文字列は、ここでNULを見つけて止まるので、終端の先は読まない
+		if ((t[i] & 0xC0) != 0x80) return 0;
+		utf8codes = (utf8codes << 8) | t[i];
+	}
+	if (forceHankana) {					// 半角カナを1バイト文字として処理
+		uint16_t top2bytes = (uint16_t)(utf8codes >> 8);
+		if (top2bytes == 0xefbd)  {
+			utf8codes = utf8codes & 0x000000FF;
+		} else if (top2bytes == 0xefbe) {
+			utf8codes = (utf8codes & 0x000000FF) + 0x40;
+		}
+	}
+	*code = utf8codes;
+	return step;
+}
+
+/// @brief フォントテーブルから文字の大きさを求める。
+/// @param code 文字コード
+/// @param w 文字の幅を格納する。フォントにない文字のときは、テーブル先頭の文字の幅
+/// @param h 文字の高さを格納する。フォントにない文字のときは、テーブル先頭の文字の高さ
+/// @return 文字がフォントにあればtrue
+bool KanjiHelper::GetGlyphSize(uint32_t code, uint8_t *w, uint8_t *h)
+{
+	KanjiGlyph glyph;
+	bool found = GetGlyph(code, &glyph);
+	*w = glyph.width;
+	*h = glyph.height;
+	return found;
+}
+
+/// @brief 行頭禁則文字（その直前で改行してはいけない文字）かを調べる
+/// @param code 文字コード
+/// @return 行頭禁則文字ならtrue
+bool KanjiHelper::IsNoBreakBefore(uint32_t code)
+{
+	return findCode(NoBreakBeforeCodes, sizeof(NoBreakBeforeCodes) / sizeof(NoBreakBeforeCodes[0]), code);
+}
+
+/// @brief 行末禁則文字（その直後で改行してはいけない文字）かを調べる
+/// @param code 文字コード
+/// @return 行末禁則文字ならtrue
+bool KanjiHelper::IsNoBreakAfter(uint32_t code)
+{
+	return findCode(NoBreakAfterCodes, sizeof(NoBreakAfterCodes) / sizeof(NoBreakAfterCodes[0]), code);
+}
+
+/// @brief ２つの文字の間で改行できるかを調べる。
+/// @details 禁則文字の前後と、半角英数字が続いている単語の途中、空白の直前では改行しない。
+/// @param prev 前の文字
+/// @param next 後の文字
+/// @return 改行できるときはtrue
+bool KanjiHelper::canBreakBetween(uint32_t prev, uint32_t next)
+{
+	if (next == ' ') return false;				// 空白は行末にぶら下げる
+	if (prev == ' ') return true;
+	if (prev < 0x80 && next < 0x80) return false;	// 半角英数字の単語の途中
+	if (IsNoBreakAfter(prev)) return false;
+	if (IsNoBreakBefore(next)) return false;
+	return true;
+}
+
+/// @brief 漢字文字列を、禁則処理を行いながら行に分割する。
+/// @details 行頭禁則文字の前と行末禁則文字の後、半角英数字の単語の途中では改行しない。
+/// 改行できる位置が行の中にない場合は、はみ出す文字の前で改行する。'\n'では必ず改行する。<br/>
+/// 結果の行情報は何度でも使えるので、長い文章をページ送りやスクロールで表示する場合も、表示する行だけを描画すればよい。<br/>
+/// 行情報がmaxLinesで一杯になったときは、そこで処理を終える。続きは最後の行のnextの位置から、startX=0で呼び出せば求められる。
+/// @param text 文字列
+/// @param startX 最初の行の開始X座標。２行目以降は0から始まる。
+/// @param wrapWidth 折り返す幅。0のときは'\n'以外では改行しない。
+/// @param size 文字のサイズ
+/// @param forceHankana trueのとき、半角カナを１バイトの文字として扱う
+/// @param lines 行情報を格納する配列
+/// @param maxLines linesの要素数
+/// @return 格納した行数
+uint16_t KanjiHelper::LayoutLines(const char *text, uint16_t startX, uint16_t wrapWidth, uint8_t size, bool forceHankana, KanjiLine *lines, uint16_t maxLines)
+{
+	uint16_t count = 0;
+	uint16_t pos = 0;
+	uint16_t x = startX;
+	if (size < 1) size = 1;
+
+	while (count < maxLines) {
+		uint16_t lineStart = pos;
+		uint16_t breakPos = 0;			// 最後に見つかった改行できる位置（0はなし）
+		uint16_t breakX = 0;
+		uint32_t prev = 0;
+		uint16_t next = 0;				// 次の行の開始位置
+		bool hasNext = false;
+		for (;;) {
+			uint32_t code;
+			uint8_t step = (text[pos] == 0) ? 0 : DecodeUTF8(&text[pos], &code, forceHankana);
+			if (step == 0) {			// 文字列の終わり（不正なUTF-8も終わりとする）
+				break;
+			}
+			if (code == '\n') {
+				next = pos + 1;
+				hasNext = true;
+				break;
+			}
+			uint8_t w, h;
+			GetGlyphSize(code, &w, &h);
+			if (pos > lineStart && canBreakBetween(prev, code)) {
+				breakPos = pos;
+				breakX = x;
+			}
+			if (wrapWidth > 0 && code != ' ' && x > 0 && (x + w * size) > wrapWidth) {
+				if (breakPos > lineStart) {		// 禁則を守れる位置で改行する
+					pos = breakPos;
+					x = breakX;
+				}
+				next = pos;
+				hasNext = true;
+				break;
+			}
+			x += w * size;
+			prev = code;
+			pos += step;
+		}
+		lines[count].start = lineStart;
+		lines[count].length = pos - lineStart;
+		lines[count].width = x;
+		lines[count].next = hasNext ? next : pos;
+		count++;
+		if (!hasNext) {
+			break;
+		}
+		pos = next;
+		x = 0;
+	}
+	return count;
 }
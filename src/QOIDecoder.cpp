@@ -0,0 +1,136 @@
+#include <stdint.h>
+#include <string.h>
+#include "../include/QOIDecoder.h"
+#include "../include/ColorConvert.h"
+
+/**
+ * @file QOIDecoder.cpp
+ * @brief QOI形式の画像を展開して表示する、QOIDecoderクラスを定義する。
+ * @details 形式は https://qoiformat.org/qoi-specification.pdf による。
+ */
+
+#define QOI_OP_INDEX 0x00	// 00xxxxxx 直前の色の表の番号
+#define QOI_OP_DIFF 0x40	// 01xxxxxx RGBそれぞれの差（-2～1）
+#define QOI_OP_LUMA 0x80	// 10xxxxxx Gの差と、R-G、B-Gの差
+#define QOI_OP_RUN 0xC0		// 11xxxxxx 同じ色の繰り返し
+#define QOI_OP_RGB 0xFE
+#define QOI_OP_RGBA 0xFF
+#define QOI_MASK 0xC0
+
+/// @brief ヘッダを読み、画像の大きさを求める
+/// @param in 画像データ。ヘッダの次まで読み進める
+/// @param info 画像の情報
+/// @return QOI形式でなければfalse
+bool QOIDecoder::ReadHeader(ImageStream &in, QOIInfo *info)
+{
+	uint8_t magic[4];
+	if (!in.Read(magic, 4) || memcmp(magic, "qoif", 4) != 0) return false;
+	info->width = in.ReadBE32();
+	info->height = in.ReadBE32();
+	info->channels = in.ReadByte();
+	in.ReadByte();  // colorspace。表示には使わない
+	return !in.Failed() && (info->channels == 3 || info->channels == 4) && info->width > 0 && info->height > 0;
+}
+
+/// @brief QOI形式の画像を、展開しながら表示する
+/// @details 画面からはみ出す部分は切り取る。画面の下端より下の行は展開しない。
+/// @param tft 表示先
+/// @param x 表示する左上の座標。画面の外（負の値）でもよい
+/// @param y 表示する左上の座標。画面の外（負の値）でもよい
+/// @param in 画像データ
+/// @return QOI形式でないか、データが途中で終わっていればfalse
+bool QOIDecoder::Draw(ST7735 *tft, int16_t x, int16_t y, ImageStream &in)
+{
+	QOIInfo info;
+	if (!ReadHeader(in, &info)) return false;
+
+	// 画面の範囲に切り取る
+	int32_t x0 = (x < 0) ? 0 : x;
+	int32_t y0 = (y < 0) ? 0 : y;
+	int32_t x1 = x + (int32_t)info.width;
+	int32_t y1 = y + (int32_t)info.height;
+	if (x1 > tft->st7735Init.width) x1 = tft->st7735Init.width;
+	if (y1 > tft->st7735Init.height) y1 = tft->st7735Init.height;
+	if (x1 > x0 + TFT_LINE_BUFFER_PIXELS) x1 = x0 + TFT_LINE_BUFFER_PIXELS;
+	if (x0 >= x1 || y0 >= y1) return true;
+	uint32_t c0 = x0 - x, c1 = x1 - x;  // 見えている列の範囲（画像の中での位置）
+	bool alpha = info.channels == 4;
+
+	uint8_t index[64][4];  // 直前の色の表（R,G,B,A）
+	memset(index, 0, sizeof(index));
+	uint8_t r = 0, g = 0, b = 0, a = 255;
+	uint8_t run = 0;
+	uint16_t line[(TFT_LINE_BUFFER_PIXELS * 3 + 1) / 2];  // 1行分のRGB888。ColorConvertでその場でRGB565にする
+	uint8_t *rgb = (uint8_t *)line;
+	uint8_t opaque[TFT_LINE_BUFFER_PIXELS];  // RGBAのとき、画素が透過しなければ1
+
+	if (!alpha) tft->setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	for (int32_t row = y; row < y1; row++) {
+		for (uint32_t col = 0; col < info.width; col++) {
+			if (run > 0) {
+				run--;
+			} else {
+				uint8_t b1 = in.ReadByte();
+				if (b1 == QOI_OP_RGB) {
+					r = in.ReadByte();
+					g = in.ReadByte();
+					b = in.ReadByte();
+				} else if (b1 == QOI_OP_RGBA) {
+					r = in.ReadByte();
+					g = in.ReadByte();
+					b = in.ReadByte();
+					a = in.ReadByte();
+				} else if ((b1 & QOI_MASK) == QOI_OP_INDEX) {
+					r = index[b1][0];
+					g = index[b1][1];
+					b = index[b1][2];
+					a = index[b1][3];
+				} else if ((b1 & QOI_MASK) == QOI_OP_DIFF) {
+					r += ((b1 >> 4) & 0x03) - 2;
+					g += ((b1 >> 2) & 0x03) - 2;
+					b += (b1 & 0x03) - 2;
+				} else if ((b1 & QOI_MASK) == QOI_OP_LUMA) {
+					uint8_t b2 = in.ReadByte();
+					int8_t vg = (b1 & 0x3F) - 32;
+					r += vg - 8 + ((b2 >> 4) & 0x0F);
+					g += vg;
+					b += vg - 8 + (b2 & 0x0F);
+				} else {
+					run = b1 & 0x3F;  // この画素の後に、同じ色がrun個続く
+				}
+				uint8_t *slot = index[(r * 3 + g * 5 + b * 7 + a * 11) & 63];
+				slot[0] = r;
+				slot[1] = g;
+				slot[2] = b;
+				slot[3] = a;
+			}
+			if (row >= y0 && col >= c0 && col < c1) {
+				uint8_t *p = &rgb[(col - c0) * 3];
+				p[0] = r;
+				p[1] = g;
+				p[2] = b;
+				opaque[col - c0] = a >= 128;
+			}
+		}
+		if (in.Failed()) return false;
+		if (row < y0) continue;
+
+		int16_t n = x1 - x0;
+		ColorConvert::FromRGB888(line, rgb, n, TFT_COLOR_PANEL_ORDER);
+		if (!alpha) {
+			tft->writeDataBlock(rgb, n * 2);
+			continue;
+		}
+		// 透過しない画素のランごとに描画
+		int16_t i = 0;
+		while (i < n) {
+			while (i < n && !opaque[i]) i++;
+			if (i >= n) break;
+			int16_t runStart = i;
+			while (i < n && opaque[i]) i++;
+			tft->setAddrWindow(x0 + runStart, row, x0 + i - 1, row);
+			tft->writeDataBlock(rgb + runStart * 2, (i - runStart) * 2);
+		}
+	}
+	return true;
+}
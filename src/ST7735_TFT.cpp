@@ -32,6 +32,9 @@
 #if defined(TFT_ENABLE_TEXT) && !defined(TFT_ENABLE_FONTS)
 #include "../include/TextFonts.h"
 #endif
+#if defined(TFT_ENABLE_TEXT) && defined(TFT_ENABLE_FONTS)
+#include "../include/GlyphRaster.h"
+#endif
 #include <bits/move.h>
 
 #pragma region コンストラクタ
@@ -55,31 +58,9 @@ void ST7735::SetSPIHW(HW *a_spiHW)
 {
 	pSpiHW = a_spiHW;
 }
-#ifdef TFT_ENABLE_FONTS
-	#include "../include/font/Font_Mono9p.h"
-	#include "../include/font/Font_Mono18p.h"
-	#include "../include/font/FreeMonoOblique12pt7b.h"
-	#include "../include/font/FreeMonoOblique12pt_sub.h"
-#endif
-
 void ST7735::doInit()
 {
-	// フォントの初期化
-#ifdef TFT_ENABLE_FONTS
-		for (int i = 0; i < 16; i++) {
-			registeredFonts[i].name = NULL;
-			registeredFonts[i].font = NULL;
-		}
-		registeredFonts[0].font = &FreeMono9pt7b;
-		registeredFonts[0].name = "FreeMono9pt7b";
-		registeredFonts[1].font = &FreeMono18pt7b;
-		registeredFonts[1].name = "FreeMono18pt7b";
-		registeredFonts[2].font = &FreeMonoOblique12pt_sub;
-		registeredFonts[2].name = "FreeMonoOblique12pt_sub";
-		registeredFonts[3].font = &FreeMonoOblique12pt7b;
-		registeredFonts[3].name = "FreeMonoOblique12pt7b";
-#endif
-
+	// フォントの一覧(registeredFonts)は、ST7735_fonts.cppで初期化済み
 	pSpiHW->init();
 	st7735Init.SetSPIHW(pSpiHW);
 #ifdef TFT_ENABLE_BLACK
@@ -106,6 +87,11 @@ void ST7735::writeData(uint8_t data_)
 {
 	pSpiHW->writeData(data_);
 }
+
+void ST7735::writeDataBlock(const uint8_t *data_, size_t len)
+{
+	pSpiHW->writeDataBlock(data_, len);
+}
 #pragma endregion
 
 #pragma region 設定メソッド
@@ -223,6 +209,49 @@ void ST7735::NormalDisplay()
 {
 	writeCommand(ST7735Cmd.NORON);
 }
+
+void ST7735::drawPanelPixels(int16_t x, int16_t y, const uint8_t *data, uint16_t stride, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h)
+{
+	int16_t x0 = (x < 0) ? 0 : x;
+	int16_t y0 = (y < 0) ? 0 : y;
+	int16_t x1 = x + w;
+	int16_t y1 = y + h;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y1 > st7735Init.height) y1 = st7735Init.height;
+	if ((x0 >= x1) || (y0 >= y1)) return;
+	uint32_t rowBytes = (uint32_t)stride * 2;
+	const uint8_t *row = data + (uint32_t)(sy + (y0 - y)) * rowBytes + (sx + (x0 - x)) * 2;
+
+	if (!isTransparentColor) {
+		setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+		if (x1 - x0 == stride) {
+			writeDataBlock(row, (uint32_t)(y1 - y0) * rowBytes);  // 画像の全幅を描画するなら、全体を１回で送る
+		} else {
+			for (int16_t yy = y0; yy < y1; yy++, row += rowBytes) {
+				writeDataBlock(row, (x1 - x0) * 2);
+			}
+		}
+		return;
+	}
+	// 透過色以外の画素のランごとに描画
+	for (int16_t yy = y0; yy < y1; yy++, row += rowBytes) {
+		drawOpaqueRuns(x0, yy, row, x1 - x0);
+	}
+}
+
+void ST7735::drawOpaqueRuns(int16_t x, int16_t y, const uint8_t *row, int16_t n)
+{
+	uint8_t th = bmpTransparentColor >> 8, tl = bmpTransparentColor & 0xFF;
+	int16_t i = 0;
+	while (i < n) {
+		while (i < n && row[i * 2] == th && row[i * 2 + 1] == tl) i++;
+		if (i >= n) break;
+		int16_t runStart = i;
+		while (i < n && !(row[i * 2] == th && row[i * 2 + 1] == tl)) i++;
+		setAddrWindow(x + runStart, y, x + i - 1, y);
+		writeDataBlock(row + runStart * 2, (i - runStart) * 2);
+	}
+}
 #pragma endregion
 
 
@@ -548,6 +577,170 @@ void ST7735::setTextWrap(bool w)
 	bTextWrap = w;
 }
 
+/// @brief drawMonoBitmapの、ビットマップの行の位置
+struct MonoBitmapRows {
+	const uint8_t *bitmap;
+	uint32_t bit;		///< 次の行の左端の点のビット位置
+	uint16_t rowBits;
+};
+
+static const uint8_t *nextMonoBitmapRow(void *context, uint32_t *bit)
+{
+	MonoBitmapRows *rows = (MonoBitmapRows *)context;
+	*bit = rows->bit;
+	rows->bit += rows->rowBits;
+	return rows->bitmap;
+}
+
+void ST7735::drawMonoRows(int16_t x, int16_t y, uint16_t w, uint16_t h, MonoRowFunc nextRow, void *context, uint16_t color, uint16_t bg, uint8_t size, bool transparent)
+{
+	if (size < 1) size = 1;
+	// 画面からはみ出す部分を切り取る（座標は拡大後の画面上の座標）
+	int16_t x0 = (x < 0) ? 0 : x;
+	int16_t y0 = (y < 0) ? 0 : y;
+	int16_t x1 = x + w * size;
+	int16_t y1 = y + h * size;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y1 > st7735Init.height) y1 = st7735Init.height;
+	if ((x0 >= x1) || (y0 >= y1)) return;
+
+	uint8_t fh = color >> 8, fl = color & 0xFF;
+	uint8_t bh = bg >> 8, bl = bg & 0xFF;
+	uint8_t line[LINE_BUFFER_PIXELS * 2];  // 1ライン分の画素（送信順に上位、下位）
+	// 見えている範囲の、元のビットマップ上の列。左端の点は、拡大した１ドットのうちskip個が切り取られている
+	int16_t sx0 = (x0 - x) / size, sx1 = (x1 - x + size - 1) / size;
+	uint8_t skip = (x0 - x) % size;
+	if (transparent) {
+		// ランの中身はすべて前景色なので、バッファは最初に一度だけ埋めておけばよい
+		for (int16_t i = 0; i < x1 - x0; i++) {
+			line[i * 2] = fh;
+			line[i * 2 + 1] = fl;
+		}
+	} else {
+		setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	}
+
+	for (int16_t sy = 0; sy < h; sy++) {
+		uint32_t rowBit;
+		const uint8_t *bits = nextRow(context, &rowBit);
+		// この行を拡大した帯の、画面上の上端と下端
+		int16_t bandTop = y + sy * size, bandBottom = bandTop + size;
+		if (bandBottom <= y0) continue;
+		if (bandTop >= y1) break;
+		if (bandTop < y0) bandTop = y0;
+		if (bandBottom > y1) bandBottom = y1;
+
+		if (transparent) {
+			int16_t sx = sx0;
+			while (sx < sx1) {
+				// ランの始まりを探す
+				while (sx < sx1 && !(bits[(rowBit + sx) >> 3] & (0x80 >> ((rowBit + sx) & 7)))) sx++;
+				if (sx >= sx1) break;
+				int16_t runStart = sx;
+				// ランの終わりを探す
+				while (sx < sx1 && (bits[(rowBit + sx) >> 3] & (0x80 >> ((rowBit + sx) & 7)))) sx++;
+				int16_t left = x + runStart * size, right = x + sx * size;
+				if (left < x0) left = x0;
+				if (right > x1) right = x1;
+				setAddrWindow(left, bandTop, right - 1, bandBottom - 1);
+				for (int16_t yy = bandTop; yy < bandBottom; yy++) {
+					writeDataBlock(line, (right - left) * 2);
+				}
+			}
+			continue;
+		}
+
+		// 元の点を順にたどり、１点をsize個の画素に展開する
+		uint32_t bit = rowBit + sx0;
+		uint8_t rep = skip;
+		uint8_t *p = line;
+		for (int16_t xx = x0; xx < x1; xx++) {
+			if (bits[bit >> 3] & (0x80 >> (bit & 7))) {
+				*p++ = fh;
+				*p++ = fl;
+			} else {
+				*p++ = bh;
+				*p++ = bl;
+			}
+			if (++rep == size) {
+				rep = 0;
+				bit++;
+			}
+		}
+		for (int16_t yy = bandTop; yy < bandBottom; yy++) {
+			writeDataBlock(line, (x1 - x0) * 2);
+		}
+	}
+}
+
+void ST7735::drawMonoBitmap(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint8_t *bitmap, uint32_t bitOffset, uint16_t rowBits, uint16_t color, uint16_t bg, uint8_t size)
+{
+	MonoBitmapRows rows = {bitmap, bitOffset, rowBits};
+	drawMonoRows(x, y, w, h, nextMonoBitmapRow, &rows, color, bg, size, false);
+}
+
+void ST7735::drawMonoBitmapRuns(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint8_t *bitmap, uint32_t bitOffset, uint16_t rowBits, uint16_t color, uint8_t size)
+{
+	MonoBitmapRows rows = {bitmap, bitOffset, rowBits};
+	drawMonoRows(x, y, w, h, nextMonoBitmapRow, &rows, color, 0, size, true);
+}
+
+void ST7735::drawLabel(int16_t x, int16_t y, const TFTLabel *label, uint16_t color, uint16_t bg)
+{
+	y += label->top;
+	if (label->format == TFT_LABEL_MONO) {
+		if (isTransparentColor && bg == bmpTransparentColor) {
+			drawMonoBitmapRuns(x, y, label->width, label->height, label->data, 0, label->width, color, 1);
+		} else {
+			drawMonoBitmap(x, y, label->width, label->height, label->data, 0, label->width, color, bg, 1);
+		}
+		return;
+	}
+
+	// TFT_LABEL_RGB565。送信順に並んでいるので、そのまま送る
+	drawPanelPixels(x, y, label->data, label->width, 0, 0, label->width, label->height);
+}
+
+bool ST7735::findMetricsCache(const char *text, const void *font, uint16_t wrapWidth, uint8_t size, TextMetrics *metrics, uint32_t *hash)
+{
+	// FNV-1a で文字列のハッシュ値を求める
+	uint32_t h = 2166136261u;
+	uint16_t len = 0;
+	for (const char *p = text; *p; p++, len++) {
+		h = (h ^ (uint8_t)*p) * 16777619u;
+	}
+	*hash = h;
+	for (uint8_t i = 0; i < METRICS_CACHE_SIZE; i++) {
+		if (metricsCache[i].font == font && metricsCache[i].hash == h && metricsCache[i].length == len &&
+			metricsCache[i].wrapWidth == wrapWidth && metricsCache[i].size == size) {
+			*metrics = metricsCache[i].metrics;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ST7735::storeMetricsCache(const char *text, uint32_t hash, const void *font, uint16_t wrapWidth, uint8_t size, const TextMetrics *metrics)
+{
+	metricsCache[metricsCacheNext].hash = hash;
+	metricsCache[metricsCacheNext].length = strlen(text);
+	metricsCache[metricsCacheNext].font = font;
+	metricsCache[metricsCacheNext].wrapWidth = wrapWidth;
+	metricsCache[metricsCacheNext].size = size;
+	metricsCache[metricsCacheNext].metrics = *metrics;
+	metricsCacheNext = (metricsCacheNext + 1) % METRICS_CACHE_SIZE;
+}
+
+void ST7735::addMetricsLine(TextMetrics *metrics, uint16_t start, uint16_t width)
+{
+	if (metrics->lineCount < TFT_TEXT_MAX_LINES) {
+		metrics->lineStart[metrics->lineCount] = start;
+		metrics->lineWidth[metrics->lineCount] = width;
+	}
+	metrics->lineCount++;
+	if (width > metrics->width) metrics->width = width;
+}
+
 #if !defined TFT_ENABLE_FONTS		// フォント変更ができない、基本的な文字出力の場合
 
 /// @brief 	1文字を描画する
@@ -557,7 +750,7 @@ void ST7735::setTextWrap(bool w)
 /// @param color 	文字の色
 /// @param bg 		背景色
 /// @param size 	文字のサイズ。1がデフォルト。2で2倍の大きさになる。
-void ST7735::drawChar(uint8_t x, uint8_t y, uint8_t c, uint16_t color, uint16_t bg, uint8_t size)
+void ST7735::drawChar(uint16_t x, uint16_t y, uint8_t c, uint16_t color, uint16_t bg, uint8_t size)
 {
 	int8_t i, j;
 	if ((x >= st7735Init.width) || (y >= st7735Init.height))
@@ -565,23 +758,22 @@ void ST7735::drawChar(uint8_t x, uint8_t y, uint8_t c, uint16_t color, uint16_t
 	if (size < 1) size = 1;
 	if ((c < ' ') || (c > '~'))
 		c = '?';
+	// フォントデータは列ごとに並んでいるので、行ごと（1行1バイト、MSBから左詰め）に並べ替える
+	uint8_t rows[7] = {0};
 	for (i = 0; i < 5; i++) {
 		uint8_t line;
 		line = Font[(c - ASCII_OFFSET) * 5 + i];
 		for (j = 0; j < 7; j++, line >>= 1) {
 			if (line & 0x01) {
-				if (size == 1)
-					drawPixel(x + i, y + j, color);
-				else
-					fillRectWH(x + (i * size), y + (j * size), size, size, color);
-			} else if (bg != color) {
-				if (size == 1)
-					drawPixel(x + i, y + j, bg);
-				else
-					fillRectWH(x + i * size, y + j * size, size, size, bg);
+				rows[j] |= 0x80 >> i;
 			}
 		}
 	}
+	if (bg == color || (isTransparentColor && bg == bmpTransparentColor)) {
+		drawMonoBitmapRuns(x, y, 5, 7, rows, 0, 8, color, size);
+	} else {
+		drawMonoBitmap(x, y, 5, 7, rows, 0, 8, color, bg, size);
+	}
 }
 
 /// @brief 		文字列を描画する
@@ -591,9 +783,9 @@ void ST7735::drawChar(uint8_t x, uint8_t y, uint8_t c, uint16_t color, uint16_t
 /// @param color 	文字の色
 /// @param bg 		背景色
 /// @param size 	文字のサイズ。1がデフォルト。2で2倍の大きさになる。
-void ST7735::drawText(uint8_t x, uint8_t y, const char *_text, uint16_t color, uint16_t bg, uint8_t size)
+void ST7735::drawText(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg, uint8_t size)
 {
-	uint8_t cursor_x, cursor_y;
+	uint16_t cursor_x, cursor_y;
 	uint16_t textsize, i;
 	cursor_x = x, cursor_y = y;
 	textsize = strlen(_text);
@@ -615,17 +807,20 @@ void ST7735::drawText(uint8_t x, uint8_t y, const char *_text, uint16_t color, u
 }
 #else
 GFXfont *_gfxFont;
+int8_t _gfxAscent;		// ベースラインから、フォント中で一番高い文字の上端までの距離（負の値）
+
 void ST7735::setFont(const GFXfont *f)
 {
 	_gfxFont = (GFXfont *)f;
+	_gfxAscent = GlyphRaster::FontAscent(f);
 }
 
 void ST7735::setFont(const char *name)
 {
-	for (int i = 0; i < 16; i++) {
+	for (int i = 0; i < TFT_MAX_FONTS; i++) {
 		if (registeredFonts[i].name != NULL) {
 			if (strcmp(name, registeredFonts[i].name) == 0) {
-				_gfxFont = (GFXfont *)registeredFonts[i].font;
+				setFont(registeredFonts[i].font);
 				return;
 			}
 		}
@@ -635,7 +830,7 @@ bool ST7735::getFonts(char *buf, uint16_t len)
 {
 	buf[0] = 0;
 	int curLen = 0;
-	for (int i = 0; i < 16; i++) {
+	for (int i = 0; i < TFT_MAX_FONTS; i++) {
 		if (registeredFonts[i].name != NULL) {
 			if (curLen+strlen(registeredFonts[i].name) + 1 > len) {
 				return false;
@@ -649,35 +844,78 @@ bool ST7735::getFonts(char *buf, uint16_t len)
 	return true;
 }
 
-void ST7735::drawText(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg, uint8_t size)
+const char *ST7735::findTextLineEnd(const char *text, int16_t startX, int16_t wrapRight, uint8_t size, int16_t *endX)
 {
-	uint8_t cursor_x, cursor_y, first_char, last_char;
-	uint16_t textlen, i;
-
-	cursor_x = x, cursor_y = y;
-	first_char = _gfxFont->first;
-	last_char = _gfxFont->last;
-	textlen = strlen(_text);
+	uint8_t first_char = _gfxFont->first;
+	uint8_t last_char = _gfxFont->last;
+	int16_t cursor_x = startX;
+	const char *p = text;
 
-	for (i = 0; i < textlen; i++) {
-		uint8_t c = _text[i];
+	for (; *p; p++) {
+		uint8_t c = *p;
 		if (c < first_char || c > last_char) {
 			continue;
 		}
-
 		GFXglyph *glyph = &(_gfxFont->glyph[c - first_char]);
-		uint8_t w = glyph->width, h = glyph->height;
-
-		if ((w > 0) && (h > 0)) {  // bitmap available
-			int16_t xo = glyph->xOffset;
-			if (bTextWrap && ((cursor_x + size * (xo + w)) > st7735Init.width)) {
-				cursor_x = 0;
-				cursor_y += (int16_t)size * _gfxFont->yAdvance;
+		if ((glyph->width > 0) && (glyph->height > 0)) {  // 画像のある文字だけが折り返しの対象になる
+			if ((cursor_x > 0) && ((cursor_x + size * (glyph->xOffset + glyph->width)) > wrapRight)) {
+				break;
 			}
-			drawChar(cursor_x, cursor_y, c, color, bg, size);
 		}
 		cursor_x += glyph->xAdvance * (int16_t)size;
 	}
+	*endX = cursor_x;
+	return p;
+}
+
+void ST7735::drawText(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg, uint8_t size)
+{
+	int16_t cursor_x, cursor_y, end_x;
+	uint8_t first_char, last_char;
+	const char *p = _text;
+
+	cursor_x = x, cursor_y = y;
+	first_char = _gfxFont->first;
+	last_char = _gfxFont->last;
+
+	while (*p) {
+		const char *lineEnd = bTextWrap ? findTextLineEnd(p, cursor_x, st7735Init.width, size, &end_x) : p + strlen(p);
+		for (; p < lineEnd; p++) {
+			uint8_t c = *p;
+			if (c < first_char || c > last_char) {
+				continue;
+			}
+			GFXglyph *glyph = &(_gfxFont->glyph[c - first_char]);
+			if ((glyph->width > 0) && (glyph->height > 0)) {  // bitmap available
+				drawChar(cursor_x, cursor_y, c, color, bg, size);
+			}
+			cursor_x += glyph->xAdvance * (int16_t)size;
+		}
+		if (*p) {  // 折り返し
+			cursor_x = 0;
+			cursor_y += (int16_t)size * _gfxFont->yAdvance;
+		}
+	}
+}
+
+void ST7735::measureText(const char *_text, uint16_t wrapWidth, uint8_t size, TextMetrics *metrics)
+{
+	uint32_t hash;
+	if (size < 1) size = 1;
+	if (findMetricsCache(_text, _gfxFont, wrapWidth, size, metrics, &hash)) {
+		return;
+	}
+	memset(metrics, 0, sizeof(TextMetrics));
+	const char *p = _text;
+	do {
+		int16_t end_x;
+		const char *lineEnd = (wrapWidth > 0) ? findTextLineEnd(p, 0, wrapWidth, size, &end_x) : findTextLineEnd(p, 0, INT16_MAX, size, &end_x);
+		addMetricsLine(metrics, p - _text, end_x);
+		p = lineEnd;
+	} while (*p);
+	metrics->height = metrics->lineCount * _gfxFont->yAdvance * size;
+	metrics->top = _gfxAscent * size;
+	storeMetricsCache(_text, hash, _gfxFont, wrapWidth, size, metrics);
 }
 
 void ST7735::drawChar(uint16_t x, uint16_t y, uint8_t c, uint16_t color, uint16_t bg, uint8_t size)
@@ -689,83 +927,131 @@ void ST7735::drawChar(uint16_t x, uint16_t y, uint8_t c, uint16_t color, uint16_
 	uint16_t bo = glyph->bitmapOffset;
 	uint8_t w = glyph->width, h = glyph->height;
 	int8_t xo = glyph->xOffset, yo = glyph->yOffset;
-	uint8_t xx, yy, bits = 0, abit = 0;
-	int16_t xo16 = 0, yo16 = 0;
+	if (size < 1) size = 1;
 
-	if (size > 1) {
-		xo16 = xo;
-		yo16 = yo;
+	// 拡大時はオフセットも拡大する。背景が不透明なら文字の画像の範囲を１つのアドレスウインドウにまとめて送り、
+	// 透過なら前景のランごとに送る
+	int16_t left = (int16_t)x + xo * size;
+	int16_t top = (int16_t)y + yo * size;
+	if (isTransparentColor && bg == bmpTransparentColor) {
+		drawMonoBitmapRuns(left, top, w, h, bitmap, (uint32_t)bo * 8, w, color, size);
+	} else {
+		drawMonoBitmap(left, top, w, h, bitmap, (uint32_t)bo * 8, w, color, bg, size);
 	}
+}
 
-	for (yy = 0; yy < h; yy++) {
-		for (xx = 0; xx < w; xx++) {
-			if (!(abit++ & 7)) {
-				bits = bitmap[bo++];
-			}
-			if (bits & 0x80) {
-				if (size == 1) {
-					drawPixel(x + xo + xx, y + yo + yy, color);
-				} else {
-					fillRect(x + (xo16 + xx) * size, y + (yo16 + yy) * size, size, size, color);
-				}
-			} else {
-				if (isTransparentColor && bg == bmpTransparentColor) {
-					// 何もしない
+void ST7735::drawCharCell(uint16_t x, uint16_t y, uint8_t c, uint16_t color, uint16_t bg)
+{
+	char text[2] = {(char)c, 0};
+	drawTextLine(x, y, text, color, bg);
+}
+
+void ST7735::drawTextLine(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg)
+{
+	uint8_t first_char = _gfxFont->first;
+	uint8_t last_char = _gfxFont->last;
+	uint8_t *bitmap = _gfxFont->bitmap;
+
+	// 文字列全体の送り幅を求め、行の枠を画面の範囲に切り取る
+	int16_t lineW = 0;
+	for (const char *t = _text; *t; t++) {
+		uint8_t c = *t;
+		if (c < first_char || c > last_char) continue;
+		lineW += _gfxFont->glyph[c - first_char].xAdvance;
+	}
+	int16_t top = (int16_t)y + _gfxAscent;
+	int16_t x1 = x + lineW;
+	int16_t y0 = (top < 0) ? 0 : top;
+	int16_t y1 = top + _gfxFont->yAdvance;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y1 > st7735Init.height) y1 = st7735Init.height;
+	if (((int16_t)x >= x1) || (y0 >= y1)) return;
+
+	uint8_t fh = color >> 8, fl = color & 0xFF;
+	uint8_t bh = bg >> 8, bl = bg & 0xFF;
+	uint8_t line[LINE_BUFFER_PIXELS * 2];
+
+	setAddrWindow(x, y0, x1 - 1, y1 - 1);
+	for (int16_t yy = y0; yy < y1; yy++) {
+		uint8_t *p = line;
+		int16_t cx = x;
+		for (const char *t = _text; *t && cx < x1; t++) {
+			uint8_t c = *t;
+			if (c < first_char || c > last_char) continue;
+			GFXglyph *glyph = &(_gfxFont->glyph[c - first_char]);
+			int16_t gy = yy - ((int16_t)y + glyph->yOffset);  // 文字の画像の中での行
+			bool inRow = (gy >= 0) && (gy < glyph->height);
+			uint32_t rowBit = (uint32_t)glyph->bitmapOffset * 8 + (uint32_t)gy * glyph->width;
+			for (int16_t col = 0; col < glyph->xAdvance && cx < x1; col++, cx++) {
+				int16_t gx = col - glyph->xOffset;  // 文字の画像の中での列
+				uint32_t bit = rowBit + gx;
+				if (inRow && gx >= 0 && gx < glyph->width && (bitmap[bit >> 3] & (0x80 >> (bit & 7)))) {
+					*p++ = fh;
+					*p++ = fl;
 				} else {
-					if (size == 1) {
-						drawPixel(x + xo + xx, y + yo + yy, bg);
-					} else {
-						fillRect(x + (xo16 + xx) * size, y + (yo16 + yy) * size, size, size, bg);
-					}
+					*p++ = bh;
+					*p++ = bl;
 				}
-				
 			}
-
-			bits <<= 1;
 		}
+		writeDataBlock(line, p - line);
 	}
 }
 #endif
 
 #pragma region 漢字表示関連メソッド
 #ifdef TFT_ENABLE_KANJI				// 漢字表示が可能な場合
+bool ST7735::setKanjiFont(const char *name)
+{
+	return KanjiHelper::SetFont(name);
+}
+
+void ST7735::setKanjiFont(const KanjiFontTable *table)
+{
+	KanjiHelper::SetFont(table);
+}
+
+bool ST7735::getKanjiFonts(char *buf, uint16_t len)
+{
+	buf[0] = 0;
+	int curLen = 0;
+	for (int i = 0; i < TFT_MAX_KANJI_FONTS; i++) {
+		if (registeredKanjiFonts[i].name != NULL) {
+			if (curLen + strlen(registeredKanjiFonts[i].name) + 1 > len) {
+				return false;
+			}
+			strcat(buf, registeredKanjiFonts[i].name);
+			strcat(buf, ",");
+			curLen += strlen(registeredKanjiFonts[i].name) + 1;
+		}
+	}
+	if (curLen > 0) buf[curLen - 1] = 0;
+	return true;
+}
+
 /// @brief 漢字１文字を表示する
 /// @param x 表示するX座標
 /// @param y 表示するY座標
 /// @param utf8codes 表示するUTF8、もしくはASCIIコード
 /// @param color 表示色
 /// @param bg 背景色
-void ST7735::drawKanji(uint16_t &x, uint16_t &y, uint32_t utf8codes, uint16_t color, uint16_t bg)
-{
-	const uint8_t *bmpData;
-	uint8_t w;
-	uint8_t h;
-	if (utf8codes <= 0xFF) {  // １バイト文字
-		const AsciiFont *pFont = KanjiHelper::FindAscii(utf8codes);
-		if (pFont == NULL) {
-			x = x + AFont[0].width;
-			return;
-		}
-		bmpData = pFont->bmpData;
-		w = pFont->width;
-		h = pFont->height;
-	} else {
-		const KanjiFont *pFont = KanjiHelper::FindKanji(utf8codes);
-		if (pFont == NULL) {
-			x = x + KFont[0].width;
-			return;
-		}
-		bmpData = pFont->bmpData;
-		w = pFont->width;
-		h = pFont->height;
+void ST7735::drawKanji(uint16_t &x, uint16_t &y, uint32_t utf8codes, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (size < 1) size = 1;
+	KanjiGlyph glyph;
+	if (!KanjiHelper::GetGlyph(utf8codes, &glyph)) {
+		x = x + glyph.width * size;
+		return;
 	}
+	uint8_t w = glyph.width;
+	uint8_t h = glyph.height;
 	if (bTextWrap) {
-		if ((x + w) > st7735Init.width) {
+		if ((x + w * size) > st7735Init.width) {
 			x = 0;
-			y = y + h;
+			y = y + h * size;
 		}
 	}
-	drawKanjiBlock(x, y, w, h, bmpData, color, bg);
+	drawKanjiGlyph(x, y, &glyph, color, bg, size);
 	/*
 	uint8_t w_bytes = (w + 8 - 1) / 8;  // 横方向のバイト数
 	uint8_t h_bytes = h;                // 縦方向のバイト数
@@ -787,94 +1073,175 @@ void ST7735::drawKanji(uint16_t &x, uint16_t &y, uint32_t utf8codes, uint16_t co
 		}
 	}
 	*/
-	x = x + w;
+	x = x + w * size;
 	return;
 }
 
+uint16_t ST7735::drawKanjiCell(uint16_t x, uint16_t y, uint32_t code, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (size < 1) size = 1;
+	KanjiGlyph glyph;
+	if (KanjiHelper::GetGlyph(code, &glyph)) {
+		drawKanjiGlyph(x, y, &glyph, color, bg, size);
+	} else if (!(isTransparentColor && bg == bmpTransparentColor) && glyph.width > 0) {
+		fillRectangle(x, y, glyph.width * size, glyph.height * size, bg);
+	}
+	return glyph.width * size;
+}
 
-void ST7735::drawKanjiBlock(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *bmpData, uint16_t color,uint16_t bg)
+void ST7735::drawKanjiBlock(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *bmpData, uint16_t color,uint16_t bg, uint8_t size)
 {
-	setAddrWindow(x, y, x + w -1 , y + h -1);  // 漢字ブロックの大きさでアドレスウインドウを設定
-	uint8_t w_bytes = (w + 8 - 1) / 8;  // 横方向のバイト数
-	uint8_t h_bytes = h;                // 縦方向のバイト数
-	int16_t bmpIdx = 0;                 // ビットマップ情報には、bmp + yy*w_bytes + xx でアクセスできるが、順番に並んでいるので最初から順に読むほうが速いのでは？
-	bool isByteMultiple = (w % 8 == 0); // 横幅が8の倍数かのフラグ 
-	for (int8_t yy = 0; yy < h_bytes; yy++) {
-		for (int8_t xx = 0; xx < w_bytes; xx++) {
-			uint8_t bitCnt;
-			if (isByteMultiple) {
-				bitCnt = 8;
-			} else {
-				bitCnt = (xx != (w_bytes - 1)) ? 8 : (w % 8);
-			}
-			uint8_t bits = bmpData[bmpIdx];
-			for (int8_t bb = 0; bb < bitCnt; bb++) {
-				if (isTransparentColor && bg == bmpTransparentColor) {
-					if (bits & 0x80) {
-						drawPixel(x+(xx*8)+bb,y+yy,color);
-					} 					
-				} else {
-					if (bits & 0x80) {
-						writeData(color >> 8);
-						writeData(color & 0xFF);
-					} else {
-						writeData(bg >> 8);
-						writeData(bg & 0xFF);
-					}
-				}
-				bits <<= 1;
-			}
-			bmpIdx++;
-		}
+	uint8_t w_bytes = (w + 8 - 1) / 8;  // 横方向のバイト数。各行はバイト単位に揃えられている
+	if (isTransparentColor && bg == bmpTransparentColor) {
+		drawMonoBitmapRuns(x, y, w, h, bmpData, 0, w_bytes * 8, color, size);  // 前景のランごとに描画
+	} else {
+		drawMonoBitmap(x, y, w, h, bmpData, 0, w_bytes * 8, color, bg, size);  // 漢字ブロックの大きさで１回だけアドレスウインドウを設定
 	}
 }
 
 
-void ST7735::drawTextKanji(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg, uint8_t size)
+/// @brief drawKanjiGlyphで、KanjiRowReaderが取り出した行をビット列にしたもの
+struct KanjiGlyphRows {
+	KanjiRowReader reader;
+	uint8_t width;
+	uint8_t bits[4];	///< 行の点（左端がMSB）
+};
+
+static const uint8_t *nextKanjiGlyphRow(void *context, uint32_t *bit)
 {
-	uint16_t cursor_x, cursor_y;
-	//uint8_t first_char, last_char;
-	uint16_t textlen, i;
+	KanjiGlyphRows *rows = (KanjiGlyphRows *)context;
+	uint32_t row = rows->reader.NextRow() << (32 - rows->width);  // 左端の点をMSBに
+	rows->bits[0] = row >> 24;
+	rows->bits[1] = row >> 16;
+	rows->bits[2] = row >> 8;
+	rows->bits[3] = row;
+	*bit = 0;
+	return rows->bits;
+}
 
-	cursor_x = x, cursor_y = y;
+void ST7735::drawKanjiGlyph(uint16_t x, uint16_t y, const KanjiGlyph *glyph, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (glyph->width == 0 || glyph->width > KANJI_CODEC_MAX_WIDTH) return;  // KanjiRowReaderが扱える幅を超える
+	// 圧縮された文字もあるので、上の行から順に１行ずつ取り出して描画する
+	KanjiGlyphRows rows;
+	rows.reader.Begin(glyph);
+	rows.width = glyph->width;
+	drawMonoRows(x, y, glyph->width, glyph->height, nextKanjiGlyphRow, &rows, color, bg, size, isTransparentColor && bg == bmpTransparentColor);
+}
 
-	for (i = 0; i < strlen(_text);) {
-
-		uint32_t utf8codes = 0;
-		uint8_t step = 0;
-		if ((_text[i] & 0x80) == 0x00) {
-			step = 1;  			// 1バイト文字 (ASCII)
-			utf8codes = _text[i];
-		} else if ((_text[i] & 0xE0) == 0xC0) {
-			step = 2;  // 2バイト文字
-			utf8codes = (_text[i] << 8) | _text[i + 1];
-		} else if ((_text[i] & 0xF0) == 0xE0) {
-			step =  3;  // 3バイト文字
-			utf8codes = (_text[i] << 16) | (_text[i + 1] << 8) | _text[i+2];
-		} else if ((_text[i] & 0xF8) == 0xF0) {
-			utf8codes = (_text[i] << 24) | (_text[i + 1] << 16) | (_text[i +2] << 8) | _text[i + 3];
-			step = 4;  // 4バイト文字
-		} else {
-			return ;  // 不正なUTF-8バイト
+void ST7735::drawKanjiRun(uint16_t x, uint16_t y, const char *_text, uint16_t length, uint16_t color, uint16_t bg, uint8_t size)
+{
+	for (uint16_t i = 0; i < length;) {
+		uint32_t utf8codes;
+		KanjiGlyph glyph;
+		uint8_t step = KanjiHelper::DecodeUTF8(&_text[i], &utf8codes, kanjiForceHankana);
+		if (step == 0) {
+			return;  // 不正なUTF-8バイト
 		}
-		#ifdef TFT_FORCE_HANKANA					// 半角カナを1バイト文字として処理
-		uint16_t top2bytes = (uint16_t)(utf8codes >> 8);
-		if (top2bytes == 0xefbd)  {
-			utf8codes = utf8codes & 0x000000FF;
-		} else if (top2bytes == 0xefbe) {
-			utf8codes = (utf8codes & 0x000000FF) + 0x40;
+		if (KanjiHelper::GetGlyph(utf8codes, &glyph)) {
+			drawKanjiGlyph(x, y, &glyph, color, bg, size);
 		}
-		#endif
-		drawKanji(cursor_x, cursor_y, utf8codes, color, bg);
+		x += glyph.width * size;
+		i += step;
+	}
+}
 
-		if (utf8codes <= 0xFF ){  // １バイト文字
-			const AsciiFont *pFont = KanjiHelper::FindAscii(utf8codes);
-		} else {
-			const KanjiFont *pFont = KanjiHelper::FindKanji(utf8codes);
+void ST7735::drawKanjiGlyphs(uint16_t x, uint16_t y, const KanjiFontTable *table, const uint16_t *glyphs, uint16_t count, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (size < 1) size = 1;
+	for (uint16_t i = 0; i < count; i++) {
+		KanjiGlyph glyph;
+		if (KanjiHelper::GetGlyphAt(*table, glyphs[i], &glyph)) {
+			drawKanjiGlyph(x, y, &glyph, color, bg, size);
 		}
-		i += step;
+		x += glyph.width * size;
 	}
 }
+
+/// @brief 数行ずつLayoutLinesを呼び出すときに、最後の行の後にまだ行があるかを調べる
+/// @details 文字列の途中で終わった行の後と、'\n'で終わった行の後には行がある（文字列が'\n'で終わるときは、空の行）。
+/// LayoutLinesは一度に求めた行の中ではこの空の行も返すので、ここで同じに扱えば、行数が一度に求める行数によらなくなる。
+/// @param text LayoutLinesに渡した文字列
+/// @param last LayoutLinesが返した最後の行
+/// @return 続きの行があればtrue
+static bool kanjiLayoutContinues(const char *text, const KanjiLine &last)
+{
+	return text[last.next] != 0 || last.next > last.start + last.length;
+}
+
+void ST7735::drawTextKanji(uint16_t x, uint16_t y, const char *_text, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (size < 1) size = 1;
+	if (!bTextWrap) {
+		drawKanjiRun(x, y, _text, strlen(_text), color, bg, size);
+		return;
+	}
+	// 禁則処理をしながら数行ずつレイアウトして描画する
+	KanjiLine lines[4];
+	uint16_t lineHeight = KanjiHelper::Table().height * size;
+	uint16_t startX = x;
+	const char *p = _text;
+	bool more = *p != 0;
+	while (more) {
+		uint16_t n = KanjiHelper::LayoutLines(p, startX, st7735Init.width, size, kanjiForceHankana, lines, 4);
+		for (uint16_t i = 0; i < n; i++) {
+			if (i > 0 || p != _text) {		// ２行目以降は左端から描画する
+				x = 0;
+				y += lineHeight;
+			}
+			drawKanjiRun(x, y, p + lines[i].start, lines[i].length, color, bg, size);
+		}
+		if (lines[n - 1].next == 0) {
+			return;  // 不正なUTF-8バイト
+		}
+		more = kanjiLayoutContinues(p, lines[n - 1]);
+		p += lines[n - 1].next;
+		startX = 0;
+	}
+}
+
+uint16_t ST7735::layoutTextKanji(const char *_text, uint16_t wrapWidth, uint8_t size, KanjiLine *lines, uint16_t maxLines)
+{
+	return KanjiHelper::LayoutLines(_text, 0, wrapWidth, size, kanjiForceHankana, lines, maxLines);
+}
+
+void ST7735::drawTextKanjiLines(uint16_t x, uint16_t y, const char *_text, const KanjiLine *lines, uint16_t firstLine, uint16_t lineCount, uint16_t color, uint16_t bg, uint8_t size)
+{
+	if (size < 1) size = 1;
+	uint16_t lineHeight = KanjiHelper::Table().height * size;
+	for (uint16_t i = firstLine; i < firstLine + lineCount; i++) {
+		drawKanjiRun(x, y, _text + lines[i].start, lines[i].length, color, bg, size);
+		y += lineHeight;
+	}
+}
+
+void ST7735::measureTextKanji(const char *_text, uint16_t wrapWidth, uint8_t size, TextMetrics *metrics)
+{
+	uint32_t hash;
+	if (size < 1) size = 1;
+	if (findMetricsCache(_text, &KanjiHelper::Table(), wrapWidth, size, metrics, &hash)) {
+		return;
+	}
+	memset(metrics, 0, sizeof(TextMetrics));
+	// drawTextKanjiと同じ禁則処理で行に分ける
+	KanjiLine lines[4];
+	const char *p = _text;
+	bool more;
+	do {
+		uint16_t n = KanjiHelper::LayoutLines(p, 0, wrapWidth, size, kanjiForceHankana, lines, 4);
+		for (uint16_t i = 0; i < n; i++) {
+			addMetricsLine(metrics, (p - _text) + lines[i].start, lines[i].width);
+		}
+		if (lines[n - 1].next == 0) {
+			break;  // 不正なUTF-8バイト
+		}
+		more = kanjiLayoutContinues(p, lines[n - 1]);
+		p += lines[n - 1].next;
+	} while (more);
+	metrics->height = metrics->lineCount * KanjiHelper::Table().height * size;
+	metrics->top = 0;
+	storeMetricsCache(_text, hash, &KanjiHelper::Table(), wrapWidth, size, metrics);
+}
 #endif
 #pragma endregion
 
@@ -941,161 +1308,266 @@ void ST7735::bmpDraw(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t *p
 		writeData(0b10000000);
 		x = getWidth() - x - w;
 	} 
-	uint16_t* pBase = p;
+	bmpDrawRect((int16_t)x, (int16_t)y, p, w, 0, 0, w, h);
+	if (direction == 1) {
+		writeCommand(ST7735Cmd.MADCTL);
+		writeData(0b11000000);
+	}
+}
+
+void ST7735::bmpDrawRect(int16_t x, int16_t y, const uint16_t *p, uint16_t stride, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h)
+{
+	// 画面の範囲に切り取り、見えている部分の左上を、画像の中の位置に合わせて進める
+	int16_t x0 = x, y0 = y;
+	int16_t x1 = x + w, y1 = y + h;
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y1 > st7735Init.height) y1 = st7735Init.height;
+	if (x0 >= x1 || y0 >= y1) return;
+	p += (uint32_t)(sy + (y0 - y)) * stride + sx + (x0 - x);
+	int16_t vw = x1 - x0;
+
 	if (isTransparentColor) {
-		for (uint16_t yy = 0; yy < h; yy++) {
-			for (uint16_t xx = 0; xx < w; xx++) {
-				uint16_t c = *p;
-				if (isTransparentColor && c == bmpTransparentColor) {
-					// 透過色なら何もしない
-				} else {
-					drawPixel(xx+x, yy+y, c);
-				}
-				p++;
+		// 透過色でない点が連続している部分（ラン）ごとに、ウインドウを設定して送る
+		for (int16_t yy = y0; yy < y1; yy++, p += stride) {
+			int16_t xx = 0;
+			while (xx < vw) {
+				while (xx < vw && p[xx] == bmpTransparentColor) xx++;
+				int16_t start = xx;
+				while (xx < vw && p[xx] != bmpTransparentColor) xx++;
+				if (xx > start) bmpDrawRun(x0 + start, yy, p + start, xx - start);
 			}
 		}
-	} else {								// 透過色処理をしないなら、高速で書き込める
-		setAddrWindow(x, y, x + w - 1, y + h - 1);  // 漢字ブロックの大きさでアドレスウインドウを設定
-		for (uint16_t yy = 0; yy < h; yy++) {
-			for (uint16_t xx = 0; xx < w; xx++) {
-				uint16_t c = *p;
-				if (isTransparentColor && c == bmpTransparentColor) {
-					// 透過色なら何もしない
-					// と思ったらそういうことはできない。ウインドウ指定を一回にする場合、スキャンを飛ばす方法がないので。
-				} else {
-					writeData(c >> 8);
-					writeData(c & 0xFF);
-				}
-					p++;
+		return;
+	}
+	// 透過色処理をしないなら、見えている範囲で１回だけウインドウを設定し、１行ずつまとめて送る
+	uint8_t line[LINE_BUFFER_PIXELS * 2];
+	setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	for (int16_t yy = y0; yy < y1; yy++, p += stride) {
+		for (int16_t cx = 0; cx < vw;) {
+			int16_t n = vw - cx;
+			if (n > LINE_BUFFER_PIXELS) n = LINE_BUFFER_PIXELS;
+			for (int16_t i = 0; i < n; i++) {
+				uint16_t c = p[cx + i];
+				line[i * 2] = c >> 8;
+				line[i * 2 + 1] = c & 0xFF;
 			}
+			writeDataBlock(line, n * 2);
+			cx += n;
 		}
 	}
-	if (direction == 1) {
-		writeCommand(ST7735Cmd.MADCTL);
-		writeData(0b11000000);
-	}
 }
-#endif
-#pragma endregion
 
-// ------ not functional yet ----------------------------------------------
-// needs fat-library
+void ST7735::drawImageRect(int16_t x, int16_t y, const TFTImage *image, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, const uint16_t *palette)
+{
+	if (image->format == TFT_IMAGE_RGB565) {
+		drawPanelPixels(x, y, image->data, image->width, sx, sy, w, h);
+	} else if (image->format == TFT_IMAGE_RLE) {
+		drawRLE(x, y, image, sx, sy, w, h);
+	} else if (image->format >= TFT_IMAGE_INDEXED1 && image->format <= TFT_IMAGE_INDEXED8) {
+		drawIndexed(x, y, image, sx, sy, w, h, palette ? palette : image->palette);
+	}
+}
 
-#if defined TFT_ENABLE_BMP
-#pragma region 未使用のメソッド
-#ifndef pixel_buffer
-  #define pixel_buffer  10
-#endif
+void ST7735::drawRGB(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint8_t *p, uint8_t format, uint8_t options)
+{
+	uint8_t bytes = ColorConvert::BytesPerPixel(format);
+	if (bytes == 0) return;
+	int16_t x0 = (x < 0) ? 0 : x;
+	int16_t y0 = (y < 0) ? 0 : y;
+	int16_t x1 = x + w;
+	int16_t y1 = y + h;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y1 > st7735Init.height) y1 = st7735Init.height;
+	if ((x0 >= x1) || (y0 >= y1)) return;
+
+	uint32_t rowBytes = (uint32_t)w * bytes;
+	const uint8_t *row = p + (uint32_t)(y0 - y) * rowBytes + (uint32_t)(x0 - x) * bytes;
+	uint16_t line[LINE_BUFFER_PIXELS];
+	options = (options & TFT_COLOR_DITHER) | TFT_COLOR_PANEL_ORDER;
+
+	if (!isTransparentColor) setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	for (int16_t yy = y0; yy < y1; yy++, row += rowBytes) {
+		ColorConvert::Convert(format, line, row, x1 - x0, options, x0, yy);
+		if (isTransparentColor) {
+			drawOpaqueRuns(x0, yy, (uint8_t *)line, x1 - x0);  // 透過色以外の画素のランごとに描画
+		} else {
+			writeDataBlock((uint8_t *)line, (x1 - x0) * 2);
+		}
+	}
+}
 
+void ST7735::drawRLE(int16_t x, int16_t y, const TFTImage *image, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h)
+{
+	int16_t x0 = (x < 0) ? 0 : x;
+	int16_t y0 = (y < 0) ? 0 : y;
+	int16_t x1 = x + w;
+	int16_t y1 = y + h;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y1 > st7735Init.height) y1 = st7735Init.height;
+	if ((x0 >= x1) || (y0 >= y1)) return;
+	uint8_t line[LINE_BUFFER_PIXELS * 2];
+	const uint8_t *p = image->data;
+
+	if (!isTransparentColor && sx == 0 && sy == 0 && w == image->width && h == image->height &&
+		x0 == x && y0 == y && x1 == x + w && y1 == y + h) {
+		// 画像全体が見えているなら、パケットをそのまま１つのウインドウに送る
+		setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+		uint32_t total = (uint32_t)w * h;
+		while (total > 0) {
+			uint16_t n = (*p & 0x7F) + 1;
+			if (*p++ & 0x80) {
+				for (uint16_t i = 0; i < n; i++) {
+					line[i * 2] = p[0];
+					line[i * 2 + 1] = p[1];
+				}
+				writeDataBlock(line, n * 2);
+				p += 2;
+			} else {
+				writeDataBlock(p, n * 2);
+				p += n * 2;
+			}
+			total -= n;
+		}
+		return;
+	}
 
+	// １行ずつ展開し、見えている部分だけを送る
+	TFTRleReader reader = {p, false, 0};
+	uint16_t c0 = sx + (x0 - x);  // 見えている部分の、画像の中での列の範囲
+	uint16_t c1 = sx + (x1 - x);
+	uint16_t r0 = sy + (y0 - y);  // 見えている最初の行の、画像の中での位置
+	for (uint32_t i = (uint32_t)r0 * image->width; i > 0; i--) reader.next(NULL);
+	if (!isTransparentColor) setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	for (int16_t yy = y0; yy < y1; yy++) {
+		for (uint16_t c = 0; c < image->width; c++) {
+			reader.next((c >= c0 && c < c1) ? &line[(c - c0) * 2] : NULL);
+		}
+		if (isTransparentColor) {
+			drawOpaqueRuns(x0, yy, line, x1 - x0);  // 透過色以外の画素のランごとに描画
+		} else {
+			writeDataBlock(line, (x1 - x0) * 2);
+		}
+	}
+}
 
-void ST7735::pushColor(uint16_t color)
+void ST7735::drawIndexed(int16_t x, int16_t y, const TFTImage *image, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, const uint16_t *palette)
 {
-	uint8_t hi, lo;
-	hi = color >> 8;
-	lo = color;
-	pSpiHW->DCHigh();
-	pSpiHW->CSLow();
-	pSpiHW->spiWrite(hi);
-	pSpiHW->spiWrite(lo);
-	pSpiHW->CSHigh();
+	int16_t x0 = (x < 0) ? 0 : x;
+	int16_t y0 = (y < 0) ? 0 : y;
+	int16_t x1 = x + w;
+	int16_t y1 = y + h;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y1 > st7735Init.height) y1 = st7735Init.height;
+	if ((x0 >= x1) || (y0 >= y1)) return;
+
+	// パレットを、液晶に送る順のバイト列の表にする
+	uint8_t bpp = 1 << (image->format - TFT_IMAGE_INDEXED1);
+	uint16_t colors = 1 << bpp;
+	uint8_t lut[256 * 2];
+	for (uint16_t i = 0; i < colors; i++) {
+		lut[i * 2] = palette[i] >> 8;
+		lut[i * 2 + 1] = palette[i] & 0xFF;
+	}
+	uint8_t mask = colors - 1;
+	uint32_t rowBytes = ((uint32_t)image->width * bpp + 7) / 8;
+	uint32_t bit0 = (uint32_t)(sx + (x0 - x)) * bpp;  // 見えている最初の列の、行の中でのビット位置
+	const uint8_t *row = image->data + (uint32_t)(sy + (y0 - y)) * rowBytes;
+	uint8_t line[LINE_BUFFER_PIXELS * 2];
+
+	if (!isTransparentColor) setAddrWindow(x0, y0, x1 - 1, y1 - 1);
+	for (int16_t yy = y0; yy < y1; yy++, row += rowBytes) {
+		uint8_t *q = line;
+		uint32_t bit = bit0;
+		for (int16_t xx = x0; xx < x1; xx++, bit += bpp) {
+			// ビットは行の中でMSBから順に詰められている
+			uint8_t idx = (row[bit >> 3] >> (8 - bpp - (bit & 7))) & mask;
+			*q++ = lut[idx * 2];
+			*q++ = lut[idx * 2 + 1];
+		}
+		if (isTransparentColor) {
+			drawOpaqueRuns(x0, yy, line, x1 - x0);  // 透過色以外の画素のランごとに描画
+		} else {
+			writeDataBlock(line, (x1 - x0) * 2);
+		}
+	}
 }
 
+size_t ST7735::bmpBuildRuns(const uint16_t *p, uint16_t w, uint16_t h, uint16_t transColor, uint16_t *runs, size_t capacity)
+{
+	// まず必要な要素数を数える
+	size_t n = 0;
+	const uint16_t *row = p;
+	for (uint16_t yy = 0; yy < h; yy++, row += w) {
+		n++;  // ランの数
+		for (uint16_t xx = 0; xx < w; xx++) {
+			if (row[xx] != transColor && (xx == 0 || row[xx - 1] == transColor)) n += 2;
+		}
+	}
+	if (runs == NULL || n > capacity) return n;
+
+	row = p;
+	for (uint16_t yy = 0; yy < h; yy++, row += w) {
+		uint16_t *count = runs++;
+		*count = 0;
+		uint16_t xx = 0;
+		while (xx < w) {
+			while (xx < w && row[xx] == transColor) xx++;
+			uint16_t start = xx;
+			while (xx < w && row[xx] != transColor) xx++;
+			if (xx > start) {
+				*runs++ = start;
+				*runs++ = xx - start;
+				(*count)++;
+			}
+		}
+	}
+	return n;
+}
 
-bool bmpDraw(int8_t x, int8_t y, int8_t *bmpname) {
-  bool ec = 0, padding = 0;
-  int8_t bmpdata[pixel_buffer * 3],
-       planes, depth, r, g, b, col, row;
-  int16 i, buffer = pixel_buffer * 3, format, bmpHeight, bmpWidth, color;
-  int32 offset, compression, bmp_size, row_size, padding_factor;
-  if((x >= st7735Init.width) || (y >= st7735Init.height))
-    return false;
-  if(fat16_open_file(bmpname) != 0)
-    return false;
-  ec |= sdcard_read_byte(address_pointer + 1, &format);
-  format <<= 8;
-  ec |= sdcard_read_byte(address_pointer, &format);
-  if(format != 0x4D42)                           // BMP file format signature
-    return false;                                // Return error
-  ec |= sdcard_read_byte(address_pointer + 0x0D, &offset);
-  offset <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x0C, &offset);
-  offset <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x0B, &offset);
-  offset <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x0A, &offset);
-  ec |= sdcard_read_byte(address_pointer + 0x13, &bmpWidth);
-  bmpWidth <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x12, &bmpWidth);
-  ec |= sdcard_read_byte(address_pointer + 0x17, &bmpHeight);
-  bmpHeight <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x16, &bmpHeight);
-  ec |= sdcard_read_byte(address_pointer + 0x1A, &planes);
-  ec |= sdcard_read_byte(address_pointer + 0x1C, &depth);
-  ec |= sdcard_read_byte(address_pointer + 0x21, &compression);
-  compression <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x20, &compression);
-  compression <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x1f, &compression);
-  compression <<= 8;
-  ec |= sdcard_read_byte(address_pointer + 0x1e, &compression);
-  if(ec != 0 || compression != 0 || depth != 24 || planes != 1)
-    return false;
-  bmp_size = file_size - offset;            // bmp_size: BMP image raw size
-  row_size = bmp_size / bmpHeight;          // row_size: number of bytes per row
-  if((x + bmpWidth  - 1) >=  st7735Init.width) {      // st7735Init.width is the TFT screen width
-    bmpWidth = st7735Init.width  - x;
-    padding = 1;           //Padding = 1 ==> only upper left part will be displayed
-    padding_factor = bmpWidth / pixel_buffer;
-    if(bmpWidth % pixel_buffer)
-      padding_factor++;
-    padding_factor *= buffer;
-  }
-  if((y + bmpHeight - 1) >= st7735Init.height) {       // st7735Init.height is the TFT screen height
-    offset += row_size * (bmpHeight - st7735Init.height + y);  // Only upper part will be displayed
-    bmpHeight = st7735Init.height - y;
-  }
-  file_pointer     = offset;
-  address_pointer += offset;
-  i = buffer;
-  if(_tft_type != 2){
-  // Change row address order
-    write_command(ST7735_MADCTL);
-    if(_tft_type == 0)
-      write_data(0x48);
-    if(_tft_type == 1)
-      write_data(0x40);
-  }
-  setAddrWindow(x , y, x + bmpWidth - 1, y + bmpHeight - 1);
-  for(row = 0; row < bmpHeight; row++){
-    for(col = 0; col < bmpWidth; col++){
-      if(i >= buffer){
-        i = 0;
-        fat16_read_data(buffer, bmpdata);
-      }
-      b = bmpdata[i++];
-      g = bmpdata[i++];
-      r = bmpdata[i++];
-      color = Color565(r, g, b);
-      pushColor(color);
-    }
-    if(padding == 1){
-      i = buffer;
-      file_pointer    += row_size - padding_factor;
-      address_pointer += row_size - padding_factor;
-    }
-  }
-  if(_tft_type != 2){
-  // Return row address order as it was
-    write_command(ST7735_MADCTL);
-    if(_tft_type == 0)
-      write_data(0xC8);
-    if(_tft_type == 1)
-      write_data(0xC0);
-  }
-  // Good BMP
-  return true;
+void ST7735::bmpDrawRuns(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *p, const uint16_t *runs, uint8_t direction)
+{
+	if (direction == 1) {
+		writeCommand(ST7735Cmd.MADCTL);
+		writeData(0b10000000);
+		x = getWidth() - x - w;
+	}
+	for (uint16_t yy = 0; yy < h; yy++, p += w) {
+		uint16_t n = *runs++;
+		for (uint16_t i = 0; i < n; i++, runs += 2) {
+			bmpDrawRun((int16_t)x + runs[0], (int16_t)y + yy, p + runs[0], runs[1]);
+		}
+	}
+	if (direction == 1) {
+		writeCommand(ST7735Cmd.MADCTL);
+		writeData(0b11000000);
+	}
 }
 
+void ST7735::bmpDrawRun(int16_t x, int16_t y, const uint16_t *p, uint16_t len)
+{
+	// 画面の範囲に切り取る
+	int16_t x0 = x;
+	int16_t x1 = x + len;
+	if (x0 < 0) x0 = 0;
+	if (x1 > st7735Init.width) x1 = st7735Init.width;
+	if (y < 0 || y >= st7735Init.height || x0 >= x1) return;
+
+	uint8_t line[LINE_BUFFER_PIXELS * 2];
+	p += x0 - x;
+	setAddrWindow(x0, y, x1 - 1, y);
+	for (int16_t cx = x0; cx < x1;) {
+		int16_t n = x1 - cx;
+		if (n > LINE_BUFFER_PIXELS) n = LINE_BUFFER_PIXELS;
+		for (int16_t i = 0; i < n; i++) {
+			uint16_t c = *p++;
+			line[i * 2] = c >> 8;
+			line[i * 2 + 1] = c & 0xFF;
+		}
+		writeDataBlock(line, n * 2);
+		cx += n;
+	}
+}
 #endif
-#pragma endregion
\ No newline at end of file
+#pragma endregion
@@ -0,0 +1,24 @@
+#include <stdint.h>
+#include <stdlib.h>
+#define TFT_TEXT_FONT_IMPL			// 5x7の文字データ(TextFonts.h)の実体はこのファイルに置く
+#include "../include/ST7735_TFT.h"
+
+/**
+ * @file ST7735_fonts.cpp
+ * @brief ライブラリに組み込まれている5x7の文字データとGFXフォント、名前で指定できるフォントの一覧を定義する。
+ * @details フォントのデータはこのファイルにだけ置かれる。ヘッダファイルで定義すると、インクルードした翻訳単位ごとに
+ * 同じデータがフラッシュに置かれてしまうため、ほかのファイルからはST7735_struct.hのextern宣言で参照する。
+ */
+#ifdef TFT_ENABLE_FONTS
+#include "../include/font/Font_Mono9p.h"
+#include "../include/font/Font_Mono18p.h"
+#include "../include/font/FreeMonoOblique12pt7b.h"
+#include "../include/font/FreeMonoOblique12pt_sub.h"
+
+RegisteredFont registeredFonts[TFT_MAX_FONTS] = {
+	{"FreeMono9pt7b", &FreeMono9pt7b},
+	{"FreeMono18pt7b", &FreeMono18pt7b},
+	{"FreeMonoOblique12pt_sub", &FreeMonoOblique12pt_sub},
+	{"FreeMonoOblique12pt7b", &FreeMonoOblique12pt7b},
+};
+#endif
@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <string.h>
+#include "../include/TextLabel.h"
+#if defined(TFT_ENABLE_KANJI)
+#include "../include/KanjiHelper.h"
+#endif
+
+/**
+ * @file TextLabel.cpp
+ * @brief 書き換えのあった文字の枠だけを描き直す、TextLabelクラスを定義する。
+ */
+
+#if defined(TFT_ENABLE_TEXT) && defined(TFT_ENABLE_FONTS)
+/// @brief 文字列を表示する部品を作る。表示は最初のupdateで行う
+/// @param tft 表示先
+/// @param x 表示するx座標
+/// @param y 表示するy座標。GFXフォントではベースライン、漢字フォントでは上端（drawText/drawTextKanjiと同じ）
+/// @param kanji trueなら漢字フォント、falseならsetFontで指定したGFXフォントで表示する
+/// @param color 文字の色
+/// @param bg 背景色
+/// @param size 文字のサイズ。漢字フォントのときだけ使う（GFXフォントのdrawCharCellは等倍のみ）
+TextLabel::TextLabel(ST7735 *tft, int16_t x, int16_t y, bool kanji, uint16_t color, uint16_t bg, uint8_t size)
+{
+	this->tft = tft;
+	this->x = x;
+	this->y = y;
+	this->kanji = kanji;
+	this->color = color;
+	this->bg = bg;
+	this->size = (size < 1) ? 1 : size;
+	font = NULL;
+	count = 0;
+	totalWidth = 0;
+	valid = false;
+}
+
+/// @brief 文字の色を変える。次のupdateですべて描き直す
+void TextLabel::setColor(uint16_t color, uint16_t bg)
+{
+	this->color = color;
+	this->bg = bg;
+	valid = false;
+}
+
+/// @brief 次のupdateで、すべての文字を描き直す。画面を消したときなどに呼ぶ
+void TextLabel::invalidate()
+{
+	valid = false;
+}
+
+const void *TextLabel::currentFont() const
+{
+#if defined(TFT_ENABLE_KANJI)
+	if (kanji) return &KanjiHelper::Table();
+#endif
+	return _gfxFont;
+}
+
+/// @brief １文字分の文字コードと送り幅を求める
+/// @return 文字のバイト数。不正なUTF-8の場合は0
+uint8_t TextLabel::nextGlyph(const char *text, uint32_t *code, uint16_t *advance) const
+{
+#if defined(TFT_ENABLE_KANJI)
+	if (kanji) {
+		uint8_t step = KanjiHelper::DecodeUTF8(text, code, kanjiForceHankana);
+		if (step == 0) return 0;  // 不正なUTF-8（途中で終わっている文字を含む）
+		uint8_t w, h;
+		KanjiHelper::GetGlyphSize(*code, &w, &h);
+		*advance = w * size;
+		return step;
+	}
+#endif
+	uint8_t c = *text;
+	*code = c;
+	*advance = (c < _gfxFont->first || c > _gfxFont->last) ? 0 : _gfxFont->glyph[c - _gfxFont->first].xAdvance;
+	return 1;
+}
+
+/// @brief 文字の枠の高さで、xからの距離 left ～ right の範囲を背景色で消す
+void TextLabel::clear(uint16_t left, uint16_t right)
+{
+	TextMetrics metrics;
+#if defined(TFT_ENABLE_KANJI)
+	if (kanji) {
+		tft->measureTextKanji("", 0, size, &metrics);
+	} else
+#endif
+	{
+		tft->measureText("", 0, 1, &metrics);
+	}
+	int16_t top = y + metrics.top;
+	int16_t height = metrics.height;
+	if (top < 0) {  // 画面の上にはみ出した行は除いて、見えている行だけを消す
+		height += top;
+		top = 0;
+	}
+	if (height <= 0 || right <= left) return;
+	tft->fillRectangle(x + left, top, right - left, height, bg);
+}
+
+/// @brief 文字列を表示する。前回と比べて、文字か位置が変わった枠だけを描き直す
+/// @details 折り返しはしない。TFT_TEXT_LABEL_MAX_GLYPHSを超える文字は表示されない。
+/// @param text 表示する文字列
+void TextLabel::update(const char *text)
+{
+	const void *f = currentFont();
+	if (f != font) {
+		font = f;
+		valid = false;
+	}
+	uint16_t cx = 0;
+	uint8_t n = 0;
+	for (const char *p = text; *p && n < TFT_TEXT_LABEL_MAX_GLYPHS;) {
+		uint32_t code;
+		uint16_t advance;
+		uint8_t step = nextGlyph(p, &code, &advance);
+		if (step == 0) break;  // 不正なUTF-8バイト
+		p += step;
+		if (advance == 0) continue;  // フォントにない文字（GFXフォント）
+		if (!valid || n >= count || cells[n].code != code || cells[n].x != cx) {
+#if defined(TFT_ENABLE_KANJI)
+			if (kanji) {
+				tft->drawKanjiCell(x + cx, y, code, color, bg, size);
+			} else
+#endif
+			{
+				tft->drawCharCell(x + cx, y, code, color, bg);
+			}
+			cells[n].code = code;
+			cells[n].x = cx;
+		}
+		cx += advance;
+		n++;
+	}
+	// 前回より短くなった部分を消す
+	if (cx < totalWidth) {
+		clear(cx, totalWidth);
+	}
+	count = n;
+	totalWidth = cx;
+	valid = true;
+}
+#endif
@@ -169,4 +169,18 @@ void HW::writeData(uint8_t data_)
 	spiWrite(data_);
 	CSHigh();
 	debugOut();
-}
\ No newline at end of file
+}
+
+/// @brief	データをまとめて送信する。DC:H→CS:L→データ送信（lenバイト）→CS:H
+/// @details writeDataを繰り返すとバイトごとにCSが上下するので、画素データのように連続するデータはこちらで送る。
+/// @param data_ 送信するデータ
+/// @param len 送信するバイト数
+void HW::writeDataBlock(const uint8_t* data_, size_t len)
+{
+	debugIn();
+	DCHigh();
+	CSLow();
+	spiWrite(data_, len);
+	CSHigh();
+	debugOut();
+}
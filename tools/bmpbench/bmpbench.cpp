@@ -0,0 +1,377 @@
+/**
+ * @file bmpbench.cpp
+ * @brief BMPDecoderを、ホストで動かして確かめるツール。
+ * @details ライブラリと同じ src/BMPDecoder.cpp で、BMPファイルをFILEから読み出す関数を指定したImageStreamで展開し、
+ * 展開にかかった時間を表示する。展開した画像はPPM（P6）で保存でき、参照の画像（他のツールで変換したPPM）を指定すると、
+ * RGB565に丸めた参照の画像と一致しない画素の数を表示する。<br/>
+ * --selftestでは、16ビット（555、BI_BITFIELDSの565と555）、24ビット、32ビット（BGRX、BI_BITFIELDS）のBMPを、
+ * 下から上、上から下の行の並びと、詰め物が要る幅（1、2、3、5画素など）、TFT_LINE_BUFFER_PIXELSより広い幅で作り、
+ * 一時ファイルに書いてから同じ手順で展開して、元の画素と一致することを確かめる。矩形の部分の展開と、途中で終わっているファイルも確かめる。
+ *
+ *     g++ -std=gnu++17 -O2 -DTFT_HOST_TOOL -o bmpbench tools/bmpbench/bmpbench.cpp src/BMPDecoder.cpp src/ImageStream.cpp src/ColorConvert.cpp
+ *
+ * 使い方:
+ *
+ *     bmpbench [オプション] <入力.bmp>
+ *         -o <出力.ppm>        展開した画像を保存する
+ *         --ref <参照.ppm>     展開した画素を参照の画像と比べ、一致しない画素の数を表示する
+ *         --rect <x>,<y>,<幅>,<高さ>  画像の矩形の部分だけを展開する
+ *         --repeat <回数>      展開を繰り返し、１回あたりの時間を表示する（既定値は10）
+ *     bmpbench --selftest
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "../../include/BMPDecoder.h"
+
+static void fatal(const char *fmt, const char *arg = "")
+{
+	fprintf(stderr, "bmpbench: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static uint16_t color565(uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+/// @brief ImageStreamの読み出し関数。FILEから読む
+static uint32_t readFile(void *context, uint8_t *buffer, uint32_t length)
+{
+	return fread(buffer, 1, length, (FILE *)context);
+}
+
+/// @brief 展開した画像（RGB565）
+struct Canvas {
+	uint16_t width = 0;
+	uint16_t height = 0;
+	std::vector<uint16_t> pixels;
+	std::vector<uint8_t> written;	///< 画素ごとに、出力関数から渡された回数
+};
+
+static bool storeRow(void *context, uint16_t x, uint16_t y, uint16_t w, const uint8_t *pixels)
+{
+	Canvas *c = (Canvas *)context;
+	if (c->pixels.empty()) return true;
+	if (x + w > c->width || y >= c->height) fatal("row out of range");
+	for (uint16_t i = 0; i < w; i++, pixels += 2) {
+		c->pixels[y * c->width + x + i] = (pixels[0] << 8) | pixels[1];
+		c->written[y * c->width + x + i]++;
+	}
+	return true;
+}
+
+/// @brief FILEから読むImageStreamで、BMPファイルの矩形の部分を展開する
+/// @return Decodeの結果
+static bool decodeFile(FILE *f, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h, Canvas *canvas)
+{
+	rewind(f);
+	ImageStream in;
+	in.Begin(readFile, f);
+	return BMPDecoder::Decode(in, sx, sy, w, h, storeRow, canvas);
+}
+
+static void writePpm(const char *path, const Canvas &c)
+{
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) fatal("cannot create %s", path);
+	fprintf(f, "P6\n%d %d\n255\n", c.width, c.height);
+	for (uint16_t v : c.pixels) {
+		uint8_t rgb[3] = {(uint8_t)(((v >> 11) & 0x1F) << 3), (uint8_t)(((v >> 5) & 0x3F) << 2), (uint8_t)((v & 0x1F) << 3)};
+		rgb[0] |= rgb[0] >> 5;
+		rgb[1] |= rgb[1] >> 6;
+		rgb[2] |= rgb[2] >> 5;
+		fwrite(rgb, 1, 3, f);
+	}
+	fclose(f);
+}
+
+/// @brief PPMのヘッダから数を１つ読む。"#"から行末まではコメントとして読み飛ばす
+/// @details 数の後の空白１文字も読むので、最後の数を読んだ後は画素の先頭になる。
+static bool readPpmNumber(FILE *f, unsigned *value)
+{
+	int c = fgetc(f);
+	while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+		if (c == '#') {
+			while (c != '\n' && c != EOF) c = fgetc(f);
+		}
+		c = fgetc(f);
+	}
+	if (c < '0' || c > '9') return false;
+	for (*value = 0; c >= '0' && c <= '9'; c = fgetc(f)) *value = *value * 10 + (c - '0');
+	return c != EOF;
+}
+
+/// @brief 参照の画像（PPM）をRGB565に丸めて比べ、一致しない画素の数を求める。--rectの外の画素は比べない
+/// @details 16ビット（555）のBMPを8ビットに広げたPPMも、緑の下位ビットの補い方がBMPDecoderと同じなので、丸めれば一致する。
+static uint32_t comparePpm(const char *path, const Canvas &c)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) fatal("cannot open %s", path);
+	unsigned w, h, maxval;
+	if (fgetc(f) != 'P' || fgetc(f) != '6' || !readPpmNumber(f, &w) || !readPpmNumber(f, &h) || !readPpmNumber(f, &maxval) ||
+		maxval != 255) {
+		fatal("%s: not a P6 PPM file", path);
+	}
+	if (w != c.width || h != c.height) fatal("%s: size differs", path);
+	uint32_t diffs = 0;
+	for (size_t i = 0; i < c.pixels.size(); i++) {
+		uint8_t rgb[3];
+		if (fread(rgb, 1, 3, f) != 3) fatal("%s: truncated", path);
+		if (c.written[i] && c.pixels[i] != color565(rgb[0], rgb[1], rgb[2])) diffs++;
+	}
+	fclose(f);
+	return diffs;
+}
+
+/// @brief --selftestで作るBMPの形式
+struct Format {
+	const char *name;
+	uint16_t depth;
+	bool bitfields;		///< BI_BITFIELDSでマスクを書く
+	bool rgb555;		///< 16ビットで、RGBがそれぞれ5ビット
+	uint32_t headerSize;	///< BITMAPINFOHEADER（40）か、BITMAPV4HEADER（108）
+};
+
+static void put16(std::vector<uint8_t> &data, uint16_t v)
+{
+	data.push_back(v & 0xFF);
+	data.push_back(v >> 8);
+}
+
+static void put32(std::vector<uint8_t> &data, uint32_t v)
+{
+	put16(data, v & 0xFFFF);
+	put16(data, v >> 16);
+}
+
+/// @brief 画素（RGB888）からBMPファイルを作る
+/// @param gap ヘッダと画素の間に空けるバイト数
+static std::vector<uint8_t> makeBmp(const Format &format, uint16_t width, uint16_t height, bool topDown,
+	const std::vector<uint8_t> &rgb, uint32_t gap)
+{
+	uint32_t rowBytes = ((uint32_t)width * format.depth / 8 + 3) & ~3u;
+	uint32_t masks = (format.bitfields && format.headerSize == 40) ? 12 : 0;  // V4ヘッダでは、マスクはヘッダの中
+	uint32_t offset = 14 + format.headerSize + masks + gap;
+	std::vector<uint8_t> data;
+	data.push_back('B');
+	data.push_back('M');
+	put32(data, offset + rowBytes * height);
+	put32(data, 0);
+	put32(data, offset);
+	put32(data, format.headerSize);
+	put32(data, width);
+	put32(data, topDown ? (uint32_t)-(int32_t)height : height);
+	put16(data, 1);
+	put16(data, format.depth);
+	put32(data, format.bitfields ? 3 : 0);
+	put32(data, rowBytes * height);
+	put32(data, 2835);
+	put32(data, 2835);
+	put32(data, 0);
+	put32(data, 0);
+	if (format.bitfields) {
+		if (format.depth == 32) {
+			put32(data, 0xFF0000), put32(data, 0xFF00), put32(data, 0xFF);
+		} else if (format.rgb555) {
+			put32(data, 0x7C00), put32(data, 0x03E0), put32(data, 0x001F);
+		} else {
+			put32(data, 0xF800), put32(data, 0x07E0), put32(data, 0x001F);
+		}
+	}
+	data.resize(offset, 0x5A);  // V4ヘッダの残りと、ヘッダと画素の間
+	for (uint16_t i = 0; i < height; i++) {
+		uint16_t y = topDown ? i : height - 1 - i;
+		size_t start = data.size();
+		for (uint16_t x = 0; x < width; x++) {
+			const uint8_t *p = &rgb[((size_t)y * width + x) * 3];
+			if (format.depth == 16 && format.rgb555) {
+				put16(data, ((p[0] >> 3) << 10) | ((p[1] >> 3) << 5) | (p[2] >> 3));
+			} else if (format.depth == 16) {
+				put16(data, color565(p[0], p[1], p[2]));
+			} else {
+				data.push_back(p[2]);
+				data.push_back(p[1]);
+				data.push_back(p[0]);
+				if (format.depth == 32) data.push_back(0xA5);
+			}
+		}
+		while (data.size() - start < rowBytes) data.push_back(0xEE);  // 行の詰め物
+	}
+	return data;
+}
+
+/// @brief BMPを一時ファイルに書き、矩形の部分を展開して元の画素と比べる
+/// @return 一致しない画素の数
+static uint32_t checkBmp(const std::vector<uint8_t> &bmp, uint16_t width, uint16_t height, const std::vector<uint16_t> &expected,
+	uint16_t sx, uint16_t sy, uint16_t w, uint16_t h)
+{
+	FILE *f = tmpfile();
+	if (f == NULL) fatal("cannot create a temporary file");
+	fwrite(bmp.data(), 1, bmp.size(), f);
+	Canvas canvas;
+	canvas.width = width;
+	canvas.height = height;
+	canvas.pixels.assign((size_t)width * height, 0);
+	canvas.written.assign((size_t)width * height, 0);
+	bool ok = decodeFile(f, sx, sy, w, h, &canvas);
+	fclose(f);
+	if (!ok) return (uint32_t)width * height;
+	uint32_t diffs = 0;
+	for (uint16_t y = 0; y < height; y++) {
+		for (uint16_t x = 0; x < width; x++) {
+			size_t i = (size_t)y * width + x;
+			bool inside = x >= sx && x < sx + w && y >= sy && y < sy + h;
+			if (canvas.written[i] != (inside ? 1 : 0) || (inside && canvas.pixels[i] != expected[i])) diffs++;
+		}
+	}
+	return diffs;
+}
+
+/// @brief いろいろな形式のBMPを作って展開し、元の画素と一致することを確かめる
+static int selftest()
+{
+	const Format formats[] = {
+		{"16-bit 555", 16, false, true, 40},
+		{"16-bit 565 bitfields", 16, true, false, 40},
+		{"16-bit 555 bitfields", 16, true, true, 40},
+		{"16-bit 565 V4", 16, true, false, 108},
+		{"24-bit", 24, false, false, 40},
+		{"32-bit", 32, false, false, 40},
+		{"32-bit bitfields", 32, true, false, 40},
+		{"32-bit V4", 32, true, false, 108},
+	};
+	const uint16_t widths[] = {1, 2, 3, 5, 7, 161, 330};
+	uint32_t seed = 12345;
+	int cases = 0, failures = 0;
+	for (const Format &format : formats) {
+		for (uint16_t width : widths) {
+			for (int topDown = 0; topDown < 2; topDown++) {
+				uint16_t height = 5;
+				std::vector<uint8_t> rgb((size_t)width * height * 3);
+				for (uint8_t &v : rgb) {
+					seed = seed * 1103515245 + 12345;
+					v = seed >> 16;
+				}
+				if (format.depth == 16 && format.rgb555) {
+					// 555の画素を8ビットに広げた値を、元の画素とする（緑の下位ビットは上位ビットで補う）
+					for (uint8_t &v : rgb) v = (v & 0xF8) | (v >> 5);
+				}
+				std::vector<uint16_t> expected;
+				for (size_t i = 0; i < rgb.size(); i += 3) expected.push_back(color565(rgb[i], rgb[i + 1], rgb[i + 2]));
+				std::vector<uint8_t> bmp = makeBmp(format, width, height, topDown, rgb, (width & 1) ? 6 : 0);
+
+				// 画像全体、左右と上下を切り取った矩形、画像からはみ出す矩形
+				const uint16_t rects[][4] = {
+					{0, 0, width, height},
+					{(uint16_t)(width / 3), 1, (uint16_t)(width - width / 3 - width / 4), 3},
+					{(uint16_t)(width / 2), 2, 0xFFFF, 0xFFFF},
+				};
+				for (const auto &r : rects) {
+					uint16_t w = (r[2] > width - r[0]) ? width - r[0] : r[2];
+					uint16_t h = (r[3] > height - r[1]) ? height - r[1] : r[3];
+					uint32_t diffs = checkBmp(bmp, width, height, expected, r[0], r[1], w, h);
+					cases++;
+					if (diffs) {
+						fprintf(stderr, "bmpbench: %s %ux%u %s rect %u,%u,%u,%u: %u pixels differ\n", format.name, width, height,
+							topDown ? "top-down" : "bottom-up", r[0], r[1], w, h, diffs);
+						failures++;
+					}
+				}
+
+				// 途中で終わっているファイルは、falseになる
+				std::vector<uint8_t> truncated(bmp.begin(), bmp.end() - 1);
+				FILE *f = tmpfile();
+				if (f == NULL) fatal("cannot create a temporary file");
+				fwrite(truncated.data(), 1, truncated.size(), f);
+				Canvas canvas;
+				bool ok = decodeFile(f, 0, 0, width, height, &canvas);
+				fclose(f);
+				cases++;
+				if (ok) {
+					fprintf(stderr, "bmpbench: %s %ux%u %s: truncated file was accepted\n", format.name, width, height,
+						topDown ? "top-down" : "bottom-up");
+					failures++;
+				}
+			}
+		}
+	}
+	printf("%d cases, %d failures\n", cases, failures);
+	return failures ? 1 : 0;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage:\n"
+		"  bmpbench [options] <input.bmp>\n"
+		"    -o <out.ppm>         save the decoded image\n"
+		"    --ref <ref.ppm>      count pixels that differ from a reference image\n"
+		"    --rect <x>,<y>,<w>,<h>  decode only this part of the image\n"
+		"    --repeat <n>         decode n times and print the average time\n"
+		"  bmpbench --selftest    decode generated BMPs of every supported format and check the pixels\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *input = NULL, *output = NULL, *ref = NULL;
+	int repeat = 10;
+	unsigned rect[4] = {0, 0, 0xFFFF, 0xFFFF};
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--selftest") == 0) {
+			return selftest();
+		} else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "--ref") == 0 && i + 1 < argc) {
+			ref = argv[++i];
+		} else if (strcmp(argv[i], "--rect") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%u,%u,%u,%u", &rect[0], &rect[1], &rect[2], &rect[3]) != 4) usage();
+		} else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			repeat = atoi(argv[++i]);
+			if (repeat < 1) usage();
+		} else if (argv[i][0] == '-' || input != NULL) {
+			usage();
+		} else {
+			input = argv[i];
+		}
+	}
+	if (input == NULL) usage();
+
+	FILE *f = fopen(input, "rb");
+	if (f == NULL) fatal("cannot open %s", input);
+	ImageStream in;
+	BMPInfo info;
+	in.Begin(readFile, f);
+	if (!BMPDecoder::ReadHeader(in, &info)) fatal("%s: not a supported BMP file", input);
+
+	Canvas canvas;
+	canvas.width = info.width;
+	canvas.height = info.height;
+	canvas.pixels.assign((size_t)canvas.width * canvas.height, 0);
+	canvas.written.assign(canvas.pixels.size(), 0);
+
+	double total = 0;
+	for (int n = 0; n < repeat; n++) {
+		auto start = std::chrono::steady_clock::now();
+		bool ok = decodeFile(f, rect[0], rect[1], rect[2], rect[3], &canvas);
+		total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		if (!ok) fatal("%s: decode failed", input);
+		if (n == 0) {
+			if (output) writePpm(output, canvas);
+			if (ref) printf("%u pixels differ from %s\n", comparePpm(ref, canvas), ref);
+			canvas.pixels.clear();  // 以後は展開だけを計る
+		}
+	}
+	fclose(f);
+	printf("%s: %ux%u %u-bit%s %s, %.1f us/decode\n", input, info.width, info.height, info.depth,
+		(info.depth == 16) ? (info.rgb555 ? " 555" : " 565") : "", info.topDown ? "top-down" : "bottom-up", total / repeat);
+	return 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file colorbench.cpp
+ * @brief ColorConvertを、ホストで動かして確かめるツール。
+ * @details ライブラリと同じ src/ColorConvert.cpp で、形式とオプションの組み合わせごとに画素を変換し、
+ * １秒あたりの画素数を表示する。比べるために、Color565と同じ式で１画素ずつ変換したときの速さも表示する。
+ * ディザをかけないときの結果がColor565と同じになること、ディザをかけたときの4x4の平均が元の色に近いことも確かめる。<br/>
+ * 横のグラデーションを、ディザありとなしでRGB565に変換した画像をPPM（P6）で保存して、縞の見え方を比べられる。
+ *
+ *     g++ -std=gnu++17 -O2 -DTFT_HOST_TOOL -o colorbench tools/colorbench/colorbench.cpp src/ColorConvert.cpp
+ *
+ * 使い方:
+ *
+ *     colorbench [オプション]
+ *         --pixels <画素数>    １回に変換する画素数（既定値は160、液晶の１行）
+ *         --repeat <回数>      変換を繰り返す回数（既定値は200000）
+ *         --gradient <出力.ppm> グラデーションを、上半分はディザなし、下半分はディザありで変換して保存する
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "../../include/ColorConvert.h"
+
+static void fatal(const char *fmt, const char *arg = "")
+{
+	fprintf(stderr, "colorbench: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+/// @brief ST7735::Color565と同じ式
+static uint16_t color565(uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+/// @brief 比べるための、１画素ずつの変換（RGB888、液晶に送る順）
+static void scalarRGB888(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t, uint16_t, uint16_t)
+{
+	uint8_t *d = (uint8_t *)dst;
+	for (uint32_t i = 0; i < count; i++, src += 3) {
+		uint16_t c = color565(src[0], src[1], src[2]);
+		*d++ = c >> 8;
+		*d++ = c & 0xFF;
+	}
+}
+
+typedef void (*ConvertFunc)(uint16_t *dst, const uint8_t *src, uint32_t count, uint8_t options, uint16_t x, uint16_t y);
+
+/// @brief 計る組み合わせ
+struct Case {
+	const char *name;
+	ConvertFunc func;
+	uint8_t format;
+	uint8_t options;
+};
+
+/// @brief 変換した画素の色（RGB565の値）を取り出す
+static uint16_t pixelAt(const std::vector<uint16_t> &dst, uint32_t i, uint8_t options)
+{
+	if (!(options & TFT_COLOR_PANEL_ORDER)) return dst[i];
+	const uint8_t *p = (const uint8_t *)dst.data() + i * 2;
+	return (p[0] << 8) | p[1];
+}
+
+/// @brief 画素の成分を取り出す
+static void sourceRGB(uint8_t format, const uint8_t *p, uint8_t *r, uint8_t *g, uint8_t *b)
+{
+	switch (format) {
+		case TFT_PIXEL_RGB888: *r = p[0], *g = p[1], *b = p[2]; break;
+		case TFT_PIXEL_BGR888: *r = p[2], *g = p[1], *b = p[0]; break;
+		case TFT_PIXEL_ARGB8888: *r = p[2], *g = p[1], *b = p[0]; break;
+		default: *r = *g = *b = p[0]; break;
+	}
+}
+
+/// @brief 変換の結果を確かめる
+/// @details ディザなしはColor565と同じになること。ディザありは、同じ色を4x4に並べたときの成分の平均が、
+/// 元の色を31（緑は63）/ 255倍した値から0.5以内になること
+static void verify(const Case &c)
+{
+	uint8_t bytes = ColorConvert::BytesPerPixel(c.format);
+	if (!(c.options & TFT_COLOR_DITHER)) {
+		// 全ての色を試す代わりに、成分ごとの256段階をそれぞれ試す
+		const uint32_t n = 256 * 3;
+		std::vector<uint8_t> src(n * bytes, 0x5A);
+		for (uint32_t i = 0; i < n; i++) {
+			uint8_t *p = &src[i * bytes];
+			uint8_t v = i & 0xFF, other = (uint8_t)(i * 37);
+			for (uint8_t k = 0; k < bytes; k++) p[k] = other;
+			p[(i >> 8) % bytes] = v;
+		}
+		std::vector<uint16_t> dst(n);
+		c.func(dst.data(), src.data(), n, c.options, 0, 0);
+		for (uint32_t i = 0; i < n; i++) {
+			uint8_t r, g, b;
+			sourceRGB(c.format, &src[i * bytes], &r, &g, &b);
+			if (pixelAt(dst, i, c.options) != color565(r, g, b)) fatal("%s: differs from Color565", c.name);
+		}
+		return;
+	}
+	for (int v = 0; v < 256; v++) {
+		double sum[3] = {0, 0, 0};
+		for (uint16_t y = 0; y < 4; y++) {
+			std::vector<uint8_t> src(4 * bytes);
+			for (int i = 0; i < 4; i++) {
+				uint8_t *p = &src[i * bytes];
+				for (uint8_t k = 0; k < bytes; k++) p[k] = v;
+			}
+			std::vector<uint16_t> dst(4);
+			c.func(dst.data(), src.data(), 4, c.options, 0, y);
+			for (int i = 0; i < 4; i++) {
+				uint16_t px = pixelAt(dst, i, c.options);
+				sum[0] += px >> 11;
+				sum[1] += (px >> 5) & 0x3F;
+				sum[2] += px & 0x1F;
+			}
+		}
+		double max[3] = {31, 63, 31};
+		for (int k = 0; k < 3; k++) {
+			double err = sum[k] / 16 - v * max[k] / 255;
+			if (err > 0.5 || err < -0.5) fatal("%s: dither average is off", c.name);
+		}
+	}
+}
+
+/// @brief 変換を繰り返し、１秒あたりの画素数を返す
+static double measure(const Case &c, uint32_t pixels, uint32_t repeat)
+{
+	uint8_t bytes = ColorConvert::BytesPerPixel(c.format);
+	std::vector<uint8_t> src(pixels * bytes);
+	for (size_t i = 0; i < src.size(); i++) src[i] = (uint8_t)(i * 131 + (i >> 7));
+	std::vector<uint16_t> dst(pixels);
+	uint32_t check = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < repeat; i++) {
+		c.func(dst.data(), src.data(), pixels, c.options, 0, i & 0xFFFF);
+		check += dst[i % pixels];  // 最適化で消されないように、結果を使う
+	}
+	double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (check == 0xFFFFFFFF) printf("\n");
+	return (double)pixels * repeat / sec;
+}
+
+/// @brief 横のグラデーションを、ディザなしとありで変換してPPMに保存する
+static void writeGradient(const char *path)
+{
+	const int w = 160, h = 64;
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) fatal("cannot create %s", path);
+	fprintf(f, "P6\n%d %d\n255\n", w, h * 2);
+	std::vector<uint8_t> src(w * 3);
+	std::vector<uint16_t> dst(w);
+	for (int y = 0; y < h * 2; y++) {
+		// 暗いところで縞が目立つように、0～63の範囲の灰色から茶色のグラデーションにする
+		for (int x = 0; x < w; x++) {
+			src[x * 3] = x * 64 / w;
+			src[x * 3 + 1] = x * 48 / w;
+			src[x * 3 + 2] = x * 32 / w;
+		}
+		ColorConvert::FromRGB888(dst.data(), src.data(), w, (y < h) ? 0 : TFT_COLOR_DITHER, 0, y);
+		for (int x = 0; x < w; x++) {
+			uint16_t c = dst[x];
+			uint8_t rgb[3] = {(uint8_t)((c >> 11) * 255 / 31), (uint8_t)(((c >> 5) & 0x3F) * 255 / 63), (uint8_t)((c & 0x1F) * 255 / 31)};
+			fwrite(rgb, 1, 3, f);
+		}
+	}
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t pixels = 160, repeat = 200000;
+	const char *gradient = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--pixels") == 0 && i + 1 < argc) {
+			pixels = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			repeat = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--gradient") == 0 && i + 1 < argc) {
+			gradient = argv[++i];
+		} else {
+			fatal("unknown option %s", argv[i]);
+		}
+	}
+	if (pixels == 0 || repeat == 0) fatal("--pixels and --repeat must be positive");
+
+	const Case cases[] = {
+		{"scalar Color565 RGB888", scalarRGB888, TFT_PIXEL_RGB888, TFT_COLOR_PANEL_ORDER},
+		{"RGB888", ColorConvert::FromRGB888, TFT_PIXEL_RGB888, 0},
+		{"RGB888 panel", ColorConvert::FromRGB888, TFT_PIXEL_RGB888, TFT_COLOR_PANEL_ORDER},
+		{"RGB888 panel dither", ColorConvert::FromRGB888, TFT_PIXEL_RGB888, TFT_COLOR_PANEL_ORDER | TFT_COLOR_DITHER},
+		{"BGR888 panel", ColorConvert::FromBGR888, TFT_PIXEL_BGR888, TFT_COLOR_PANEL_ORDER},
+		{"BGR888 panel dither", ColorConvert::FromBGR888, TFT_PIXEL_BGR888, TFT_COLOR_PANEL_ORDER | TFT_COLOR_DITHER},
+		{"ARGB8888 panel", ColorConvert::FromARGB8888, TFT_PIXEL_ARGB8888, TFT_COLOR_PANEL_ORDER},
+		{"ARGB8888 panel dither", ColorConvert::FromARGB8888, TFT_PIXEL_ARGB8888, TFT_COLOR_PANEL_ORDER | TFT_COLOR_DITHER},
+		{"GRAY8", ColorConvert::FromGray8, TFT_PIXEL_GRAY8, 0},
+		{"GRAY8 panel", ColorConvert::FromGray8, TFT_PIXEL_GRAY8, TFT_COLOR_PANEL_ORDER},
+		{"GRAY8 panel dither", ColorConvert::FromGray8, TFT_PIXEL_GRAY8, TFT_COLOR_PANEL_ORDER | TFT_COLOR_DITHER},
+	};
+	printf("%u pixels x %u\n", pixels, repeat);
+	for (const Case &c : cases) {
+		verify(c);
+		printf("%-24s %8.1f Mpixels/s\n", c.name, measure(c, pixels, repeat) / 1e6);
+	}
+	if (gradient) writeGradient(gradient);
+	return 0;
+}
@@ -0,0 +1,53 @@
+#!/bin/sh
+# フォントのデータがフラッシュ/RAMをどれだけ使っているかを、漢字フォントの設定ごとに表示する。
+#
+# 使い方:
+#   CXXFLAGS="-I<pico-sdkのインクルードパス>..." tools/fontsize.sh [dot...]
+#
+#   CXX      使用するコンパイラ（既定値: arm-none-eabi-g++ があればそれ、なければ g++）
+#   SIZE     使用するsizeコマンド（既定値: CXXに対応するsize）
+#   NM       使用するnmコマンド（既定値: CXXに対応するnm）
+#   CXXFLAGS 追加のコンパイルオプション。pico-sdkのヘッダ(hardware/spi.h等)が見えるようにする。
+#            -DTFT_KANJI_COMPRESSED を加えると、圧縮したテーブルの大きさを表示する。
+#
+# 出力の flash は .text/.rodata/.flashdata/.data の合計、ram は .data/.bss の合計（.data.rel.roは除く。オブジェクトファイル単位、リンク前）。
+# defs は漢字テーブル/Font/FreeMono* の各データが、いくつのオブジェクトファイルで定義されているかの最大値。1 であれば重複していない。
+
+cd "$(dirname "$0")/.." || exit 1
+
+if [ -z "$CXX" ]; then
+	if command -v arm-none-eabi-g++ >/dev/null 2>&1; then
+		CXX=arm-none-eabi-g++
+		CXXFLAGS="-mcpu=cortex-m0plus -mthumb $CXXFLAGS"
+	else
+		CXX=g++
+	fi
+fi
+PREFIX=$(echo "$CXX" | sed -n 's/g++$//p')
+SIZE=${SIZE:-${PREFIX}size}
+NM=${NM:-${PREFIX}nm}
+DOTS=${*:-"16 12 8"}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+SOURCES="src/ST7735_TFT.cpp src/KanjiHelper.cpp src/ST7735_fonts.cpp"
+
+printf '%-4s %-6s %10s %8s %5s\n' dot level flash ram defs
+for dot in $DOTS; do
+	for level in 0 1 2 3; do
+		objs=""
+		for src in $SOURCES; do
+			obj="$OUT/$(basename "$src" .cpp).o"
+			$CXX -std=gnu++17 -Os -ffunction-sections -fdata-sections -w $CXXFLAGS -Iinclude \
+				-DTFT_KANJI_DOT=$dot -DTFT_KANJI_LEVEL=$level -c "$src" -o "$obj" || exit 1
+			objs="$objs $obj"
+		done
+		sizes=$($SIZE -A $objs | awk '
+			$1 ~ /^\.(text|rodata|flashdata|data)/ { flash += $2 }
+			$1 ~ /^\.(data|bss)/ && $1 !~ /^\.data\.rel\.ro/ { ram += $2 }
+			END { print flash, ram }')
+		defs=$($NM $objs | awk '$2 ~ /^[RrDd]$/ && $3 ~ /(Kanji|Font|FreeMono)/ { n[$3]++ }
+			END { m = 0; for (s in n) if (n[s] > m) m = n[s]; print m }')
+		printf '%-4s %-6s %10s %8s %5s\n' $dot $level $sizes $defs
+	done
+done
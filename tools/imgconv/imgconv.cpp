@@ -0,0 +1,678 @@
+/**
+ * @file imgconv.cpp
+ * @brief 画像ファイルを、ST7735::drawImageで表示できる形式（ST7735_struct.hのTFTImage）に変換するホスト用のツール。
+ * @details bmpDrawで使うuint16_tの配列はCPUのバイト順なので、送るときに１画素ずつ上位と下位を入れ替える必要がある。
+ * このツールが出力するTFT_IMAGE_RGB565の画像は、液晶に送る順（上位、下位）にバイトを並べてあるので、drawImageはそのまま送るだけで済む。<br/>
+ * 読み込めるのは、無圧縮のBMP（24/32ビット）、バイナリのPPM（P6）と、bmpDraw用のuint16_tの配列（"0x0821,..." の並び）。
+ *
+ *     g++ -std=gnu++17 -O2 -o imgconv tools/imgconv/imgconv.cpp
+ *
+ * 使い方:
+ *
+ *     imgconv [オプション] <画像名> <入力ファイル> [<画像名> <入力ファイル>...]
+ *         -o <出力.inc>        出力先（既定値は標準出力）
+ *         --array <幅>x<高さ>  入力ファイルを、bmpDraw用のuint16_tの配列として読む
+ *         --native             TFTImageではなく、bmpDraw用のuint16_tの配列（CPUのバイト順）を出力する
+ *         --rle                ランレングス圧縮した画像（TFT_IMAGE_RLE）を出力する
+ *         --indexed            パレット形式の画像（TFT_IMAGE_INDEXED1～8）を出力する。ビット数は色数から決める
+ *         --bpp <1|2|4|8>      パレット形式の画像の、１画素のビット数を指定する
+ *         --verify             変換した画像を展開し、元の画像と一致することを確かめる
+ *
+ *     imgconv --anim [オプション] <名前> <フレーム1> <フレーム2> ...
+ *         --fps <数>           フレームの速さ（既定値は10）
+ *         --loop               最後のフレームから最初のフレームに戻る差分フレームを加える
+ *         --tile <画素数>      変わった部分を探す升目の大きさ（既定値は8）
+ *         --spi <MHz>          SPIのクロック。この速さで送ったときのフレームレートを表示する（既定値は10）
+ *         --indexed            全フレームの色が256色以下なら、パレット形式の矩形も使う
+ *
+ * 出力した.incは、アプリケーションのソースで１か所だけインクルードし、tft.drawImage(x, y, &画像名) で表示する。
+ * --animで変換したアニメーション（TFTAnimation）は、AnimationPlayerで再生する。<br/>
+ * アニメーションは、最初のフレームを画像全体で、以後のフレームを前のフレームから変わった矩形だけで持つ。
+ * 矩形は升目の単位で探して隣り合うものをまとめ、変わった画素を囲む大きさに縮める。
+ * 矩形ごとに、そのまま、ランレングス圧縮、パレット形式のうち最も小さいものを選ぶ。
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../../include/ST7735_struct.h"
+
+/// @brief 読み込んだ画像。RGB565の値を１画素１要素で持つ
+struct Image {
+	uint16_t width = 0;
+	uint16_t height = 0;
+	std::vector<uint16_t> pixels;
+};
+
+static void fatal(const char *fmt, const char *arg = "")
+{
+	fprintf(stderr, "imgconv: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static uint16_t color565(uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+static std::vector<uint8_t> readFile(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) fatal("cannot open %s", path);
+	std::vector<uint8_t> data;
+	uint8_t buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+	fclose(f);
+	return data;
+}
+
+static uint32_t le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+/// @brief 無圧縮のBMP（24/32ビット）を読む
+static Image readBmp(const char *path, const std::vector<uint8_t> &data)
+{
+	if (data.size() < 54) fatal("%s: not a BMP file", path);
+	uint32_t offset = le32(&data[10]);
+	int32_t w = (int32_t)le32(&data[18]);
+	int32_t h = (int32_t)le32(&data[22]);
+	uint16_t depth = le16(&data[28]);
+	uint32_t compression = le32(&data[30]);
+	if ((depth != 24 && depth != 32) || (compression != 0 && compression != 3)) fatal("%s: only uncompressed 24/32-bit BMP is supported", path);
+	bool bottomUp = h > 0;
+	if (h < 0) h = -h;
+	if (w <= 0 || w > 0xFFFF || h > 0xFFFF) fatal("%s: invalid size", path);
+	uint32_t rowBytes = ((uint32_t)w * depth / 8 + 3) & ~3u;
+	if (offset + rowBytes * h > data.size()) fatal("%s: truncated", path);
+
+	Image image;
+	image.width = w;
+	image.height = h;
+	image.pixels.resize((size_t)w * h);
+	for (int32_t y = 0; y < h; y++) {
+		const uint8_t *row = &data[offset + rowBytes * (bottomUp ? h - 1 - y : y)];
+		for (int32_t x = 0; x < w; x++) {
+			const uint8_t *p = row + x * (depth / 8);
+			image.pixels[(size_t)y * w + x] = color565(p[2], p[1], p[0]);
+		}
+	}
+	return image;
+}
+
+/// @brief PPMのヘッダの、次の数値を読む（コメントは飛ばす）
+static uint32_t ppmNumber(const std::vector<uint8_t> &data, size_t *pos)
+{
+	while (*pos < data.size()) {
+		if (data[*pos] == '#') {
+			while (*pos < data.size() && data[*pos] != '\n') (*pos)++;
+		} else if (data[*pos] <= ' ') {
+			(*pos)++;
+		} else {
+			break;
+		}
+	}
+	uint32_t n = 0;
+	while (*pos < data.size() && data[*pos] >= '0' && data[*pos] <= '9') n = n * 10 + (data[(*pos)++] - '0');
+	return n;
+}
+
+/// @brief バイナリのPPM（P6、最大値255）を読む
+static Image readPpm(const char *path, const std::vector<uint8_t> &data)
+{
+	size_t pos = 2;
+	uint32_t w = ppmNumber(data, &pos);
+	uint32_t h = ppmNumber(data, &pos);
+	uint32_t maxval = ppmNumber(data, &pos);
+	pos++;  // ヘッダの後の空白１文字
+	if (w == 0 || h == 0 || w > 0xFFFF || h > 0xFFFF || maxval != 255) fatal("%s: unsupported PPM", path);
+	if (pos + (size_t)w * h * 3 > data.size()) fatal("%s: truncated", path);
+
+	Image image;
+	image.width = w;
+	image.height = h;
+	image.pixels.resize((size_t)w * h);
+	for (size_t i = 0; i < image.pixels.size(); i++, pos += 3) {
+		image.pixels[i] = color565(data[pos], data[pos + 1], data[pos + 2]);
+	}
+	return image;
+}
+
+/// @brief bmpDraw用のuint16_tの配列（"{0x0821,0x0821,...}"）を読む。最初の'{'から'}'までの数値を並べる
+static Image readArray(const char *path, const std::vector<uint8_t> &data, uint16_t w, uint16_t h)
+{
+	std::string text(data.begin(), data.end());
+	size_t begin = text.find('{');
+	size_t end = text.find('}', begin);
+	if (begin == std::string::npos || end == std::string::npos) fatal("%s: no {...} array found", path);
+
+	Image image;
+	image.width = w;
+	image.height = h;
+	const char *p = text.c_str() + begin + 1;
+	const char *last = text.c_str() + end;
+	while (p < last) {
+		char *next;
+		unsigned long v = strtoul(p, &next, 0);
+		if (next == p) {
+			p++;
+			continue;
+		}
+		image.pixels.push_back((uint16_t)v);
+		p = next;
+	}
+	if (image.pixels.size() != (size_t)w * h) fatal("%s: the number of pixels does not match the size", path);
+	return image;
+}
+
+static Image readImage(const char *path, bool array, uint16_t w, uint16_t h)
+{
+	std::vector<uint8_t> data = readFile(path);
+	if (array) return readArray(path, data, w, h);
+	if (data.size() >= 2 && data[0] == 'B' && data[1] == 'M') return readBmp(path, data);
+	if (data.size() >= 2 && data[0] == 'P' && data[1] == '6') return readPpm(path, data);
+	fatal("%s: unknown image format (BMP or PPM(P6) is supported)", path);
+	return Image();
+}
+
+/// @brief バイト列をCの配列として出力する
+static void writeBytes(FILE *out, const std::vector<uint8_t> &data)
+{
+	for (size_t i = 0; i < data.size(); i++) fprintf(out, "%s0x%02X,", (i % 16 == 0) ? "\n" : "", data[i]);
+	fprintf(out, "\n};\n");
+}
+
+/// @brief TFT_IMAGE_RLEの形式に圧縮する。２画素以上同じ色が続けば繰り返し、それ以外はそのままのパケットにする
+static std::vector<uint8_t> encodeRle(const Image &image)
+{
+	const std::vector<uint16_t> &px = image.pixels;
+	std::vector<uint8_t> data;
+	size_t i = 0;
+	while (i < px.size()) {
+		size_t run = 1;
+		while (i + run < px.size() && run < 128 && px[i + run] == px[i]) run++;
+		if (run >= 2) {
+			data.push_back(0x80 | (run - 1));
+			data.push_back(px[i] >> 8);
+			data.push_back(px[i] & 0xFF);
+			i += run;
+			continue;
+		}
+		// 次に同じ色が２つ続くところまでを、そのままのパケットにする
+		size_t n = 1;
+		while (i + n < px.size() && n < 128 && !(i + n + 1 < px.size() && px[i + n] == px[i + n + 1])) n++;
+		data.push_back(n - 1);
+		for (size_t k = 0; k < n; k++) {
+			data.push_back(px[i + k] >> 8);
+			data.push_back(px[i + k] & 0xFF);
+		}
+		i += n;
+	}
+	return data;
+}
+
+/// @brief TFT_IMAGE_RLEを、drawRLEと同じTFTRleReaderで展開する。--verifyで使う
+static std::vector<uint16_t> decodeRle(const std::vector<uint8_t> &data, size_t count)
+{
+	std::vector<uint16_t> px;
+	TFTRleReader reader = {data.data(), false, 0};
+	const uint8_t *end = data.data() + data.size();
+	while (px.size() < count) {
+		// パケットの先頭（新しいパケットのとき）と、１画素分の色がデータの中にあること
+		if (reader.p + (reader.left == 0 ? 3 : 2) > end) fatal("RLE data is truncated");
+		uint8_t c[2];
+		reader.next(c);
+		px.push_back((c[0] << 8) | c[1]);
+	}
+	if (reader.left != 0 || reader.p != end) fatal("RLE data does not end at the last pixel");
+	return px;
+}
+
+/// @brief TFTImage（TFT_IMAGE_RGB565 / TFT_IMAGE_RLE、液晶に送る順）として出力する
+static void writeImage(FILE *out, const char *name, const Image &image, bool rle, bool verify)
+{
+	std::vector<uint8_t> data;
+	if (rle) {
+		data = encodeRle(image);
+		if (verify && decodeRle(data, image.pixels.size()) != image.pixels) fatal("%s: RLE round trip failed", name);
+		fprintf(stderr, "imgconv: %s: %zu -> %zu bytes\n", name, image.pixels.size() * 2, data.size());
+	} else {
+		for (uint16_t c : image.pixels) {
+			data.push_back(c >> 8);
+			data.push_back(c & 0xFF);
+		}
+	}
+	const char *format = rle ? "TFT_IMAGE_RLE" : "TFT_IMAGE_RGB565";
+	fprintf(out, "// %dx%d %s\n", image.width, image.height, rle ? "RGB565 RLE" : "RGB565");
+	fprintf(out, "static const uint8_t %s_data[%zu] TFT_FLASH_DATA(\"image\") = {", name, data.size());
+	writeBytes(out, data);
+	fprintf(out, "static const TFTImage %s = {%d, %d, %s, %s_data};\n\n", name, image.width, image.height, format, name);
+}
+
+/// @brief パレットの番号を、各行をバイト単位に揃えて、MSBから順に詰める
+static std::vector<uint8_t> packIndexed(const std::vector<uint8_t> &index, size_t width, size_t height, uint8_t bpp)
+{
+	size_t rowBytes = (width * bpp + 7) / 8;
+	std::vector<uint8_t> data(rowBytes * height, 0);
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			size_t bit = x * bpp;
+			data[y * rowBytes + bit / 8] |= index[y * width + x] << (8 - bpp - bit % 8);
+		}
+	}
+	return data;
+}
+
+/// @brief packIndexedで詰めた番号を、色に戻す。--verifyで使う
+static std::vector<uint16_t> unpackIndexed(const std::vector<uint8_t> &data, size_t width, size_t height, uint8_t bpp,
+	const std::vector<uint16_t> &palette)
+{
+	size_t rowBytes = (width * bpp + 7) / 8;
+	std::vector<uint16_t> px;
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			size_t bit = x * bpp;
+			px.push_back(palette[(data[y * rowBytes + bit / 8] >> (8 - bpp - bit % 8)) & ((1 << bpp) - 1)]);
+		}
+	}
+	return px;
+}
+
+/// @brief パレット形式（TFT_IMAGE_INDEXED1～8）で出力する。パレットの色は、画像に出てくる順に並べる
+/// @param bpp １画素のビット数。0なら色数から決める
+static void writeIndexed(FILE *out, const char *name, const Image &image, uint8_t bpp, bool verify)
+{
+	std::vector<uint16_t> palette;
+	std::vector<uint8_t> index;
+	for (uint16_t c : image.pixels) {
+		size_t i = 0;
+		while (i < palette.size() && palette[i] != c) i++;
+		if (i == palette.size()) {
+			if (palette.size() == 256) fatal("%s: more than 256 colors", name);
+			palette.push_back(c);
+		}
+		index.push_back(i);
+	}
+	uint8_t need = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : palette.size() <= 16 ? 4 : 8;
+	if (bpp == 0) bpp = need;
+	if (bpp < need) fatal("%s: too many colors for the specified --bpp", name);
+	size_t used = palette.size();
+	palette.resize(1 << bpp, 0);
+
+	std::vector<uint8_t> data = packIndexed(index, image.width, image.height, bpp);
+	if (verify && unpackIndexed(data, image.width, image.height, bpp, palette) != image.pixels) fatal("%s: indexed round trip failed", name);
+	fprintf(stderr, "imgconv: %s: %zu colors, %d bpp, %zu -> %zu bytes\n", name, used, bpp, image.pixels.size() * 2,
+		data.size() + palette.size() * 2);
+
+	fprintf(out, "// %dx%d %d bpp indexed\n", image.width, image.height, bpp);
+	fprintf(out, "static const uint16_t %s_palette[%zu] TFT_FLASH_DATA(\"image\") = {", name, palette.size());
+	for (size_t i = 0; i < palette.size(); i++) fprintf(out, "%s0x%04X,", (i % 16 == 0) ? "\n" : "", palette[i]);
+	fprintf(out, "\n};\n");
+	fprintf(out, "static const uint8_t %s_data[%zu] TFT_FLASH_DATA(\"image\") = {", name, data.size());
+	writeBytes(out, data);
+	fprintf(out, "static const TFTImage %s = {%d, %d, TFT_IMAGE_INDEXED%d, %s_data, %s_palette};\n\n",
+		name, image.width, image.height, bpp, name, name);
+}
+
+/// @brief bmpDraw用のuint16_tの配列として出力する
+static void writeNative(FILE *out, const char *name, const Image &image)
+{
+	fprintf(out, "// %dx%d, bmpDraw(x, y, %d, %d, (uint16_t *)%s, 0)\n", image.width, image.height, image.width, image.height, name);
+	fprintf(out, "static const uint16_t %s[%zu] = {", name, image.pixels.size());
+	for (size_t i = 0; i < image.pixels.size(); i++) fprintf(out, "%s0x%04X,", (i % 16 == 0) ? "\n" : "", image.pixels[i]);
+	fprintf(out, "\n};\n\n");
+}
+
+// TFTImageの画素の形式（ST7735_struct.hと同じ値）
+#define FORMAT_RGB565 0
+#define FORMAT_RLE 1
+#define FORMAT_INDEXED1 2
+
+/// @brief アニメーションの矩形の、SPIで送るバイト数のうち画素以外の分（アドレスウインドウの設定のコマンドとデータ）
+#define WINDOW_OVERHEAD_BYTES 11
+
+/// @brief アニメーションの変換の設定
+struct AnimOptions {
+	unsigned fps = 10;
+	unsigned tile = 8;
+	double spiMHz = 10;
+	bool loop = false;
+	bool indexed = false;
+	bool verify = false;
+};
+
+/// @brief 矩形
+struct Rect {
+	uint16_t x, y, w, h;
+};
+
+/// @brief 画像の矩形の部分を切り出す
+static Image subImage(const Image &image, const Rect &r)
+{
+	Image sub;
+	sub.width = r.w;
+	sub.height = r.h;
+	for (int y = r.y; y < r.y + r.h; y++) {
+		const uint16_t *row = &image.pixels[(size_t)y * image.width];
+		sub.pixels.insert(sub.pixels.end(), row + r.x, row + r.x + r.w);
+	}
+	return sub;
+}
+
+/// @brief 前のフレームから変わった画素を含む矩形を求める
+/// @details 升目ごとに変わったかを調べ、横に続く升目を１つにし、同じ幅で縦に続くものをまとめる。
+/// 最後に、それぞれの矩形を変わった画素を囲む大きさに縮める。
+static std::vector<Rect> changedRects(const Image &prev, const Image &cur, unsigned tile)
+{
+	size_t tilesX = (cur.width + tile - 1) / tile, tilesY = (cur.height + tile - 1) / tile;
+	std::vector<bool> changed(tilesX * tilesY, false);
+	for (size_t y = 0; y < cur.height; y++) {
+		for (size_t x = 0; x < cur.width; x++) {
+			if (prev.pixels[y * cur.width + x] != cur.pixels[y * cur.width + x]) changed[(y / tile) * tilesX + x / tile] = true;
+		}
+	}
+
+	// 升目の単位の矩形（x0..x1, y0..y1、終わりを含む）
+	struct TileRect {
+		size_t x0, x1, y0, y1;
+	};
+	std::vector<TileRect> done, open;
+	for (size_t ty = 0; ty < tilesY; ty++) {
+		std::vector<TileRect> next;
+		for (size_t tx = 0; tx < tilesX; tx++) {
+			if (!changed[ty * tilesX + tx]) continue;
+			size_t end = tx;
+			while (end + 1 < tilesX && changed[ty * tilesX + end + 1]) end++;
+			TileRect r = {tx, end, ty, ty};
+			for (size_t i = 0; i < open.size(); i++) {
+				if (open[i].x0 == tx && open[i].x1 == end) {
+					r.y0 = open[i].y0;
+					open.erase(open.begin() + i);
+					break;
+				}
+			}
+			next.push_back(r);
+			tx = end;
+		}
+		done.insert(done.end(), open.begin(), open.end());
+		open = next;
+	}
+	done.insert(done.end(), open.begin(), open.end());
+
+	std::vector<Rect> rects;
+	for (const TileRect &t : done) {
+		size_t x0 = cur.width, y0 = cur.height, x1 = 0, y1 = 0;
+		size_t xEnd = std::min<size_t>((t.x1 + 1) * tile, cur.width), yEnd = std::min<size_t>((t.y1 + 1) * tile, cur.height);
+		for (size_t y = t.y0 * tile; y < yEnd; y++) {
+			for (size_t x = t.x0 * tile; x < xEnd; x++) {
+				if (prev.pixels[y * cur.width + x] == cur.pixels[y * cur.width + x]) continue;
+				x0 = std::min(x0, x);
+				x1 = std::max(x1, x);
+				y0 = std::min(y0, y);
+				y1 = std::max(y1, y);
+			}
+		}
+		rects.push_back({(uint16_t)x0, (uint16_t)y0, (uint16_t)(x1 - x0 + 1), (uint16_t)(y1 - y0 + 1)});
+	}
+	return rects;
+}
+
+/// @brief アニメーションの矩形を、そのまま、ランレングス圧縮、パレット形式のうち最も小さい形式にする
+/// @param palette 全フレームのパレット。空ならパレット形式は使わない
+/// @param format 選んだ形式
+static std::vector<uint8_t> encodeRect(const Image &image, const std::vector<uint16_t> &palette, uint8_t bpp, uint8_t *format)
+{
+	std::vector<uint8_t> best;
+	for (uint16_t c : image.pixels) {
+		best.push_back(c >> 8);
+		best.push_back(c & 0xFF);
+	}
+	*format = FORMAT_RGB565;
+	std::vector<uint8_t> rle = encodeRle(image);
+	if (rle.size() < best.size()) {
+		best = rle;
+		*format = FORMAT_RLE;
+	}
+	if (!palette.empty()) {
+		std::vector<uint8_t> index;
+		for (uint16_t c : image.pixels) index.push_back(std::find(palette.begin(), palette.end(), c) - palette.begin());
+		std::vector<uint8_t> packed = packIndexed(index, image.width, image.height, bpp);
+		if (packed.size() < best.size()) {
+			best = packed;
+			*format = FORMAT_INDEXED1 + (bpp == 1 ? 0 : bpp == 2 ? 1 : bpp == 4 ? 2 : 3);
+		}
+	}
+	return best;
+}
+
+/// @brief encodeRectの結果を画素に戻す。--verifyで使う
+static std::vector<uint16_t> decodeRect(const std::vector<uint8_t> &data, uint8_t format, const Rect &r, const std::vector<uint16_t> &palette)
+{
+	size_t count = (size_t)r.w * r.h;
+	if (format == FORMAT_RLE) return decodeRle(data, count);
+	if (format >= FORMAT_INDEXED1) return unpackIndexed(data, r.w, r.h, 1 << (format - FORMAT_INDEXED1), palette);
+	std::vector<uint16_t> px;
+	for (size_t i = 0; i + 1 < data.size(); i += 2) px.push_back((data[i] << 8) | data[i + 1]);
+	return px;
+}
+
+static void put16(std::vector<uint8_t> &data, uint16_t v)
+{
+	data.push_back(v & 0xFF);
+	data.push_back(v >> 8);
+}
+
+static void put32(std::vector<uint8_t> &data, uint32_t v)
+{
+	put16(data, v & 0xFFFF);
+	put16(data, v >> 16);
+}
+
+/// @brief prevからcurへの差分フレームを、dataに加える（prevが空ならキーフレーム）
+/// @param canvas --verifyのとき、矩形を展開して描く画像
+/// @return SPIで送るバイト数
+static size_t appendFrame(std::vector<uint8_t> &data, const Image *prev, const Image &cur, uint16_t duration,
+	const std::vector<uint16_t> &palette, uint8_t bpp, const AnimOptions &options, Image &canvas, size_t *rectCount)
+{
+	std::vector<Rect> rects = prev ? changedRects(*prev, cur, options.tile) : std::vector<Rect>{{0, 0, cur.width, cur.height}};
+	put16(data, duration);
+	put16(data, rects.size());
+	size_t spiBytes = 0;
+	for (const Rect &r : rects) {
+		uint8_t format;
+		std::vector<uint8_t> payload = encodeRect(subImage(cur, r), palette, bpp, &format);
+		put16(data, r.x);
+		put16(data, r.y);
+		put16(data, r.w);
+		put16(data, r.h);
+		data.push_back(format);
+		put32(data, payload.size());
+		data.insert(data.end(), payload.begin(), payload.end());
+		spiBytes += WINDOW_OVERHEAD_BYTES + (size_t)r.w * r.h * 2;
+		if (options.verify) {
+			std::vector<uint16_t> px = decodeRect(payload, format, r, palette);
+			if (px.size() != (size_t)r.w * r.h) fatal("animation round trip failed");
+			for (size_t y = 0; y < r.h; y++) {
+				std::copy(px.begin() + y * r.w, px.begin() + (y + 1) * r.w, canvas.pixels.begin() + (r.y + y) * canvas.width + r.x);
+			}
+		}
+	}
+	if (options.verify && canvas.pixels != cur.pixels) fatal("animation round trip failed");
+	*rectCount = rects.size();
+	return spiBytes;
+}
+
+/// @brief フレームの並びを、TFTAnimationとして出力する。SPIで送るバイト数から、フレームレートの上限を表示する
+static void writeAnimation(FILE *out, const char *name, const std::vector<Image> &frames, const AnimOptions &options)
+{
+	const Image &first = frames[0];
+	for (const Image &f : frames) {
+		if (f.width != first.width || f.height != first.height) fatal("%s: all frames must have the same size", name);
+	}
+
+	// 全フレームの色が256色以下なら、パレット形式の矩形も使えるようにする
+	std::vector<uint16_t> palette;
+	uint8_t bpp = 0;
+	if (options.indexed) {
+		for (const Image &f : frames) {
+			for (uint16_t c : f.pixels) {
+				if (std::find(palette.begin(), palette.end(), c) != palette.end()) continue;
+				if (palette.size() == 256) fatal("%s: more than 256 colors; remove --indexed", name);
+				palette.push_back(c);
+			}
+		}
+		bpp = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : palette.size() <= 16 ? 4 : 8;
+		palette.resize(1 << bpp, 0);
+	}
+
+	uint16_t duration = (1000 + options.fps / 2) / options.fps;
+	double bytesPerMs = options.spiMHz * 1000 / 8;
+	double budget = duration, worst = 0, total = 0;
+	size_t worstFrame = 0, over = 0;
+	std::vector<uint8_t> data;
+	Image canvas = first;
+	for (size_t i = 0; i < frames.size(); i++) {
+		size_t rects;
+		size_t spi = appendFrame(data, i ? &frames[i - 1] : NULL, frames[i], duration, palette, bpp, options, canvas, &rects);
+		double ms = spi / bytesPerMs;
+		if (i > 0) {
+			total += ms;
+			if (ms > worst) {
+				worst = ms;
+				worstFrame = i;
+			}
+			if (ms > budget) over++;
+		}
+		fprintf(stderr, "imgconv: %s: frame %zu: %zu rects, %zu bytes to send, %.2f ms\n", name, i, rects, spi, ms);
+	}
+	uint32_t loopOffset = 0;
+	if (options.loop && frames.size() > 1) {
+		loopOffset = data.size();
+		size_t rects;
+		size_t spi = appendFrame(data, &frames.back(), first, duration, palette, bpp, options, canvas, &rects);
+		fprintf(stderr, "imgconv: %s: loop frame: %zu rects, %zu bytes to send, %.2f ms\n", name, rects, spi, spi / bytesPerMs);
+	}
+
+	size_t raw = frames.size() * first.pixels.size() * 2;
+	fprintf(stderr, "imgconv: %s: %zu frames, %zu -> %zu bytes\n", name, frames.size(), raw, data.size() + palette.size() * 2);
+	if (frames.size() > 1) {
+		double average = total / (frames.size() - 1);
+		fprintf(stderr, "imgconv: %s: at %.1f MHz SPI: average %.1f fps, slowest frame %zu %.1f fps (target %u fps, %zu frames over budget)\n",
+			name, options.spiMHz, average > 0 ? 1000 / average : 0.0, worstFrame, worst > 0 ? 1000 / worst : 0.0, options.fps, over);
+	}
+
+	fprintf(out, "// %dx%d, %zu frames animation, AnimationPlayer\n", first.width, first.height, frames.size());
+	if (!palette.empty()) {
+		fprintf(out, "static const uint16_t %s_palette[%zu] TFT_FLASH_DATA(\"image\") = {", name, palette.size());
+		for (size_t i = 0; i < palette.size(); i++) fprintf(out, "%s0x%04X,", (i % 16 == 0) ? "\n" : "", palette[i]);
+		fprintf(out, "\n};\n");
+	}
+	fprintf(out, "static const uint8_t %s_data[%zu] TFT_FLASH_DATA(\"image\") = {", name, data.size());
+	writeBytes(out, data);
+	fprintf(out, "static const TFTAnimation %s = {%d, %d, %zu, %u, %s_data, %s%s};\n\n", name, first.width, first.height,
+		frames.size(), loopOffset, name, palette.empty() ? "NULL" : name, palette.empty() ? "" : "_palette");
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage:\n"
+		"  imgconv [options] <name> <file> [<name> <file>...]\n"
+		"options:\n"
+		"  -o <output.inc>        write to a file instead of stdout\n"
+		"  --array <w>x<h>        read the input as a uint16_t array for bmpDraw\n"
+		"  --native               write a uint16_t array for bmpDraw instead of a TFTImage\n"
+		"  --rle                  write a run-length encoded TFTImage (TFT_IMAGE_RLE)\n"
+		"  --indexed              write a palette-indexed TFTImage (TFT_IMAGE_INDEXED1-8)\n"
+		"  --bpp <1|2|4|8>        bits per pixel of an indexed image (default: fewest that fit)\n"
+		"  --verify               decode the encoded image and check it against the input\n"
+		"  imgconv --anim [options] <name> <frame> [<frame>...]\n"
+		"options:\n"
+		"  --fps <n>              frame rate (default: 10)\n"
+		"  --loop                 add a delta frame from the last frame back to the first\n"
+		"  --tile <n>             tile size used to find changed areas (default: 8)\n"
+		"  --spi <MHz>            SPI clock used to estimate the frame rate (default: 10)\n"
+		"  --indexed              also use palette-indexed rectangles when there are 256 colors or less\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *output = NULL;
+	bool array = false, native = false, rle = false, indexed = false, verify = false;
+	unsigned bpp = 0;
+	unsigned arrayW = 0, arrayH = 0;
+	bool anim = false;
+	AnimOptions animOptions;
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "--array") == 0 && i + 1 < argc) {
+			array = true;
+			if (sscanf(argv[++i], "%ux%u", &arrayW, &arrayH) != 2 || arrayW == 0 || arrayH == 0) usage();
+		} else if (strcmp(argv[i], "--native") == 0) {
+			native = true;
+		} else if (strcmp(argv[i], "--rle") == 0) {
+			rle = true;
+		} else if (strcmp(argv[i], "--indexed") == 0) {
+			indexed = true;
+		} else if (strcmp(argv[i], "--bpp") == 0 && i + 1 < argc) {
+			indexed = true;
+			bpp = atoi(argv[++i]);
+			if (bpp != 1 && bpp != 2 && bpp != 4 && bpp != 8) usage();
+		} else if (strcmp(argv[i], "--verify") == 0) {
+			verify = true;
+		} else if (strcmp(argv[i], "--anim") == 0) {
+			anim = true;
+		} else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			animOptions.fps = atoi(argv[++i]);
+			if (animOptions.fps < 1 || animOptions.fps > 1000) usage();
+		} else if (strcmp(argv[i], "--loop") == 0) {
+			animOptions.loop = true;
+		} else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+			animOptions.tile = atoi(argv[++i]);
+			if (animOptions.tile < 1) usage();
+		} else if (strcmp(argv[i], "--spi") == 0 && i + 1 < argc) {
+			animOptions.spiMHz = atof(argv[++i]);
+			if (animOptions.spiMHz <= 0) usage();
+		} else if (argv[i][0] == '-') {
+			usage();
+		} else {
+			args.push_back(argv[i]);
+		}
+	}
+	if (args.size() < 2 || (!anim && args.size() % 2 != 0)) usage();
+
+	FILE *out = output ? fopen(output, "w") : stdout;
+	if (out == NULL) fatal("cannot create %s", output);
+	fprintf(out, "#pragma once\n");
+	fprintf(out, "// generated by tools/imgconv\n");
+	if (anim) {
+		std::vector<Image> frames;
+		for (size_t i = 1; i < args.size(); i++) frames.push_back(readImage(args[i].c_str(), array, arrayW, arrayH));
+		animOptions.indexed = indexed;
+		animOptions.verify = verify;
+		writeAnimation(out, args[0].c_str(), frames, animOptions);
+	}
+	for (size_t i = 0; !anim && i < args.size(); i += 2) {
+		const char *name = args[i].c_str();
+		Image image = readImage(args[i + 1].c_str(), array, arrayW, arrayH);
+		if (native) {
+			writeNative(out, name, image);
+		} else if (indexed) {
+			writeIndexed(out, name, image, bpp, verify);
+		} else {
+			writeImage(out, name, image, rle, verify);
+		}
+	}
+	if (output) fclose(out);
+	return 0;
+}
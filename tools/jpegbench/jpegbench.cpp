@@ -0,0 +1,199 @@
+/**
+ * @file jpegbench.cpp
+ * @brief JPEGDecoderを、ホストで動かして確かめるツール。
+ * @details ライブラリと同じ src/JPEGDecoder.cpp でJPEGを展開し、展開にかかった時間を表示する。
+ * 展開した画像はPPM（P6）で保存でき、参照の画像（他のデコーダで展開したPPM）を指定すると、PSNRを表示する。
+ * 出力はRGB565なので、参照の画像もRGB565に丸めてから比べる。
+ *
+ *     g++ -std=gnu++17 -O2 -DTFT_HOST_TOOL -o jpegbench tools/jpegbench/jpegbench.cpp src/JPEGDecoder.cpp src/ImageStream.cpp src/ColorConvert.cpp
+ *
+ * 使い方:
+ *
+ *     jpegbench [オプション] <入力.jpg>
+ *         -o <出力.ppm>        展開した画像を保存する
+ *         --scale <1|2|4|8>    縮小率（既定値は1）
+ *         --ref <参照.ppm>     参照の画像と比べ、PSNRを表示する（--scaleと同じ大きさの画像）
+ *         --repeat <回数>      展開を繰り返し、１回あたりの時間を表示する（既定値は10）
+ *         --chunk <バイト数>   メモリから直接ではなく、読み出し関数で指定したバイト数ずつ読む
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <chrono>
+#include <vector>
+
+#include "../../include/JPEGDecoder.h"
+
+static void fatal(const char *fmt, const char *arg = "")
+{
+	fprintf(stderr, "jpegbench: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+static std::vector<uint8_t> readFile(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) fatal("cannot open %s", path);
+	std::vector<uint8_t> data;
+	uint8_t buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+	fclose(f);
+	return data;
+}
+
+/// @brief 展開した画像（RGB565）
+struct Canvas {
+	uint16_t width = 0;
+	uint16_t height = 0;
+	std::vector<uint16_t> pixels;
+	uint32_t mcus = 0;
+};
+
+static bool storeMCU(void *context, uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *pixels)
+{
+	Canvas *c = (Canvas *)context;
+	c->mcus++;
+	if (c->pixels.empty()) return true;
+	if (x + w > c->width || y + h > c->height) fatal("MCU out of range");
+	for (int j = 0; j < h; j++) {
+		for (int i = 0; i < w; i++, pixels += 2) c->pixels[(y + j) * c->width + x + i] = (pixels[0] << 8) | pixels[1];
+	}
+	return true;
+}
+
+/// @brief 読み出し関数で読むときの状態
+struct ChunkReader {
+	const std::vector<uint8_t> *data;
+	size_t pos;
+	uint32_t chunk;
+};
+
+static uint32_t readChunk(void *context, uint8_t *buffer, uint32_t length)
+{
+	ChunkReader *r = (ChunkReader *)context;
+	uint32_t n = r->chunk < length ? r->chunk : length;
+	if (n > r->data->size() - r->pos) n = r->data->size() - r->pos;
+	memcpy(buffer, r->data->data() + r->pos, n);
+	r->pos += n;
+	return n;
+}
+
+static void writePpm(const char *path, const Canvas &c)
+{
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) fatal("cannot create %s", path);
+	fprintf(f, "P6\n%d %d\n255\n", c.width, c.height);
+	for (uint16_t v : c.pixels) {
+		uint8_t rgb[3] = {(uint8_t)(((v >> 11) & 0x1F) << 3), (uint8_t)(((v >> 5) & 0x3F) << 2), (uint8_t)((v & 0x1F) << 3)};
+		rgb[0] |= rgb[0] >> 5;
+		rgb[1] |= rgb[1] >> 6;
+		rgb[2] |= rgb[2] >> 5;
+		fwrite(rgb, 1, 3, f);
+	}
+	fclose(f);
+}
+
+/// @brief 参照の画像（PPM）と比べ、PSNR（dB）を求める。RGB565の値を8ビットに戻して比べる
+static double comparePpm(const char *path, const Canvas &c)
+{
+	std::vector<uint8_t> data = readFile(path);
+	unsigned w, h, maxval;
+	int offset = 0;
+	if (sscanf((const char *)data.data(), "P6 %u %u %u%n", &w, &h, &maxval, &offset) != 3 || maxval != 255) fatal("%s: not a P6 PPM file", path);
+	offset++;  // 最大値の後の空白
+	if (w != c.width || h != c.height) fatal("%s: size differs", path);
+	if (offset + w * h * 3 > data.size()) fatal("%s: truncated", path);
+	const uint8_t *p = &data[offset];
+	double sum = 0;
+	for (size_t i = 0; i < c.pixels.size(); i++, p += 3) {
+		uint16_t v = c.pixels[i];
+		int rgb[3] = {(v >> 11) << 3, ((v >> 5) & 0x3F) << 2, (v & 0x1F) << 3};
+		int ref[3] = {p[0] & 0xF8, p[1] & 0xFC, p[2] & 0xF8};
+		for (int k = 0; k < 3; k++) sum += (double)(rgb[k] - ref[k]) * (rgb[k] - ref[k]);
+	}
+	double mse = sum / (c.pixels.size() * 3);
+	return mse == 0 ? INFINITY : 10 * log10(255.0 * 255.0 / mse);
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage:\n"
+		"  jpegbench [options] <input.jpg>\n"
+		"    -o <out.ppm>       save the decoded image\n"
+		"    --scale <1|2|4|8>  decode at 1/scale\n"
+		"    --ref <ref.ppm>    print PSNR against a reference image\n"
+		"    --repeat <n>       decode n times and print the average time\n"
+		"    --chunk <bytes>    read through a callback in chunks of this size\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *input = NULL, *output = NULL, *ref = NULL;
+	int scale = 1, repeat = 10;
+	uint32_t chunk = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+			scale = atoi(argv[++i]);
+			if (scale != 1 && scale != 2 && scale != 4 && scale != 8) usage();
+		} else if (strcmp(argv[i], "--ref") == 0 && i + 1 < argc) {
+			ref = argv[++i];
+		} else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+			repeat = atoi(argv[++i]);
+			if (repeat < 1) usage();
+		} else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+			chunk = atoi(argv[++i]);
+		} else if (argv[i][0] == '-' || input != NULL) {
+			usage();
+		} else {
+			input = argv[i];
+		}
+	}
+	if (input == NULL) usage();
+
+	std::vector<uint8_t> data = readFile(input);
+	static JPEGDecoder jpeg;
+	ImageStream in;
+	JPEGInfo info;
+	in.BeginMemory(data.data(), data.size());
+	if (!jpeg.ReadHeader(in, &info)) fatal("%s: not a supported JPEG file", input);
+
+	Canvas canvas;
+	canvas.width = (info.width + scale - 1) / scale;
+	canvas.height = (info.height + scale - 1) / scale;
+	canvas.pixels.assign(canvas.width * canvas.height, 0);
+
+	double total = 0;
+	for (int n = 0; n < repeat; n++) {
+		ChunkReader reader = {&data, 0, chunk};
+		if (chunk) in.Begin(readChunk, &reader);
+		else in.BeginMemory(data.data(), data.size());
+		canvas.mcus = 0;
+		auto start = std::chrono::steady_clock::now();
+		bool ok = jpeg.Decode(in, scale, storeMCU, &canvas);
+		total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		if (!ok) fatal("%s: decode failed", input);
+		if (n == 0 && !canvas.pixels.empty()) {
+			if (output) writePpm(output, canvas);
+			canvas.pixels.clear();  // 以後は展開だけを計る
+		}
+	}
+	printf("%s: %ux%u %s, 1/%d -> %ux%u, %u MCUs, %.1f us/decode\n", input, info.width, info.height,
+		info.components == 1 ? "gray" : "YCbCr", scale, canvas.width, canvas.height, canvas.mcus, total / repeat);
+	if (ref) {
+		canvas.pixels.assign(canvas.width * canvas.height, 0);
+		in.BeginMemory(data.data(), data.size());
+		jpeg.Decode(in, scale, storeMCU, &canvas);
+		printf("PSNR: %.2f dB\n", comparePpm(ref, canvas));
+	}
+	return 0;
+}
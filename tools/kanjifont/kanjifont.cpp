@@ -0,0 +1,977 @@
+/**
+ * @file kanjifont.cpp
+ * @brief 漢字フォントのテーブル(include/font/Font_Kanji*.inc)を作成するホスト用のツール。
+ * @details ライブラリはRP2040用だが、このツールはPC上でビルドして使う。
+ *
+ *     g++ -std=c++17 -O2 -o kanjifont tools/kanjifont/kanjifont.cpp
+ *
+ * 使い方:
+ *
+ *     kanjifont pack <入力.inc> <テーブル名> [-o 出力.inc] [--no-sjis] [--compress]
+ *         BDF2CPPで作成された従来形式（KanjiFont/AsciiFont構造体の配列）のテーブルを、
+ *         KanjiHelper.hのKanjiFontTableで参照するパック形式に変換する。
+ *         入力がすでにパック形式の場合も読み込めるので、形式を変更したときの再生成にも使える。
+ *         --compress を指定すると、全角文字のビットマップを圧縮する（KanjiCodec.h）。
+ *
+ *     kanjifont bdf <全角.bdf> <半角.bdf> <テーブル名> [-o 出力.inc] [--no-sjis] [--compress]
+ *         BDFフォントから、パック形式のテーブルを作る。全角のBDFは、文字コードがJIS X 0208
+ *         (CHARSET_REGISTRY "JISX0208...") か Unicode ("ISO10646") のもの。
+ *         半角のBDFは、0x01～0xFFの文字コードをそのまま使う（JIS X 0201なら0xA1～0xDFが半角カナ）。
+ *
+ *     pack, bdf には、次のオプションも指定できる。
+ *         --blob
+ *             .incの代わりに、プログラムに組み込まずに使うフォントブロブ（include/KanjiFontBlob.h）を出力する。
+ *             テーブル名は使われないが、指定は必要。
+ *         --subset <ファイル>
+ *             ファイルに含まれる文字だけを残す（何回でも指定できる）。
+ *             .c .cpp .h .ino .py 等のソースは、文字列リテラルの中の文字だけを拾う（コメントは無視する）。
+ *             それ以外のファイル（.txt .csv .json等の文字列表）は、ファイル内のすべての文字を拾う。
+ *             半角文字(0x01～0xFF)はテーブルの大きさが固定なので、常にすべて残す。
+ *             数百文字程度なら、--compress は確率表(4KBytes)の分だけかえって大きくなる。
+ *             作ったテーブルは、KanjiHelper.hの TFT_KANJI_FONT_FILE で指定して使う。
+ *
+ *     kanjifont bench <入力.inc>
+ *         圧縮した場合の大きさと、復号の速さを非圧縮の読み出しと比べて表示する。
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iconv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../../include/KanjiCodec.h"
+
+/// @brief １文字分のフォントデータ
+struct Glyph {
+	uint32_t code = 0;			///< UTF-8のバイト列をそのまま並べた値（ASCIIは文字コード）
+	uint16_t sjis = 0;
+	uint16_t jis = 0;
+	std::vector<uint8_t> pixels;	///< width x height の各ドット。1が前景
+};
+
+/// @brief フォントテーブル全体
+struct FontData {
+	std::string kanjiSource;	///< 漢字の元データの説明（コメントに残す）
+	std::string asciiSource;	///< 半角文字の元データの説明
+	int width = 0, height = 0;			///< 全角の大きさ
+	int asciiWidth = 0, asciiHeight = 0;	///< 半角の大きさ
+	std::vector<Glyph> kanji;		///< 全角文字。codeの昇順
+	std::vector<Glyph> ascii;		///< 半角文字。コード1～255の255文字
+};
+
+static void fatal(const char *fmt, const char *arg = "")
+{
+	fprintf(stderr, "kanjifont: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+/// @brief UTF-8のバイト列をそのまま並べた値を、Unicodeのコードポイントに変換する
+static uint32_t codePoint(uint32_t code)
+{
+	if (code <= 0x7F) return code;
+	if (code <= 0xFFFF) return ((code >> 8) & 0x1F) << 6 | (code & 0x3F);
+	if (code <= 0xFFFFFF) return ((code >> 16) & 0x0F) << 12 | ((code >> 8) & 0x3F) << 6 | (code & 0x3F);
+	return ((code >> 24) & 0x07) << 18 | ((code >> 16) & 0x3F) << 12 | ((code >> 8) & 0x3F) << 6 | (code & 0x3F);
+}
+
+/// @brief Unicodeのコードポイントを、UTF-8のバイト列をそのまま並べた値に変換する
+static uint32_t utf8Code(uint32_t cp)
+{
+	if (cp <= 0x7F) return cp;
+	if (cp <= 0x7FF) return (0xC0 | (cp >> 6)) << 8 | (0x80 | (cp & 0x3F));
+	if (cp <= 0xFFFF) return (0xE0 | (cp >> 12)) << 16 | (0x80 | ((cp >> 6) & 0x3F)) << 8 | (0x80 | (cp & 0x3F));
+	return (uint32_t)(0xF0 | (cp >> 18)) << 24 | (0x80 | ((cp >> 12) & 0x3F)) << 16 | (0x80 | ((cp >> 6) & 0x3F)) << 8 | (0x80 | (cp & 0x3F));
+}
+
+/// @brief UTF-8のバイト列をそのまま並べた値を、文字列に戻す（コメント用）
+static std::string codeToString(uint32_t code)
+{
+	std::string s;
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		uint8_t b = (code >> shift) & 0xFF;
+		if (b != 0) s += (char)b;
+	}
+	return s;
+}
+
+/// @brief 圧縮に使う確率表。コンテキストごとに、ドットが0である確率を256分率で持つ
+typedef std::vector<uint8_t> Model;
+
+/// @brief 文字を左上から順に走査し、各ドットのコンテキストと値を渡す
+template <typename F>
+static void scanContexts(const std::vector<uint8_t> &pixels, int w, int h, F f)
+{
+	uint32_t prev1 = 0, prev2 = 0;
+	for (int y = 0; y < h; y++) {
+		uint32_t cur = 0;
+		for (int x = 0; x < w; x++) {
+			uint8_t bit = pixels[y * w + x];
+			f(kanjiCodecContext(cur, prev1, prev2, x, w), bit);
+			if (bit) cur |= 1u << (w + 3 - x);
+		}
+		prev2 = prev1;
+		prev1 = cur;
+	}
+}
+
+/// @brief テーブルの全角文字全体から、確率表を作る
+static Model buildModel(const FontData &font)
+{
+	std::vector<uint32_t> zeros(1 << KANJI_CODEC_CONTEXT_BITS), total(1 << KANJI_CODEC_CONTEXT_BITS);
+	for (const Glyph &g : font.kanji) {
+		scanContexts(g.pixels, font.width, font.height, [&](uint16_t ctx, uint8_t bit) {
+			total[ctx]++;
+			if (!bit) zeros[ctx]++;
+		});
+	}
+	Model model(1 << KANJI_CODEC_CONTEXT_BITS);
+	for (size_t i = 0; i < model.size(); i++) {
+		int p = (int)((zeros[i] + 0.4) / (total[i] + 0.8) * 256 + 0.5);
+		model[i] = (uint8_t)std::min(255, std::max(1, p));
+	}
+	return model;
+}
+
+/// @brief ２値のレンジコーダの符号化器。KanjiCodec.hの復号器と対になる
+class RangeEncoder {
+	public:
+	std::vector<uint8_t> out;
+
+	void encode(uint8_t bit, uint16_t p0)
+	{
+		uint32_t bound = (range >> 12) * p0;
+		if (bit == 0) {
+			range = bound;
+		} else {
+			low += bound;
+			range -= bound;
+		}
+		if (low >> 32) {
+			carry();
+		}
+		while (range < (1u << 24)) {
+			out.push_back((uint8_t)(low >> 24));
+			low = (low << 8) & 0xFFFFFFFF;
+			range <<= 8;
+		}
+	}
+
+	/// @brief 復号側が末尾を0で補って読んだときに、最後の区間に入る最短のバイト列を出力する
+	void finish()
+	{
+		for (int k = 0; k <= 4; k++) {
+			uint64_t step = (uint64_t)1 << (32 - 8 * k);
+			uint64_t v = (low + step - 1) & ~(step - 1);
+			if (v - low < range) {
+				if (v >> 32) {
+					low = v;
+					carry();
+					v &= 0xFFFFFFFF;
+				}
+				for (int i = 0; i < k; i++) out.push_back((uint8_t)(v >> (24 - 8 * i)));
+				break;
+			}
+		}
+		while (!out.empty() && out.back() == 0) out.pop_back();
+	}
+
+	private:
+	uint64_t low = 0;
+	uint32_t range = 0xFFFFFFFF;
+
+	void carry()
+	{
+		for (size_t i = out.size(); i-- > 0;) {
+			if (++out[i] != 0) break;
+		}
+		low &= 0xFFFFFFFF;
+	}
+};
+
+static std::vector<uint8_t> encodeGlyph(const std::vector<uint8_t> &pixels, int w, int h, const Model &model)
+{
+	RangeEncoder enc;
+	scanContexts(pixels, w, h, [&](uint16_t ctx, uint8_t bit) { enc.encode(bit, model[ctx] << 4); });
+	enc.finish();
+	return enc.out;
+}
+
+static std::vector<uint8_t> decodeGlyph(const uint8_t *data, size_t length, int w, int h, const Model &model)
+{
+	std::vector<uint8_t> pixels(w * h);
+	KanjiRangeDecoder d;
+	kanjiCodecBegin(&d, data, length);
+	uint32_t prev1 = 0, prev2 = 0;
+	for (int y = 0; y < h; y++) {
+		uint32_t cur = 0;
+		for (int x = 0; x < w; x++) {
+			if (kanjiCodecDecodeBit(&d, model[kanjiCodecContext(cur, prev1, prev2, x, w)] << 4)) {
+				cur |= 1u << (w + 3 - x);
+				pixels[y * w + x] = 1;
+			}
+		}
+		prev2 = prev1;
+		prev1 = cur;
+	}
+	return pixels;
+}
+
+/// @brief 行ごとにバイト境界に揃えられたビットマップ（従来形式）を、ドットの配列に展開する
+static std::vector<uint8_t> unpackRows(const std::vector<uint8_t> &bytes, int w, int h)
+{
+	int wBytes = (w + 7) / 8;
+	std::vector<uint8_t> pixels(w * h);
+	for (int y = 0; y < h; y++) {
+		for (int x = 0; x < w; x++) {
+			pixels[y * w + x] = (bytes[y * wBytes + x / 8] >> (7 - x % 8)) & 1;
+		}
+	}
+	return pixels;
+}
+
+/// @brief "{...}" の中の 0xNN を並べたものを読み込む
+static std::vector<uint8_t> parseBytes(const char *p)
+{
+	std::vector<uint8_t> bytes;
+	while (*p && *p != '}') {
+		if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+			char *end;
+			bytes.push_back((uint8_t)strtoul(p, &end, 16));
+			p = end;
+		} else {
+			p++;
+		}
+	}
+	return bytes;
+}
+
+/// @brief BDF2CPPで作成された従来形式のテーブルを読み込む
+/// @details 各行は {Unicode,Sjis,Jis,width,height,{bmpData...}}, の形式。
+/// AsciiFontの定義より後の行は半角文字として扱う。
+static bool readLegacy(FILE *fp, FontData &font)
+{
+	char line[1024];
+	bool inAscii = false;
+	bool found = false;
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "// Kanji bitmap data - ", 23) == 0 && font.kanjiSource.empty()) {
+			font.kanjiSource = std::string(line + 23, strcspn(line + 23, "\r\n"));
+		} else if (strncmp(line, "// Ascii bitmap data - ", 23) == 0) {
+			font.asciiSource = std::string(line + 23, strcspn(line + 23, "\r\n"));
+		} else if (strstr(line, "} AsciiFont;")) {
+			inAscii = true;
+		}
+		unsigned int code, sjis, jis, w, h;
+		if (sscanf(line, "{0x%x,0x%x,0x%x,%u,%u,{", &code, &sjis, &jis, &w, &h) != 5) {
+			continue;
+		}
+		found = true;
+		Glyph g;
+		g.code = code;
+		g.sjis = sjis;
+		g.jis = jis;
+		std::vector<uint8_t> bytes = parseBytes(strchr(strchr(line, '{') + 1, '{') + 1);
+		if (bytes.size() < (size_t)((w + 7) / 8 * h)) {
+			fatal("bitmap data too short: %s", line);
+		}
+		g.pixels = unpackRows(bytes, w, h);
+		if (inAscii) {
+			if (font.asciiWidth == 0) font.asciiWidth = w, font.asciiHeight = h;
+			if ((int)w != font.asciiWidth || (int)h != font.asciiHeight) fatal("ascii glyph size differs: %s", line);
+			font.ascii.push_back(g);
+		} else {
+			if (font.width == 0) font.width = w, font.height = h;
+			if ((int)w != font.width || (int)h != font.height) fatal("kanji glyph size differs: %s", line);
+			font.kanji.push_back(g);
+		}
+	}
+	return found;
+}
+
+/// @brief パック形式のテーブルを読み込む（再生成用）
+/// @details 生成したファイルの先頭に、元データの情報をコメントとして残してあるので、それを使う。
+/// 各文字のビットマップの行には "// U+XXXX <code> <sjis> <jis>" のコメントがある。
+static bool readPacked(FILE *fp, FontData &font)
+{
+	char line[4096];
+	bool found = false;
+	bool inAscii = false;
+	bool inModel = false;
+	Model model;
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned int w, h, aw, ah;
+		if (strncmp(line, "// Kanji bitmap data - ", 23) == 0) {
+			font.kanjiSource = std::string(line + 23, strcspn(line + 23, "\r\n"));
+		} else if (strncmp(line, "// Ascii bitmap data - ", 23) == 0) {
+			font.asciiSource = std::string(line + 23, strcspn(line + 23, "\r\n"));
+		} else if (sscanf(line, "// glyph size:%ux%u ascii:%ux%u", &w, &h, &aw, &ah) == 4) {
+			font.width = w, font.height = h, font.asciiWidth = aw, font.asciiHeight = ah;
+			found = true;
+		} else if (strstr(line, "_asciiBitmaps[")) {
+			inAscii = true;
+		} else if (strstr(line, "_model[")) {
+			inModel = true;
+		} else if (inModel) {
+			if (line[0] == '}') {
+				inModel = false;
+			} else {
+				for (char *p = line; *p;) {
+					char *end;
+					unsigned long v = strtoul(p, &end, 10);
+					if (end == p) {
+						p++;
+					} else {
+						model.push_back((uint8_t)v);
+						p = end;
+					}
+				}
+			}
+		}
+		const char *comment = strstr(line, "// U+");
+		if (!found || comment == NULL) {
+			continue;
+		}
+		unsigned int cp, code, sjis = 0, jis = 0;
+		if (sscanf(comment, "// U+%x %x %x %x", &cp, &code, &sjis, &jis) < 2) {
+			continue;
+		}
+		int gw = inAscii ? font.asciiWidth : font.width;
+		int gh = inAscii ? font.asciiHeight : font.height;
+		std::vector<uint8_t> bytes = parseBytes(line);
+		Glyph g;
+		g.code = code;
+		g.sjis = sjis;
+		g.jis = jis;
+		if (!inAscii && !model.empty()) {		// 圧縮されたテーブル
+			g.pixels = decodeGlyph(bytes.data(), bytes.size(), gw, gh, model);
+		} else {
+			g.pixels.resize(gw * gh);
+			for (int i = 0; i < gw * gh; i++) {
+				g.pixels[i] = (bytes[i / 8] >> (7 - i % 8)) & 1;
+			}
+		}
+		(inAscii ? font.ascii : font.kanji).push_back(g);
+	}
+	return found;
+}
+
+/// @brief JISコードをシフトJISコードに変換する
+static uint16_t jisToSjis(uint16_t jis)
+{
+	if (jis == 0) return 0;
+	uint8_t j1 = jis >> 8, j2 = jis & 0xFF;
+	uint8_t s1 = (j1 + 1) / 2 + (j1 <= 0x5E ? 0x70 : 0xB0);
+	uint8_t s2 = (j1 & 1) ? j2 + (j2 <= 0x5F ? 0x1F : 0x20) : j2 + 0x7E;
+	return s1 << 8 | s2;
+}
+
+/// @brief シフトJISコードをJISコードに変換する
+static uint16_t sjisToJis(uint16_t sjis)
+{
+	if (sjis == 0) return 0;
+	uint8_t s1 = sjis >> 8, s2 = sjis & 0xFF;
+	uint8_t j1 = (s1 - (s1 <= 0x9F ? 0x70 : 0xB0)) * 2;
+	uint8_t j2;
+	if (s2 >= 0x9F) {
+		j2 = s2 - 0x7E;
+	} else {
+		j1--;
+		j2 = s2 - (s2 >= 0x80 ? 0x20 : 0x1F);
+	}
+	return j1 << 8 | j2;
+}
+
+/// @brief iconvで１文字を変換する
+/// @return 変換結果のバイト数。変換できなければ0
+static size_t convert(iconv_t cd, const std::string &in, char *out, size_t size)
+{
+	std::string buf = in;
+	char *ip = &buf[0], *op = out;
+	size_t il = buf.size(), ol = size;
+	iconv(cd, NULL, NULL, NULL, NULL);
+	if (iconv(cd, &ip, &il, &op, &ol) == (size_t)-1 || il != 0) return 0;
+	return op - out;
+}
+
+/// @brief JISコードを、UTF-8のバイト列をそのまま並べた値に変換する
+/// @details 従来のテーブルと同じく、Windowsの対応表（CP932）を使う（例: 2141は U+FF5E）。
+/// @return 変換できなければ0
+static uint32_t jisToCode(iconv_t cd, uint16_t jis)
+{
+	uint16_t sjis = jisToSjis(jis);
+	char out[8];
+	size_t n = convert(cd, std::string{(char)(sjis >> 8), (char)(sjis & 0xFF)}, out, sizeof(out));
+	uint32_t code = 0;
+	for (size_t i = 0; i < n; i++) code = (code << 8) | (uint8_t)out[i];
+	return code;
+}
+
+/// @brief UTF-8の文字を、CP932の対応表でJISコードに変換する
+/// @return JISコード。JIS X 0208の範囲にない文字は0
+static uint16_t codeToJis(iconv_t cd, uint32_t code)
+{
+	char out[4];
+	if (convert(cd, codeToString(code), out, sizeof(out)) != 2) return 0;
+	return sjisToJis(((uint8_t)out[0] << 8) | (uint8_t)out[1]);
+}
+
+/// @brief BDFファイルを読み込む
+/// @details 各文字のBBXとフォント全体のFONTBOUNDINGBOXから、文字をフォントの大きさの枠の中に配置する。
+/// @param path ファイル名
+/// @param width 読み込んだフォントの幅
+/// @param height 読み込んだフォントの高さ
+/// @param registry CHARSET_REGISTRY の値
+/// @param glyphs 読み込んだ文字。codeにはBDFのENCODINGの値が入る
+static void readBdf(const char *path, int &width, int &height, std::string &registry, std::vector<Glyph> &glyphs)
+{
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) fatal("cannot open %s", path);
+	char line[1024];
+	int fontX = 0, fontY = 0;
+	int encoding = -1, bw = 0, bh = 0, bx = 0, by = 0;
+	width = height = 0;
+	while (fgets(line, sizeof(line), fp)) {
+		char value[256];
+		if (sscanf(line, "FONTBOUNDINGBOX %d %d %d %d", &width, &height, &fontX, &fontY) == 4) {
+		} else if (sscanf(line, "CHARSET_REGISTRY \"%255[^\"]\"", value) == 1) {
+			registry = value;
+		} else if (strncmp(line, "STARTCHAR", 9) == 0) {
+			encoding = -1;
+			bw = bh = bx = by = 0;
+		} else if (sscanf(line, "ENCODING %d", &encoding) == 1) {
+		} else if (sscanf(line, "BBX %d %d %d %d", &bw, &bh, &bx, &by) == 4) {
+		} else if (strncmp(line, "BITMAP", 6) == 0) {
+			if (width == 0) fatal("FONTBOUNDINGBOX not found: %s", path);
+			Glyph g;
+			g.code = encoding;
+			g.pixels.resize(width * height);
+			int top = (height + fontY) - (by + bh);		// 文字の上端の、枠の中での行
+			int left = bx - fontX;
+			for (int y = 0; y < bh && fgets(line, sizeof(line), fp); y++) {
+				for (int x = 0; x < bw; x++) {
+					char hex[2] = {line[x / 4], 0};
+					int nibble = (int)strtol(hex, NULL, 16);
+					int px = left + x, py = top + y;
+					if (((nibble >> (3 - x % 4)) & 1) && px >= 0 && px < width && py >= 0 && py < height) {
+						g.pixels[py * width + px] = 1;
+					}
+				}
+			}
+			if (encoding >= 0) glyphs.push_back(g);
+		}
+	}
+	fclose(fp);
+	if (glyphs.empty()) fatal("no glyph data in %s", path);
+}
+
+/// @brief 全角と半角のBDFファイルから、テーブルを作る
+static FontData loadBdf(const char *kanjiPath, const char *asciiPath)
+{
+	FontData font;
+	const char *base = strrchr(kanjiPath, '/');
+	font.kanjiSource = std::string("converted from :") + (base ? base + 1 : kanjiPath) + " (by tools/kanjifont)";
+	base = strrchr(asciiPath, '/');
+	font.asciiSource = std::string("converted from :") + (base ? base + 1 : asciiPath) + " (by tools/kanjifont)";
+
+	std::string registry;
+	std::vector<Glyph> glyphs;
+	readBdf(kanjiPath, font.width, font.height, registry, glyphs);
+	bool isJis = strncasecmp(registry.c_str(), "JISX0208", 8) == 0;
+	if (!isJis && strncasecmp(registry.c_str(), "ISO10646", 8) != 0) fatal("unsupported CHARSET_REGISTRY: %s", registry.c_str());
+	iconv_t toUtf8 = iconv_open("UTF-8", "CP932");
+	iconv_t toSjis = iconv_open("CP932", "UTF-8");
+	if (toUtf8 == (iconv_t)-1 || toSjis == (iconv_t)-1) fatal("iconv does not support CP932");
+	for (Glyph &g : glyphs) {
+		if (isJis) {
+			g.jis = g.code;
+			g.code = jisToCode(toUtf8, g.jis);
+			if (g.code == 0) continue;		// Unicodeにない文字
+		} else {
+			if (g.code < 0x80) continue;		// ASCIIは半角のBDFから読む
+			g.code = utf8Code(g.code);
+			g.jis = codeToJis(toSjis, g.code);
+		}
+		g.sjis = jisToSjis(g.jis);
+		font.kanji.push_back(g);
+	}
+	iconv_close(toUtf8);
+	iconv_close(toSjis);
+
+	glyphs.clear();
+	readBdf(asciiPath, font.asciiWidth, font.asciiHeight, registry, glyphs);
+	font.ascii.resize(255);
+	for (int i = 0; i < 255; i++) {
+		font.ascii[i].code = i + 1;
+		font.ascii[i].pixels.assign(font.asciiWidth * font.asciiHeight, 0);		// BDFにない文字は空白
+	}
+	for (const Glyph &g : glyphs) {
+		if (g.code >= 1 && g.code <= 255) font.ascii[g.code - 1].pixels = g.pixels;
+	}
+	return font;
+}
+
+/// @brief ファイルから、使われている文字（UTF-8のバイト列をそのまま並べた値）を集める
+/// @details ソースファイルは文字列リテラルの中だけを見る。それ以外のファイルはすべての文字を拾う。
+static void scanText(const char *path, std::set<uint32_t> &codes)
+{
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) fatal("cannot open %s", path);
+	std::string text;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) text.append(buf, n);
+	fclose(fp);
+
+	const char *ext = strrchr(path, '.');
+	static const char *const sourceExts[] = {".c", ".cc", ".cpp", ".cxx", ".h", ".hpp", ".inc", ".ino", ".py"};
+	bool isSource = false;
+	for (const char *e : sourceExts) {
+		if (ext && strcasecmp(ext, e) == 0) isSource = true;
+	}
+	bool isPython = ext && strcasecmp(ext, ".py") == 0;
+
+	char quote = 0;		// 文字列リテラルの中なら、その引用符
+	for (size_t i = 0; i < text.size();) {
+		uint8_t c = text[i];
+		if (isSource && quote == 0) {
+			if (c == '"' || c == '\'') {
+				quote = c;
+			} else if (!isPython && text.compare(i, 2, "//") == 0) {
+				i = text.find('\n', i);
+				if (i == std::string::npos) break;
+				continue;
+			} else if (!isPython && text.compare(i, 2, "/*") == 0) {
+				i = text.find("*/", i + 2);
+				if (i == std::string::npos) break;
+				i += 2;
+				continue;
+			} else if (isPython && c == '#') {
+				i = text.find('\n', i);
+				if (i == std::string::npos) break;
+				continue;
+			}
+			i++;
+			continue;
+		}
+		if (quote != 0) {
+			if (c == '\\') {
+				i += 2;
+				continue;
+			}
+			if (c == quote || (c == '\n' && !isPython)) {
+				quote = 0;
+				i++;
+				continue;
+			}
+		}
+		// UTF-8の１文字を取り出す
+		int len = (c < 0x80) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+		if (i + len > text.size()) break;
+		uint32_t code = 0;
+		for (int k = 0; k < len; k++) code = (code << 8) | (uint8_t)text[i + k];
+		if (code > 0xFF) codes.insert(code);
+		i += len;
+	}
+}
+
+/// @brief 指定された文字だけを残す
+static void subsetFont(FontData &font, const std::set<uint32_t> &codes)
+{
+	std::vector<Glyph> kept;
+	for (const Glyph &g : font.kanji) {
+		if (codes.count(g.code)) kept.push_back(g);
+	}
+	for (uint32_t code : codes) {
+		bool found = std::any_of(kept.begin(), kept.end(), [&](const Glyph &g) { return g.code == code; });
+		if (!found) fprintf(stderr, "kanjifont: warning: U+%04X %s is not in the font\n", codePoint(code), codeToString(code).c_str());
+	}
+	fprintf(stderr, "kanjifont: subset %zu of %zu glyphs\n", kept.size(), font.kanji.size());
+	font.kanji = kept;
+}
+
+/// @brief 読み込んだテーブルを、コード順に並べて重複を取り除き、検査する
+static void normalizeTable(FontData &font, const char *path)
+{
+	std::stable_sort(font.kanji.begin(), font.kanji.end(), [](const Glyph &a, const Glyph &b) { return a.code < b.code; });
+	size_t before = font.kanji.size();
+	font.kanji.erase(std::unique(font.kanji.begin(), font.kanji.end(), [](const Glyph &a, const Glyph &b) { return a.code == b.code; }), font.kanji.end());
+	if (font.kanji.size() != before) {
+		fprintf(stderr, "kanjifont: %s: %zu duplicate code(s) removed\n", path, before - font.kanji.size());
+	}
+	for (const Glyph &g : font.kanji) {
+		if (codePoint(g.code) > 0xFFFF) fatal("code outside BMP: %s", codeToString(g.code).c_str());
+	}
+	if (font.ascii.size() != 255) fatal("ascii table must have 255 glyphs: %s", path);
+}
+
+/// @brief テーブルを読み込む
+static FontData loadTable(const char *path)
+{
+	FILE *fp = fopen(path, "r");
+	if (fp == NULL) fatal("cannot open %s", path);
+	FontData font;
+	if (!readPacked(fp, font)) {
+		rewind(fp);
+		font = FontData();
+		if (!readLegacy(fp, font)) fatal("no glyph data in %s", path);
+	}
+	fclose(fp);
+	normalizeTable(font, path);
+	return font;
+}
+
+/// @brief ドットの配列を、ビット単位で詰めたバイト列にする。最後のバイトの余りは0
+static std::vector<uint8_t> packBits(const std::vector<uint8_t> &pixels)
+{
+	std::vector<uint8_t> bytes((pixels.size() + 7) / 8);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		if (pixels[i]) bytes[i / 8] |= 0x80 >> (i % 8);
+	}
+	return bytes;
+}
+
+static void writeBytes(FILE *out, const std::vector<uint8_t> &bytes)
+{
+	for (uint8_t b : bytes) fprintf(out, "0x%02X,", b);
+}
+
+/// @brief 全角文字のビットマップを、１文字ずつのバイト列にする。圧縮する場合は確率表も作る
+static std::vector<std::vector<uint8_t>> buildBitmaps(const FontData &font, bool compress, Model &model)
+{
+	std::vector<std::vector<uint8_t>> bitmaps;
+	if (compress) {
+		if (font.width > KANJI_CODEC_MAX_WIDTH) fatal("glyph too wide to compress");
+		model = buildModel(font);
+	}
+	for (const Glyph &g : font.kanji) {
+		bitmaps.push_back(compress ? encodeGlyph(g.pixels, font.width, font.height, model) : packBits(g.pixels));
+		if (compress && bitmaps.back().size() > 255) fatal("compressed glyph too long: %s", codeToString(g.code).c_str());
+	}
+	return bitmaps;
+}
+
+/// @brief コードポイントの上位8ビットごとの、codesの開始位置を求める
+static std::vector<uint16_t> buildBucket(const FontData &font)
+{
+	std::vector<uint16_t> bucket(257, 0);
+	for (const Glyph &g : font.kanji) bucket[(codePoint(g.code) >> 8) + 1]++;
+	for (int i = 1; i <= 256; i++) bucket[i] += bucket[i - 1];
+	return bucket;
+}
+
+/// @brief パック形式のテーブルを出力する
+/// @details
+/// - bucket : コードポイントの上位8ビットごとの、codesの開始位置（257要素）
+/// - codes  : コードポイントの下位8ビット。bucketの範囲内で昇順に並んでいる
+/// - index  : bucketとcodesをまとめたKanjiFontIndex。コンパイル時の文字の検索（KanjiText.h）に使う
+///   この３つは inline constexpr なので、TFT_KANJI_FONT_IMPL がなくても見え、実体は使われた翻訳単位に１つだけ置かれる。
+/// - bitmaps: 全角文字のビットマップ。行はビット単位で詰め、１文字ごとにバイト境界に揃える
+/// - asciiBitmaps: 半角文字(1～255)のビットマップ。形式はbitmapsと同じ
+/// - sjis, jis: TFT_KANJI_SJIS_TABLE が定義されているときだけ使われる、codesと同じ順の文字コード表
+///
+/// 圧縮する場合は、bitmapsに各文字を符号化したバイト列を並べ、次のものを追加する。
+/// - model  : 確率表（4096要素）
+/// - lengths: 各文字の符号のバイト数
+/// - blocks : KANJI_CODEC_BLOCK 文字ごとの、bitmaps内の先頭位置
+static void writePacked(FILE *out, const FontData &font, const char *name, bool withSjis, bool compress)
+{
+	size_t count = font.kanji.size();
+	size_t asciiBytes = (font.asciiWidth * font.asciiHeight + 7) / 8;
+
+	Model model;
+	std::vector<std::vector<uint8_t>> bitmaps = buildBitmaps(font, compress, model);
+	size_t bitmapBytes = 0;
+	for (const std::vector<uint8_t> &b : bitmaps) bitmapBytes += b.size();
+	size_t blockCount = (count + KANJI_CODEC_BLOCK - 1) / KANJI_CODEC_BLOCK;
+	size_t dataSize = 257 * 2 + count + bitmapBytes + 255 * asciiBytes;
+	if (compress) dataSize += model.size() + count + blockCount * 4;
+
+	fprintf(out, "#pragma once\n");
+	fprintf(out, "// Kanji bitmap data - %s\n", font.kanjiSource.c_str());
+	fprintf(out, "// Ascii bitmap data - %s\n", font.asciiSource.c_str());
+	fprintf(out, "// packed by tools/kanjifont\n");
+	fprintf(out, "// glyph size:%dx%d ascii:%dx%d%s\n", font.width, font.height, font.asciiWidth, font.asciiHeight, compress ? " compressed" : "");
+	fprintf(out, "// character count:%zu Data Size:%zu bytes\n", count, dataSize);
+	fprintf(out, "extern const KanjiFontTable %s;\n", name);
+
+	std::vector<uint16_t> bucket = buildBucket(font);
+	fprintf(out, "inline constexpr uint16_t %s_bucket[257] = {", name);
+	for (int i = 0; i <= 256; i++) fprintf(out, "%s%u,", (i % 16 == 0) ? "\n" : "", bucket[i]);
+	fprintf(out, "\n};\n");
+
+	fprintf(out, "inline constexpr uint8_t %s_codes[%zu] = {", name, count);
+	for (size_t i = 0; i < count; i++) fprintf(out, "%s0x%02X,", (i % 16 == 0) ? "\n" : "", codePoint(font.kanji[i].code) & 0xFF);
+	fprintf(out, "\n};\n");
+	fprintf(out, "inline constexpr KanjiFontIndex %s_index = {%d, %d, %d, %d, %zu, %s_bucket, %s_codes};\n",
+		name, font.width, font.height, font.asciiWidth, font.asciiHeight, count, name, name);
+	fprintf(out, "#ifdef TFT_KANJI_FONT_IMPL\n");
+
+	if (compress) {
+		fprintf(out, "static const uint8_t %s_model[%zu] TFT_FLASH_DATA(\"kanji\") = {", name, model.size());
+		for (size_t i = 0; i < model.size(); i++) fprintf(out, "%s%u,", (i % 32 == 0) ? "\n" : "", model[i]);
+		fprintf(out, "\n};\n");
+		fprintf(out, "static const uint8_t %s_lengths[%zu] TFT_FLASH_DATA(\"kanji\") = {", name, count);
+		for (size_t i = 0; i < count; i++) fprintf(out, "%s%zu,", (i % 32 == 0) ? "\n" : "", bitmaps[i].size());
+		fprintf(out, "\n};\n");
+		fprintf(out, "static const uint32_t %s_blocks[%zu] TFT_FLASH_DATA(\"kanji\") = {", name, blockCount);
+		size_t offset = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (i % KANJI_CODEC_BLOCK == 0) fprintf(out, "%s%zu,", (i / KANJI_CODEC_BLOCK % 16 == 0) ? "\n" : "", offset);
+			offset += bitmaps[i].size();
+		}
+		fprintf(out, "\n};\n");
+	}
+
+	fprintf(out, "static const uint8_t %s_bitmaps[%zu] TFT_FLASH_DATA(\"kanji\") = {\n", name, bitmapBytes);
+	for (size_t i = 0; i < count; i++) {
+		const Glyph &g = font.kanji[i];
+		writeBytes(out, bitmaps[i]);
+		fprintf(out, "\t// U+%04X %06X %04X %04X %s\n", codePoint(g.code), g.code, g.sjis, g.jis, codeToString(g.code).c_str());
+	}
+	fprintf(out, "};\n");
+
+	fprintf(out, "static const uint8_t %s_asciiBitmaps[%zu] TFT_FLASH_DATA(\"kanji\") = {\n", name, 255 * asciiBytes);
+	for (size_t i = 0; i < font.ascii.size(); i++) {
+		writeBytes(out, packBits(font.ascii[i].pixels));
+		fprintf(out, "\t// U+%04zX %02zX\n", i + 1, i + 1);
+	}
+	fprintf(out, "};\n");
+
+	if (withSjis) {
+		fprintf(out, "#ifdef TFT_KANJI_SJIS_TABLE\n");
+		fprintf(out, "static const uint16_t %s_sjis[%zu] TFT_FLASH_DATA(\"kanji\") = {", name, count);
+		for (size_t i = 0; i < count; i++) fprintf(out, "%s0x%04X,", (i % 16 == 0) ? "\n" : "", font.kanji[i].sjis);
+		fprintf(out, "\n};\n");
+		fprintf(out, "static const uint16_t %s_jis[%zu] TFT_FLASH_DATA(\"kanji\") = {", name, count);
+		for (size_t i = 0; i < count; i++) fprintf(out, "%s0x%04X,", (i % 16 == 0) ? "\n" : "", font.kanji[i].jis);
+		fprintf(out, "\n};\n");
+		fprintf(out, "#endif\n");
+	}
+
+	fprintf(out, "const KanjiFontTable %s = {\n", name);
+	fprintf(out, "\t%d, %d, %d, %d, %zu,\n", font.width, font.height, font.asciiWidth, font.asciiHeight, count);
+	fprintf(out, "\t%s_bucket, %s_codes, %s_bitmaps, %s_asciiBitmaps,\n", name, name, name, name);
+	if (withSjis) {
+		fprintf(out, "#ifdef TFT_KANJI_SJIS_TABLE\n\t%s_sjis, %s_jis,\n#else\n\tNULL, NULL,\n#endif\n", name, name);
+	} else {
+		fprintf(out, "\tNULL, NULL,\n");
+	}
+	if (compress) {
+		fprintf(out, "\t%s_model, %s_lengths, %s_blocks,\n", name, name, name);
+	} else {
+		fprintf(out, "\tNULL, NULL, NULL,\n");
+	}
+	fprintf(out, "};\n");
+	fprintf(out, "#endif\n");
+}
+
+/// @brief フォントブロブ（include/KanjiFontBlob.h）を出力する
+/// @details ヘッダ(KanjiBlobHeader)の後に、パック形式と同じ配列を4バイト境界に揃えて並べる。数値はリトルエンディアン。
+static void writeBlob(FILE *out, const FontData &font, bool withSjis, bool compress)
+{
+	Model model;
+	std::vector<std::vector<uint8_t>> bitmaps = buildBitmaps(font, compress, model);
+	size_t count = font.kanji.size();
+	std::vector<uint8_t> blob(48, 0);
+	auto put16 = [&](size_t pos, uint32_t v) { blob[pos] = v & 0xFF; blob[pos + 1] = (v >> 8) & 0xFF; };
+	auto put32 = [&](size_t pos, uint32_t v) { put16(pos, v & 0xFFFF); put16(pos + 2, v >> 16); };
+	// 配列を追加し、その位置をヘッダのfieldに書く
+	auto section = [&](size_t field) {
+		while (blob.size() % 4) blob.push_back(0);
+		put32(field, blob.size());
+	};
+	memcpy(&blob[0], "KFNT", 4);
+	blob[4] = 1;		// KANJI_BLOB_VERSION
+	blob[5] = font.width;
+	blob[6] = font.height;
+	blob[7] = font.asciiWidth;
+	blob[8] = font.asciiHeight;
+	put16(10, count);
+
+	std::vector<uint16_t> bucket = buildBucket(font);
+	section(12);
+	for (uint16_t b : bucket) blob.push_back(b & 0xFF), blob.push_back(b >> 8);
+	section(16);
+	for (const Glyph &g : font.kanji) blob.push_back(codePoint(g.code) & 0xFF);
+	section(20);
+	for (const std::vector<uint8_t> &b : bitmaps) blob.insert(blob.end(), b.begin(), b.end());
+	section(24);
+	for (const Glyph &g : font.ascii) {
+		std::vector<uint8_t> b = packBits(g.pixels);
+		blob.insert(blob.end(), b.begin(), b.end());
+	}
+	if (withSjis) {
+		section(28);
+		for (const Glyph &g : font.kanji) blob.push_back(g.sjis & 0xFF), blob.push_back(g.sjis >> 8);
+		section(32);
+		for (const Glyph &g : font.kanji) blob.push_back(g.jis & 0xFF), blob.push_back(g.jis >> 8);
+	}
+	if (compress) {
+		section(36);
+		blob.insert(blob.end(), model.begin(), model.end());
+		section(40);
+		for (const std::vector<uint8_t> &b : bitmaps) blob.push_back(b.size());
+		section(44);
+		uint32_t offset = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (i % KANJI_CODEC_BLOCK == 0) {
+				blob.resize(blob.size() + 4);
+				put32(blob.size() - 4, offset);
+			}
+			offset += bitmaps[i].size();
+		}
+	}
+	fwrite(blob.data(), 1, blob.size(), out);
+}
+
+/// @brief 圧縮率と復号の速さを表示する
+/// @details 非圧縮の読み出しは、ライブラリと同じく１行ずつビット列を取り出す処理で比べる。
+static void bench(const FontData &font)
+{
+	int w = font.width, h = font.height;
+	if (w > KANJI_CODEC_MAX_WIDTH) fatal("glyph too wide to compress");
+	size_t count = font.kanji.size();
+	Model model = buildModel(font);
+
+	std::vector<uint8_t> raw, packed;
+	std::vector<size_t> rawOffset, packedOffset;
+	for (const Glyph &g : font.kanji) {
+		std::vector<uint8_t> r = packBits(g.pixels);
+		std::vector<uint8_t> c = encodeGlyph(g.pixels, w, h, model);
+		rawOffset.push_back(raw.size());
+		packedOffset.push_back(packed.size());
+		raw.insert(raw.end(), r.begin(), r.end());
+		packed.insert(packed.end(), c.begin(), c.end());
+		if (decodeGlyph(c.data(), c.size(), w, h, model) != g.pixels) fatal("round trip failed: %s", codeToString(g.code).c_str());
+	}
+	rawOffset.push_back(raw.size());
+	packedOffset.push_back(packed.size());
+	size_t overhead = model.size() + count + (count + KANJI_CODEC_BLOCK - 1) / KANJI_CODEC_BLOCK * 4;
+	printf("glyphs      : %zu (%dx%d), round trip OK\n", count, w, h);
+	printf("raw bitmaps : %zu bytes\n", raw.size());
+	printf("compressed  : %zu bytes + %zu bytes (model, lengths, blocks) = %.1f%%\n",
+		packed.size(), overhead, 100.0 * (packed.size() + overhead) / raw.size());
+
+	const int rounds = 20;
+	uint32_t sum = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) {
+		for (size_t i = 0; i < count; i++) {
+			const uint8_t *p = &raw[rawOffset[i]];
+			for (int y = 0; y < h; y++) {
+				uint32_t row = 0;
+				for (int x = 0; x < w; x++) {
+					int bit = y * w + x;
+					row = (row << 1) | ((p[bit >> 3] >> (7 - (bit & 7))) & 1);
+				}
+				sum += row;
+			}
+		}
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) {
+		for (size_t i = 0; i < count; i++) {
+			KanjiRangeDecoder d;
+			kanjiCodecBegin(&d, &packed[packedOffset[i]], packedOffset[i + 1] - packedOffset[i]);
+			uint32_t prev1 = 0, prev2 = 0;
+			for (int y = 0; y < h; y++) {
+				uint32_t cur = 0;
+				for (int x = 0; x < w; x++) {
+					if (kanjiCodecDecodeBit(&d, model[kanjiCodecContext(cur, prev1, prev2, x, w)] << 4)) cur |= 1u << (w + 3 - x);
+				}
+				prev2 = prev1;
+				prev1 = cur;
+				sum += cur;
+			}
+		}
+	}
+	auto t2 = std::chrono::steady_clock::now();
+	double rawNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / (rounds * count);
+	double packedNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / (rounds * count);
+	printf("raw read    : %.0f ns/glyph\n", rawNs);
+	printf("decode      : %.0f ns/glyph (x%.1f)  [%u]\n", packedNs, packedNs / rawNs, sum & 1);
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage:\n"
+		"  kanjifont pack <input.inc> <name> [options]\n"
+		"  kanjifont bdf <kanji.bdf> <ascii.bdf> <name> [options]\n"
+		"  kanjifont bench <input.inc>\n"
+		"options:\n"
+		"  -o <output.inc>   write to a file instead of stdout\n"
+		"  --no-sjis         omit the Shift_JIS/JIS tables\n"
+		"  --compress        compress the full-width bitmaps\n"
+		"  --subset <file>   keep only the characters used in the file (repeatable)\n"
+		"  --blob            write a binary font blob instead of an .inc file\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) usage();
+	std::string cmd = argv[1];
+	if (cmd == "bench") {
+		if (argc != 3) usage();
+		bench(loadTable(argv[2]));
+		return 0;
+	}
+
+	int first;		// オプションの始まり
+	FontData font;
+	if (cmd == "pack") {
+		if (argc < 4) usage();
+		font = loadTable(argv[2]);
+		first = 4;
+	} else if (cmd == "bdf") {
+		if (argc < 5) usage();
+		font = loadBdf(argv[2], argv[3]);
+		normalizeTable(font, argv[2]);
+		first = 5;
+	} else {
+		usage();
+	}
+	const char *name = argv[first - 1];
+	const char *output = NULL;
+	bool withSjis = true;
+	bool compress = false;
+	bool subset = false;
+	bool blob = false;
+	std::set<uint32_t> codes;
+	for (int i = first; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "--no-sjis") == 0) {
+			withSjis = false;
+		} else if (strcmp(argv[i], "--compress") == 0) {
+			compress = true;
+		} else if (strcmp(argv[i], "--blob") == 0) {
+			blob = true;
+		} else if (strcmp(argv[i], "--subset") == 0 && i + 1 < argc) {
+			scanText(argv[++i], codes);
+			subset = true;
+		} else {
+			usage();
+		}
+	}
+	if (subset) subsetFont(font, codes);
+	FILE *out = output ? fopen(output, blob ? "wb" : "w") : stdout;
+	if (out == NULL) fatal("cannot create %s", output);
+	if (blob) {
+		writeBlob(out, font, withSjis, compress);
+	} else {
+		writePacked(out, font, name, withSjis, compress);
+	}
+	if (output) fclose(out);
+	return 0;
+}
@@ -0,0 +1,233 @@
+/**
+ * @file label.cpp
+ * @brief 変わらない文字列を、あらかじめ画像（ラベル、ST7735_struct.hのTFTLabel）に描画しておくホスト用のツール。
+ * @details タイトルや単位、ボタンの名前などの文字列は、実行時に毎回文字を検索してビットマップを展開する必要がない。
+ * このツールで作ったラベルを ST7735::drawLabel で表示すれば、１つのアドレスウインドウで送るだけで済む。<br/>
+ * 文字はライブラリのKanjiHelper（UTF-8の解釈、文字の検索）とGlyphRaster（DigitAtlasと同じ文字の描き方）をそのままリンクして描画するので、
+ * 漢字は折り返しなしのdrawTextKanjiと同じ画像になる。GFXフォントはdrawTextLineと同じく、送り幅 x 行の高さの枠に描画する。
+ * 半角カナの扱いも、ライブラリと同じくKanjiHelper.hのTFT_FORCE_HANKANAに従う。<br/>
+ * 漢字のテーブルは、アプリケーションと同じ TFT_KANJI_DOT / TFT_KANJI_LEVEL / TFT_KANJI_FONT_FILE 等を指定してビルドして選ぶ。
+ *
+ *     g++ -std=gnu++17 -O2 -Iinclude -DTFT_KANJI_DOT=16 -o label tools/label/label.cpp src/KanjiHelper.cpp src/KanjiFontBlob.cpp src/GlyphRaster.cpp
+ *
+ * 使い方:
+ *
+ *     label [オプション] <ラベル名> <文字列> [<ラベル名> <文字列>...]
+ *         -o <出力.inc>        出力先（既定値は標準出力）
+ *         --gfx <フォント名>   漢字の代わりにGFXフォント（FreeMono9pt7bなど）で描画する
+ *         --size <n>           文字のサイズ（drawTextKanji等のsize）
+ *         --rgb565 <前景色> <背景色>
+ *                              色を決めてRGB565の画像にする（16進数）。指定しなければ1ドット1ビットで、色は描画時に指定する
+ *
+ * 出力した.incは、アプリケーションのソースで１か所だけインクルードし、tft.drawLabel(x, y, &ラベル名, color, bg) で表示する。
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "../../include/KanjiHelper.h"
+#include "../../include/GlyphRaster.h"
+#include "../../include/font/Font_Mono9p.h"
+#include "../../include/font/Font_Mono18p.h"
+#include "../../include/font/FreeMonoOblique12pt7b.h"
+#include "../../include/font/FreeMonoOblique12pt_sub.h"
+
+/// @brief 名前で指定できるGFXフォント。ST7735_fonts.cppのregisteredFontsと同じものを並べる
+static const struct {
+	const char *name;
+	const GFXfont *font;
+} gfxFonts[] = {
+	{"FreeMono9pt7b", &FreeMono9pt7b},
+	{"FreeMono18pt7b", &FreeMono18pt7b},
+	{"FreeMonoOblique12pt_sub", &FreeMonoOblique12pt_sub},
+	{"FreeMonoOblique12pt7b", &FreeMonoOblique12pt7b},
+};
+
+/// @brief 描画した画像。1ドット1バイトで、1が前景
+struct Canvas {
+	uint16_t width = 0;
+	uint16_t height = 0;
+	int16_t top = 0;
+	std::vector<uint8_t> pixels;
+
+	void resize(uint16_t w, uint16_t h)
+	{
+		width = w;
+		height = h;
+		pixels.assign((size_t)w * h, 0);
+	}
+	void set(int x, int y)
+	{
+		if (x >= 0 && x < width && y >= 0 && y < height) pixels[(size_t)y * width + x] = 1;
+	}
+};
+
+/// @brief GlyphRasterが描く前景の矩形を、キャンバスの文字の位置に描く
+struct CanvasPen {
+	Canvas *canvas;
+	int x;		///< 文字の枠の左端
+};
+
+static void fillCanvas(void *context, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+	CanvasPen *pen = (CanvasPen *)context;
+	for (int yy = y; yy < y + h; yy++) {
+		for (int xx = x; xx < x + w; xx++) pen->canvas->set(pen->x + xx, yy);
+	}
+}
+
+static void fatal(const char *fmt, const char *arg = "")
+{
+	fprintf(stderr, "label: ");
+	fprintf(stderr, fmt, arg);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+/// @brief drawKanjiRunと同じ手順で、漢字文字列を描画する
+static Canvas renderKanji(const char *text, uint8_t size)
+{
+	// まず幅を求める
+	uint16_t width = 0;
+	for (const char *p = text; *p;) {
+		uint32_t code;
+		KanjiGlyph glyph;
+		uint8_t step = KanjiHelper::DecodeUTF8(p, &code, kanjiForceHankana);
+		if (step == 0) fatal("invalid UTF-8 in \"%s\"", text);
+		if (!KanjiHelper::GetGlyph(code, &glyph)) {
+			fprintf(stderr, "label: warning: \"%.*s\" is not in the Kanji font\n", step, p);
+		}
+		width += glyph.width * size;
+		p += step;
+	}
+	Canvas canvas;
+	canvas.resize(width, KanjiHelper::Table().height * size);
+
+	CanvasPen pen = {&canvas, 0};
+	for (const char *p = text; *p;) {
+		uint32_t code;
+		KanjiGlyph glyph;
+		uint8_t step = KanjiHelper::DecodeUTF8(p, &code, kanjiForceHankana);
+		if (step == 0) break;  // 幅を求めたときに確かめてあるので、ここには来ない
+		p += step;
+		if (KanjiHelper::GetGlyph(code, &glyph)) {
+			GlyphRaster::RasterizeKanji(&glyph, size, fillCanvas, &pen);
+		}
+		pen.x += glyph.width * size;
+	}
+	return canvas;
+}
+
+/// @brief drawTextLineと同じく、送り幅 x 行の高さの枠にGFXフォントの文字列を描画する
+static Canvas renderGfx(const GFXfont *font, const char *text, uint8_t size)
+{
+	// 枠の上端は、フォント中で一番高い文字の上端（drawTextLineと同じ）
+	int8_t ascent = GlyphRaster::FontAscent(font);
+	uint16_t width = 0;
+	for (const char *p = text; *p; p++) {
+		uint8_t c = *p;
+		if (c < font->first || c > font->last) {
+			fprintf(stderr, "label: warning: '%c' is not in the GFX font\n", c);
+			continue;
+		}
+		width += font->glyph[c - font->first].xAdvance * size;
+	}
+	Canvas canvas;
+	canvas.resize(width, font->yAdvance * size);
+	canvas.top = ascent * size;
+
+	CanvasPen pen = {&canvas, 0};
+	for (const char *p = text; *p; p++) {
+		uint8_t c = *p;
+		if (c < font->first || c > font->last) continue;
+		GlyphRaster::RasterizeGfx(font, c, ascent, size, fillCanvas, &pen);
+		pen.x += font->glyph[c - font->first].xAdvance * size;
+	}
+	return canvas;
+}
+
+/// @brief ラベルを.incの形式で出力する
+static void writeLabel(FILE *out, const char *name, const char *text, const Canvas &canvas, bool rgb, uint16_t fg, uint16_t bg)
+{
+	std::vector<uint8_t> data;
+	if (rgb) {
+		for (uint8_t p : canvas.pixels) {
+			uint16_t color = p ? fg : bg;
+			data.push_back(color >> 8);
+			data.push_back(color & 0xFF);
+		}
+	} else {
+		data.assign((canvas.pixels.size() + 7) / 8, 0);
+		for (size_t i = 0; i < canvas.pixels.size(); i++) {
+			if (canvas.pixels[i]) data[i >> 3] |= 0x80 >> (i & 7);
+		}
+	}
+	fprintf(out, "// \"%s\" %dx%d %s\n", text, canvas.width, canvas.height, rgb ? "RGB565" : "mono");
+	fprintf(out, "static const uint8_t %s_data[%zu] TFT_FLASH_DATA(\"label\") = {", name, data.size());
+	for (size_t i = 0; i < data.size(); i++) fprintf(out, "%s0x%02X,", (i % 16 == 0) ? "\n" : "", data[i]);
+	fprintf(out, "\n};\n");
+	fprintf(out, "static const TFTLabel %s = {%d, %d, %d, %s, %s_data};\n\n",
+		name, canvas.width, canvas.height, canvas.top, rgb ? "TFT_LABEL_RGB565" : "TFT_LABEL_MONO", name);
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage:\n"
+		"  label [options] <name> <text> [<name> <text>...]\n"
+		"options:\n"
+		"  -o <output.inc>        write to a file instead of stdout\n"
+		"  --gfx <font>           render with a GFX font instead of the Kanji font\n"
+		"  --size <n>             text size (scale)\n"
+		"  --rgb565 <fg> <bg>     write RGB565 pixels with fixed colors (hex) instead of 1bpp\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *output = NULL;
+	const GFXfont *gfx = NULL;
+	uint8_t size = 1;
+	bool rgb = false;
+	uint16_t fg = 0xFFFF, bg = 0x0000;
+	std::vector<std::pair<std::string, std::string>> labels;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		} else if (strcmp(argv[i], "--gfx") == 0 && i + 1 < argc) {
+			const char *name = argv[++i];
+			for (const auto &f : gfxFonts) {
+				if (strcmp(name, f.name) == 0) gfx = f.font;
+			}
+			if (gfx == NULL) fatal("unknown GFX font %s", name);
+		} else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+			size = atoi(argv[++i]);
+			if (size < 1) usage();
+		} else if (strcmp(argv[i], "--rgb565") == 0 && i + 2 < argc) {
+			rgb = true;
+			fg = strtoul(argv[++i], NULL, 16);
+			bg = strtoul(argv[++i], NULL, 16);
+		} else if (argv[i][0] == '-' || i + 1 >= argc) {
+			usage();
+		} else {
+			labels.emplace_back(argv[i], argv[i + 1]);
+			i++;
+		}
+	}
+	if (labels.empty()) usage();
+
+	FILE *out = output ? fopen(output, "w") : stdout;
+	if (out == NULL) fatal("cannot create %s", output);
+	fprintf(out, "#pragma once\n");
+	fprintf(out, "// generated by tools/label\n");
+	for (const auto &label : labels) {
+		Canvas canvas = gfx ? renderGfx(gfx, label.second.c_str(), size) : renderKanji(label.second.c_str(), size);
+		writeLabel(out, label.first.c_str(), label.second.c_str(), canvas, rgb, fg, bg);
+	}
+	if (output) fclose(out);
+	return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file utf8check.cpp
+ * @brief KanjiHelperのUTF-8の解釈を、ホストで動かして確かめるツール。
+ * @details ライブラリと同じ src/KanjiHelper.cpp で、DecodeUTF8 と LayoutLines に正しい文字列と不正な文字列を渡し、
+ * 結果が期待どおりになることを確かめる。<br/>
+ * 途中で終わっているマルチバイト文字（"漢" の先頭の１、２バイトだけで終わる文字列など）は、ちょうどの大きさでmallocした
+ * バッファに置いて渡すので、AddressSanitizerを付けてビルドすれば、終端の先を読んだときに検出される。
+ *
+ *     g++ -std=gnu++17 -O1 -g -fsanitize=address -Iinclude -o utf8check tools/utf8check/utf8check.cpp src/KanjiHelper.cpp src/KanjiFontBlob.cpp
+ *
+ * 使い方:
+ *
+ *     utf8check
+ *
+ * すべて期待どおりなら "ok" を表示して0で終わる。違っていれば、その文字列を表示して1で終わる。
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/KanjiHelper.h"
+
+static int failures = 0;
+
+/// @brief 16進数で文字列を表示する
+static void printBytes(const char *text, size_t length)
+{
+	for (size_t i = 0; i < length; i++) fprintf(stderr, " %02X", (uint8_t)text[i]);
+}
+
+/// @brief 文字列を、終端のNULまでちょうどの大きさのバッファに置く
+static char *heapString(const char *text, size_t length)
+{
+	char *buffer = (char *)malloc(length + 1);
+	memcpy(buffer, text, length);
+	buffer[length] = 0;
+	return buffer;
+}
+
+/// @brief DecodeUTF8の結果を確かめる
+/// @param step 期待するバイト数（不正なら0）
+/// @param code 期待する文字コード。stepが0なら使わない
+static void checkDecode(const char *text, size_t length, bool forceHankana, uint8_t step, uint32_t code)
+{
+	char *buffer = heapString(text, length);
+	uint32_t got = 0;
+	uint8_t n = KanjiHelper::DecodeUTF8(buffer, &got, forceHankana);
+	if (n != step || (step != 0 && got != code)) {
+		fprintf(stderr, "utf8check: DecodeUTF8(");
+		printBytes(text, length);
+		fprintf(stderr, " ) = %u, 0x%X (expected %u, 0x%X)\n", n, got, step, code);
+		failures++;
+	}
+	free(buffer);
+}
+
+/// @brief 不正な文字のところで、LayoutLinesが行を終えることを確かめる
+/// @param valid 先頭から、正しい文字が続くバイト数
+static void checkLayout(const char *text, size_t length, uint16_t valid)
+{
+	char *buffer = heapString(text, length);
+	KanjiLine lines[4];
+	uint16_t count = KanjiHelper::LayoutLines(buffer, 0, 0, 1, kanjiForceHankana, lines, 4);
+	if (count != 1 || lines[0].length != valid || lines[0].next != valid) {
+		fprintf(stderr, "utf8check: LayoutLines(");
+		printBytes(text, length);
+		fprintf(stderr, " ) = %u lines, length %u (expected 1 line, length %u)\n", count, count ? lines[0].length : 0, valid);
+		failures++;
+	}
+	free(buffer);
+}
+
+int main()
+{
+	// 正しい文字
+	checkDecode("A", 1, false, 1, 'A');
+	checkDecode("\xC2\xB0", 2, false, 2, 0xC2B0);				// °
+	checkDecode("\xE6\xBC\xA2", 3, false, 3, 0xE6BCA2);			// 漢
+	checkDecode("\xF0\x9F\x98\x80", 4, false, 4, 0xF09F9880);	// U+1F600
+	checkDecode("\xEF\xBD\xB1", 3, true, 3, 0xB1);				// 半角カナのｱ
+	checkDecode("\xEF\xBE\x80", 3, true, 3, 0xC0);				// 半角カナのﾀ
+	checkDecode("\xEF\xBD\xB1", 3, false, 3, 0xEFBDB1);
+
+	// 途中で終わっている文字
+	checkDecode("\xC2", 1, false, 0, 0);
+	checkDecode("\xE6", 1, false, 0, 0);
+	checkDecode("\xE6\xBC", 2, false, 0, 0);
+	checkDecode("\xF0", 1, false, 0, 0);
+	checkDecode("\xF0\x9F", 2, false, 0, 0);
+	checkDecode("\xF0\x9F\x98", 3, false, 0, 0);
+
+	// 続きのバイトが0x80～0xBFでない文字
+	checkDecode("\xE6\x41\xA2", 3, false, 0, 0);
+	checkDecode("\xE6\xBC\xC2\xB0", 4, false, 0, 0);
+	checkDecode("\x80", 1, false, 0, 0);
+	checkDecode("\xFF", 1, false, 0, 0);
+
+	// 文字列の最後の文字が途中で終わっていると、その前までで行が終わる
+	checkLayout("AB\xE6", 3, 2);
+	checkLayout("AB\xE6\xBC", 4, 2);
+	checkLayout("\xE6\xBC\xA2\xF0\x9F\x98", 6, 3);
+	checkLayout("\xE6\xBC\xA2\xC2", 4, 3);
+	checkLayout("AB\xE6\x41\xA2" "CD", 7, 2);
+
+	if (failures) {
+		fprintf(stderr, "utf8check: %d failures\n", failures);
+		return 1;
+	}
+	printf("ok\n");
+	return 0;
+}